@@ -0,0 +1,155 @@
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+#include "memory.hpp"
+#include "stats.hpp"
+
+// The allocator hook behind memory.hpp: a replacement for every form of the
+// global operator new and delete, so that memory from any new is freed by a
+// matching delete. It is linked into ./type only, never into libcflatcheck.
+// All of them allocate with malloc (aligned_alloc for over-aligned types) and
+// free with free. Sizes are taken from malloc itself, so frees through the
+// unsized forms are counted exactly.
+
+static void *allocate(size_t size, size_t alignment) {
+    stats::count(stats::Counter::ALLOCATIONS);
+    stats::count(stats::Counter::ALLOCATED_BYTES, size);
+
+    if (size == 0) {
+        size = 1;
+    }
+
+    // aligned_alloc wants a size that is a multiple of the alignment
+    void *memory = alignment <= alignof(std::max_align_t)
+        ? std::malloc(size)
+        : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+
+    if (memory && memory::tracking()) {
+        memory::add(malloc_usable_size(memory));
+    }
+
+    return memory;
+}
+
+static void deallocate(void *memory) noexcept {
+    if (memory && memory::tracking()) {
+        memory::add(-static_cast<int64_t>(malloc_usable_size(memory)));
+    }
+
+    std::free(memory);
+}
+
+// As the standard's operator new does: on failure, call the installed
+// new_handler and retry, and throw bad_alloc only when none is installed
+static void *allocateOrThrow(size_t size, size_t alignment) {
+    while (true) {
+        if (void *memory = allocate(size, alignment)) {
+            return memory;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+
+        handler();
+    }
+}
+
+// The nothrow forms run the same loop, but return null where it would throw
+static void *allocateOrNull(size_t size, size_t alignment) noexcept {
+    try {
+        return allocateOrThrow(size, alignment);
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+// Throwing forms
+
+void *operator new(size_t size) {
+    return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void *operator new[](size_t size) {
+    return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+// Nothrow forms
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return allocateOrNull(size, alignof(std::max_align_t));
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return allocateOrNull(size, alignof(std::max_align_t));
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return allocateOrNull(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return allocateOrNull(size, static_cast<size_t>(alignment));
+}
+
+// Every delete, sized or not, aligned or not, ends up in free
+
+void operator delete(void *memory) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void *memory, size_t, std::align_val_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void *memory, size_t, std::align_val_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void *memory, std::align_val_t, const std::nothrow_t &) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t, const std::nothrow_t &) noexcept {
+    deallocate(memory);
+}
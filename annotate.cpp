@@ -0,0 +1,352 @@
+#include "annotate.hpp"
+#include "json.hpp"
+#include "traversal.hpp"
+
+/* TypeTable */
+
+TypeTable::TypeTable(uint32_t nodeCount) : types(nodeCount, nullptr) {}
+
+const Type *TypeTable::find(const Node &node) const {
+    return find(node.id);
+}
+
+const Type *TypeTable::find(uint32_t id) const {
+    return id < types.size() ? types[id] : nullptr;
+}
+
+void TypeTable::record(const Node &node, const Type *type) {
+    if (node.id < types.size()) {
+        types[node.id] = type;
+    }
+}
+
+uint32_t TypeTable::size() const {
+    return static_cast<uint32_t>(types.size());
+}
+
+/* Writer */
+
+static void writeString(std::ostream &out, std::string_view text) {
+    out << nlohmann::json(text).dump();
+}
+
+void writeType(std::ostream &out, const Type *type) {
+    switch (type->getTypeKind()) {
+        case TypeKind::INT:
+            out << "\"Int\"";
+            return;
+        case TypeKind::NIL:
+            out << "\"Nil\"";
+            return;
+        case TypeKind::STRUCT:
+            out << "{\"Struct\": ";
+            writeString(out, static_cast<const StructType*>(type)->name);
+            out << "}";
+            return;
+        case TypeKind::ARRAY:
+            out << "{\"Array\": ";
+            writeType(out, static_cast<const ArrayType*>(type)->elementType.get());
+            out << "}";
+            return;
+        case TypeKind::POINTER:
+            out << "{\"Ptr\": ";
+            writeType(out, static_cast<const PointerType*>(type)->pointeeType.get());
+            out << "}";
+            return;
+        case TypeKind::FUNCTION: {
+            const auto *functionType = static_cast<const FunctionType*>(type);
+            out << "{\"Fn\": [[";
+
+            for (size_t i = 0; i < functionType->paramTypes.size(); i++) {
+                out << (i ? ", " : "");
+                writeType(out, functionType->paramTypes[i].get());
+            }
+
+            out << "], ";
+            writeType(out, functionType->returnType.get());
+            out << "]}";
+            return;
+        }
+    }
+}
+
+namespace {
+
+void writeDeclarations(std::ostream &out, std::span<const Declaration> declarations) {
+    out << "[";
+
+    for (size_t i = 0; i < declarations.size(); i++) {
+        out << (i ? ", " : "") << "{\"name\": ";
+        writeString(out, declarations[i].name);
+        out << ", \"typ\": ";
+        writeType(out, declarations[i].type.get());
+        out << "}";
+    }
+
+    out << "]";
+}
+
+// Writes a node's opening text on ENTER, the separators between its children
+// on CHILD and its closing text, with the "type" member, on LEAVE
+class AnnotationWriter : public Walker {
+public:
+    AnnotationWriter(std::ostream &out, const TypeTable &types) : out(out), types(types) {}
+
+    /* Expressions */
+
+    void visit(Value &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"Val\": ";
+        } else if (phase() == WalkPhase::LEAVE) {
+            close(node);
+        }
+    }
+
+    void visit(Number &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            out << "{\"Num\": " << node.value;
+            close(node);
+        }
+    }
+
+    void visit(Nil &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            out << "{\"Nil\": null";
+            close(node);
+        }
+    }
+
+    void visit(Select &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"Select\": {\"guard\": ";
+        } else if (phase() == WalkPhase::CHILD) {
+            out << (childIndex() == 0 ? ", \"tt\": " : childIndex() == 1 ? ", \"ff\": " : "");
+        } else {
+            out << "}";
+            close(node);
+        }
+    }
+
+    void visit(UnaryOperation &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"UnOp\": [\"" << unaryOperandToString(node.operand) << "\", ";
+        } else if (phase() == WalkPhase::LEAVE) {
+            out << "]";
+            close(node);
+        }
+    }
+
+    void visit(BinaryOperation &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"BinOp\": {\"op\": \"" << binaryOperandToString(node.operand) << "\", \"left\": ";
+        } else if (phase() == WalkPhase::CHILD) {
+            out << (childIndex() == 0 ? ", \"right\": " : "");
+        } else {
+            out << "}";
+            close(node);
+        }
+    }
+
+    void visit(NewSingleton &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            out << "{\"NewSingle\": ";
+            writeType(out, node.type.get());
+            close(node);
+        }
+    }
+
+    void visit(NewArray &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"NewArray\": [";
+            writeType(out, node.type.get());
+            out << ", ";
+        } else if (phase() == WalkPhase::LEAVE) {
+            out << "]";
+            close(node);
+        }
+    }
+
+    /* Places */
+
+    void visit(Identifier &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            out << "{\"Id\": ";
+            writeString(out, node.name);
+            close(node);
+        }
+    }
+
+    void visit(Dereference &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"Deref\": ";
+        } else if (phase() == WalkPhase::LEAVE) {
+            close(node);
+        }
+    }
+
+    void visit(ArrayAccess &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"ArrayAccess\": {\"array\": ";
+        } else if (phase() == WalkPhase::CHILD) {
+            out << (childIndex() == 0 ? ", \"idx\": " : "");
+        } else {
+            out << "}";
+            close(node);
+        }
+    }
+
+    void visit(FieldAccess &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"FieldAccess\": {\"ptr\": ";
+        } else if (phase() == WalkPhase::LEAVE) {
+            out << ", \"field\": ";
+            writeString(out, node.field);
+            out << "}";
+            close(node);
+        }
+    }
+
+    /* Function call */
+
+    // Call expressions and call statements are both just {"Call": ...}
+    void visit(FunctionCall &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"Call\": {\"callee\": ";
+        } else if (phase() == WalkPhase::CHILD) {
+            out << (childIndex() == 0 ? ", \"args\": [" : childIndex() < node.args.size() ? ", " : "");
+        } else {
+            out << "]}";
+            close(node);
+        }
+    }
+
+    /* Statements */
+
+    void visit(Statements &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "[";
+        } else if (phase() == WalkPhase::CHILD) {
+            out << (childIndex() + 1 < node.statements.size() ? ", " : "");
+        } else {
+            out << "]";
+        }
+    }
+
+    void visit(Assignment &) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"Assign\": [";
+        } else if (phase() == WalkPhase::CHILD) {
+            out << (childIndex() == 0 ? ", " : "");
+        } else {
+            out << "]}";
+        }
+    }
+
+    void visit(If &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"If\": {\"guard\": ";
+        } else if (phase() == WalkPhase::CHILD) {
+            out << (childIndex() == 0 ? ", \"tt\": " : childIndex() == 1 && node.unhappyPath ? ", \"ff\": " : "");
+        } else {
+            out << "}}";
+        }
+    }
+
+    void visit(While &) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"While\": [";
+        } else if (phase() == WalkPhase::CHILD) {
+            out << (childIndex() == 0 ? ", " : "");
+        } else {
+            out << "]}";
+        }
+    }
+
+    void visit(Break &) override {
+        if (phase() == WalkPhase::LEAVE) {
+            out << "\"Break\"";
+        }
+    }
+
+    void visit(Continue &) override {
+        if (phase() == WalkPhase::LEAVE) {
+            out << "\"Continue\"";
+        }
+    }
+
+    void visit(Return &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            out << "{\"Return\": " << (node.expression ? "" : "null");
+        } else if (phase() == WalkPhase::LEAVE) {
+            out << "}";
+        }
+    }
+
+private:
+    // Ends a typed node's object, adding its type first if it has one
+    void close(const Node &node) {
+        if (const Type *type = types.find(node)) {
+            out << ", \"type\": ";
+            writeType(out, type);
+        }
+
+        out << "}";
+    }
+
+    std::ostream &out;
+    const TypeTable &types;
+};
+
+} // namespace
+
+void writeAnnotatedProgram(std::ostream &out, const Program &program, const TypeTable &types) {
+    out << "{\"structs\": [";
+
+    for (size_t i = 0; i < program.structs.size(); i++) {
+        const StructDefinition &structDefinition = *program.structs[i];
+        out << (i ? ",\n" : "\n") << "{\"name\": ";
+        writeString(out, structDefinition.name);
+        out << ", \"fields\": ";
+        writeDeclarations(out, structDefinition.fields);
+        out << "}";
+    }
+
+    out << "],\n\"externs\": [";
+
+    for (size_t i = 0; i < program.externs.size(); i++) {
+        const Extern &externDefinition = program.externs[i];
+        out << (i ? ",\n" : "\n") << "{\"name\": ";
+        writeString(out, externDefinition.name);
+        out << ", \"typ\": ";
+        writeType(out, TypeContext::global().functionType(externDefinition.paramTypes, externDefinition.returnType).get());
+        out << "}";
+    }
+
+    out << "],\n\"functions\": [";
+
+    AnnotationWriter writer(out, types);
+
+    for (size_t i = 0; i < program.functions.size(); i++) {
+        const FunctionDefinition &function = *program.functions[i];
+        out << (i ? ",\n" : "\n") << "{\"name\": ";
+        writeString(out, function.name);
+        out << ", \"prms\": ";
+        writeDeclarations(out, function.params);
+        out << ", \"rettyp\": ";
+        writeType(out, function.returnType.get());
+        out << ", \"locals\": ";
+        writeDeclarations(out, function.locals);
+        out << ", \"stmts\": ";
+
+        // The walk only reads the tree; Visitor takes nodes by non-const reference
+        if (function.body) {
+            writer.walk(const_cast<Statement &>(*function.body));
+        } else {
+            out << "[]";
+        }
+
+        out << "}";
+    }
+
+    out << "]}\n";
+}
@@ -0,0 +1,38 @@
+#ifndef ANNOTATE_HPP
+#define ANNOTATE_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "ast.hpp"
+
+// The type the checker derived for each expression, place and function call,
+// keyed by Node::id, so consumers read types back instead of checking again.
+// Types are borrowed from TypeContext. Distinct nodes own distinct slots, so
+// functions checked in parallel can record into one table without locking.
+class TypeTable {
+public:
+    // Sized for one tree numbered by assignNodeIds, which returns nodeCount
+    explicit TypeTable(uint32_t nodeCount);
+
+    // The recorded type of node, or of the node numbered id, or nullptr if it was never typed
+    const Type *find(const Node &node) const;
+    const Type *find(uint32_t id) const;
+    void record(const Node &node, const Type *type);
+
+    uint32_t size() const;
+
+private:
+    std::vector<const Type *> types;
+};
+
+// The .astj spelling of a type, as buildType reads it: "Int", {"Ptr": "Int"}, ...
+extern void writeType(std::ostream &out, const Type *type);
+
+// Writes the program back out in the .astj JSON form, with a "type" member (in
+// the .astj type syntax) next to the tag of every expression, place and call
+// that has one in types. Written as the tree is walked, so depth costs no stack.
+extern void writeAnnotatedProgram(std::ostream &out, const Program &program, const TypeTable &types);
+
+#endif
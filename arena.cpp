@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "arena.hpp"
+
+static thread_local Arena *currentArena = nullptr;
+
+void *Arena::allocate(size_t size, size_t alignment) {
+    auto address = reinterpret_cast<uintptr_t>(cursor);
+    size_t padding = (alignment - address % alignment) % alignment;
+
+    if (!cursor || static_cast<size_t>(end - cursor) < padding + size) {
+        // Oversized requests get a block of their own
+        size_t blockSize = std::max(BLOCK_SIZE, size + alignment);
+        blocks.push_back(std::make_unique<std::byte[]>(blockSize));
+        cursor = blocks.back().get();
+        end = cursor + blockSize;
+
+        address = reinterpret_cast<uintptr_t>(cursor);
+        padding = (alignment - address % alignment) % alignment;
+    }
+
+    void *memory = cursor + padding;
+    cursor += padding + size;
+    bytesUsed += size;
+    return memory;
+}
+
+size_t Arena::bytesAllocated() const {
+    return bytesUsed;
+}
+
+Arena *Arena::current() {
+    return currentArena;
+}
+
+Arena::Scope::Scope(Arena &arena) {
+    previous = currentArena;
+    currentArena = &arena;
+}
+
+Arena::Scope::~Scope() {
+    currentArena = previous;
+}
@@ -0,0 +1,76 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Bump allocator backing the nodes of one Program. Nodes are carved out of
+// large blocks and all of the blocks are released together with the arena.
+class Arena {
+public:
+    Arena() = default;
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, size_t alignment);
+    size_t bytesAllocated() const;
+
+    // The arena that makeNode allocates from on this thread, or nullptr for the heap
+    static Arena *current();
+
+    // Installs an arena as current for the lifetime of the scope
+    class Scope {
+    public:
+        explicit Scope(Arena &arena);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Arena *previous;
+    };
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::byte *cursor = nullptr;
+    std::byte *end = nullptr;
+    size_t bytesUsed = 0;
+};
+
+// Deleter for nodes that may live in an arena: arena nodes are only destroyed
+// in place, since their memory goes away with the arena itself
+struct NodeDeleter {
+    bool inArena = false;
+
+    template <typename T>
+    void operator()(T *node) const {
+        if (inArena) {
+            node->~T();
+        } else {
+            delete node;
+        }
+    }
+};
+
+// Owning pointer to an AST node, allocated with makeNode
+template <typename T>
+using NodePtr = std::unique_ptr<T, NodeDeleter>;
+
+template <typename T, typename... Args>
+NodePtr<T> makeNode(Args &&...args) {
+    if (Arena *arena = Arena::current()) {
+        void *memory = arena->allocate(sizeof(T), alignof(T));
+        return NodePtr<T>(new (memory) T(std::forward<Args>(args)...), NodeDeleter{true});
+    }
+
+    return NodePtr<T>(new T(std::forward<Args>(args)...), NodeDeleter{false});
+}
+
+#endif
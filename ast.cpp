@@ -1,11 +1,30 @@
+#include <exception>
 #include <stdexcept>
 #include <set>
 #include <format>
+#include <iterator>
 
 #include "ast.hpp"
 #include "builder.hpp"
+#include "cache.hpp"
+#include "checker.hpp"
+#include "flat.hpp"
+#include "memory.hpp"
+#include "render.hpp"
+#include "stats.hpp"
+#include "threadpool.hpp"
 
-static inline constexpr std::string_view unaryOperandToString(UnaryOperand op) {
+// The throwing form of a check: the checker's result, unless one of its rules failed
+template <typename T>
+static T orThrow(const Checker &checker, T result) {
+    if (const std::optional<Diagnostic> &failure = checker.failure()) {
+        throw std::runtime_error(::render(*failure));
+    }
+
+    return result;
+}
+
+std::string_view unaryOperandToString(UnaryOperand op) {
     switch (op) {
         case UnaryOperand::NEG: return "Neg";
         case UnaryOperand::NOT: return "Not";
@@ -14,7 +33,7 @@ static inline constexpr std::string_view unaryOperandToString(UnaryOperand op) {
     return "";
 }
 
-static inline constexpr std::string_view binaryOperandToString(BinaryOperand op) {
+std::string_view binaryOperandToString(BinaryOperand op) {
     switch (op) {
         case BinaryOperand::ADD:    return "Add";  
         case BinaryOperand::SUB:    return "Sub"; 
@@ -35,859 +54,873 @@ static inline constexpr std::string_view binaryOperandToString(BinaryOperand op)
 
 /* Node declarations */
 
+// Node
+Node::Node(NodeKind kind) {
+    this->kind = kind;
+}
+
+void Node::render(std::string &out) const {
+    Renderer renderer(out);
+    renderer.node(*this);
+    renderer.run();
+}
+
+std::string Node::toString() const {
+    std::string out;
+    render(out);
+    return out;
+}
+
 /* Declaration */
-Declaration::Declaration(std::string name, std::shared_ptr<Type> type) {
-    this->name = std::move(name);
+// Names are interned; the node keeps the symbol plus a view of the table's copy
+Declaration::Declaration(std::string_view name, std::shared_ptr<Type> type) : Node(NodeKind::DECLARATION) {
+    this->symbol = SymbolTable::global().intern(name);
+    this->name = SymbolTable::global().name(symbol);
+    this->type = std::move(type);
+}
+
+Declaration::Declaration(Symbol symbol, std::shared_ptr<Type> type) : Node(NodeKind::DECLARATION) {
+    this->symbol = symbol;
+    this->name = SymbolTable::global().name(symbol);
     this->type = std::move(type);
 }
 
-std::string Declaration::toString() const {
-    return type->toString() + " " + name;
+void Declaration::renderParts(Renderer &renderer) const {
+    renderer.type(*type);
+    renderer.text(" ");
+    renderer.text(name);
 }
 
-void Declaration::accept(Visitor &visitor) {}
+void Declaration::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 /* Expressions */
 
+// Expression
+Expression::Expression(NodeKind kind) : Node(kind) {}
+
+const Type *Expression::check(const Scope &gamma, const Delta &delta) const {
+    Checker checker(gamma, delta);
+    return orThrow(checker, checker.checkExpression(*this));
+}
+
 // Value
-Value::Value(std::unique_ptr<Place> place) { 
+Value::Value(NodePtr<Place> place) : Expression(NodeKind::VALUE) { 
     this->place = std::move(place); 
 }
 
-std::shared_ptr<Type> Value::check(const Gamma &gamma, const Delta &delta) const {
-    return place->check(gamma, delta);
+void Value::renderParts(Renderer &renderer) const {
+    renderer.text("Val(");
+    renderer.node(*place);
+    renderer.text(")");
 }
 
-std::string Value::toString() const {
-    return std::format("Val({})", place->toString());
+void Value::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void Value::accept(Visitor &visitor) {}
-
 // Number
-Number::Number(long long value) {
+Number::Number(long long value) : Expression(NodeKind::NUMBER) {
     this->value = std::move(value); 
 }
 
-std::shared_ptr<Type> Number::check(const Gamma &gamma, const Delta &delta) const { 
-    return INT_TYPE; 
+void Number::renderParts(Renderer &renderer) const {
+    renderer.text("Num(");
+    renderer.number(value);
+    renderer.text(")");
 }
 
-std::string Number::toString() const { 
-    return std::format("Num({})", std::to_string(value)); 
+void Number::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void Number::accept(Visitor &visitor) {}
-
 // Nil
-std::shared_ptr<Type> Nil::check(const Gamma &gamma, const Delta &delta) const {
-    return NIL_TYPE; 
-}
+Nil::Nil() : Expression(NodeKind::NIL) {}
 
-std::string Nil::toString() const {
-    return "Nil"; 
+void Nil::renderParts(Renderer &renderer) const {
+    renderer.text("Nil");
 }
 
-void Nil::accept(Visitor &visitor) {}
+void Nil::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 // Select
-Select::Select(std::unique_ptr<Expression> guard, std::unique_ptr<Expression> ttCase, std::unique_ptr<Expression> ffCase) {
+Select::Select(NodePtr<Expression> guard, NodePtr<Expression> ttCase, NodePtr<Expression> ffCase) : Expression(NodeKind::SELECT) {
     this->guard = std::move(guard);
     this->ttCase = std::move(ttCase);
     this->ffCase = std::move(ffCase);
 }
 
-std::shared_ptr<Type> Select::check(const Gamma &gamma, const Delta &delta) const {
-    std::shared_ptr<Type> guardType = guard->check(gamma, delta);
-
-    if (guardType->getTypeKind() != TypeKind::INT) {
-        std::string guardTypeStr = guardType->toStringPretty();
-        std::string guardStr = guard->toString();
-        throw std::runtime_error(std::format("non-int type {} for select guard '{}'", guardTypeStr, guardStr));
-    }
-
-    std::shared_ptr<Type> ttCaseType = trueCase->check(gamma, delta);
-    std::shared_ptr<Type> ffCaseType = falseCase->check(gamma, delta);
-
-    if (!typesEqual(ttCaseType, ffCaseType)) {
-        std::string ttCaseTypeStr = ttCaseType->toStringPretty();
-        std::string ttCaseStr = ttCase->toString();
-        std::string ffCaseTypeStr = ffCaseType->toStringPretty();
-        std::string ffCaseStr = ffCase->toString();
-        throw std::runtime_error(std::format("incompatible types {} vs {} in select branches '{}' vs '{}'", ttCaseTypeStr, ffCaseTypeStr, ttCaseStr, ffCaseStr));
-    }
-    
-    return ttCaseType->getTypeKind() == TypeKind::NIL ? ffCaseType : ttCaseType;
+void Select::renderParts(Renderer &renderer) const {
+    renderer.text("Select { guard: ");
+    renderer.node(*guard);
+    renderer.text(", tt: ");
+    renderer.node(*ttCase);
+    renderer.text(", ff: ");
+    renderer.node(*ffCase);
+    renderer.text(" }");
 }
 
-std::string Select::toString() const {
-    std::string guardStr = guard->toString();
-    std::string ttCaseStr = ttCase->toString();
-    std::string ffCaseStr = ffCase->toString();
-    return std::format("Select {{ guard: {}, tt: {}, ff: {} }}", guardStr, ttCaseStr, ffCaseStr);
+void Select::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void Select::accept(Visitor &visitor) {}
-
 // UnaryOperation
-UnaryOperation::UnaryOperation(UnaryOperand operand, std::unique_ptr<Expression> expression) {
+UnaryOperation::UnaryOperation(UnaryOperand operand, NodePtr<Expression> expression) : Expression(NodeKind::UNARY_OPERATION) {
     this->operand = operand;
     this->expression = std::move(expression);
 }
 
-std::shared_ptr<Type> UnaryOperation::check(const Gamma &gamma, const Delta &delta) const {
-    std::shared_ptr<Type> operandType = expression->check(gamma, delta);
-    
-    if (operandType->getTypeKind() != TypeKind::INT) {
-        std::string opTypeStr = operandType->toStringPretty();
-        std::string thisStr = toString();
-        throw std::runtime_error(std::format("non-int operand type {} in unary op '{}'", opTypeStr, thisStr));
-    }
-
-    return INT_TYPE; 
+void UnaryOperation::renderParts(Renderer &renderer) const {
+    renderer.text("UnOp(");
+    renderer.text(unaryOperandToString(operand));
+    renderer.text(", ");
+    renderer.node(*expression);
+    renderer.text(")");
 }
 
-std::string UnaryOperation::toString() const {
-    return std::format("UnOp({}, {})", std::string(unaryOperandToString(operand)), expression->toString());
+void UnaryOperation::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void UnaryOperation::accept(Visitor &visitor) {}
-
 // BinaryOperation
-BinaryOperation::BinaryOperation(BinaryOperand operand, std::unique_ptr<Expression> lhs, std::unique_ptr<Expression> rhs) {
+BinaryOperation::BinaryOperation(BinaryOperand operand, NodePtr<Expression> lhs, NodePtr<Expression> rhs) : Expression(NodeKind::BINARY_OPERATION) {
     this->operand = operand;
     this->lhs = std::move(lhs);
     this->rhs = std::move(rhs);
 }
 
-std::shared_ptr<Type> BinaryOperation::check(const Gamma &gamma, const Delta &delta) const {
-    std::shared_ptr<Type> lhsType = lhs->check(gamma, delta);
-    std::shared_ptr<Type> rhsType = rhs->check(gamma, delta);
-
-    std::string lhsTypeStr = lhsType->toStringPretty();
-    std::string rhsTypeStr = rhsType->toStringPretty();
-    std::string lhsStr = lhs->toString();
-    std::string rhsStr = rhs->toString();
-
-    if (operand == BinaryOperand::EQ || operand == BinaryOperand::NOT_EQ) {
-        if (!typesEqual(lhsType, rhsType)) {
-            throw std::runtime_error(std::format("incompatible types {} vs {} in binary op '{}'", lhsTypeStr, rhsTypeStr, toString()));
-        }
-        
-        if (lhsType->getTypeKind() == TypeKind::STRUCT || lhsType->getTypeKind() == TypeKind::FUNCTION) {
-            throw std::runtime_error(std::format("invalid type {} used in binary op '{}'", lhsTypeStr, toString()));
-        }
-        
-        if (rhsType->getTypeKind() == TypeKind::STRUCT || rhsType->getTypeKind() == TypeKind::FUNCTION) {
-            throw std::runtime_error(std::format("invalid type {} used in binary op '{}'", rhsTypeStr, toString()));
-        }
-    } else {
-        if (!typesEqual(lhsType, INT_TYPE)) {
-            throw std::runtime_error(std::format("non-int type {} for left operand of binary op '{}'", lhsTypeStr, toString()));
-        }
-
-        if (!typesEqual(rhsType, INT_TYPE)) {
-            throw std::runtime_error(std::format("non-int type {} for right operand of binary op '{}'", rhsTypeStr, toString()));
-        }
-    }
-    
-    return INT_TYPE; 
+void BinaryOperation::renderParts(Renderer &renderer) const {
+    renderer.text("BinOp { op: ");
+    renderer.text(binaryOperandToString(operand));
+    renderer.text(", left: ");
+    renderer.node(*lhs);
+    renderer.text(", right: ");
+    renderer.node(*rhs);
+    renderer.text(" }");
 }
 
-std::string BinaryOperation::toString() const {
-    std::string opStr = std::string(binaryOperandToString(operand));
-    std::string lhsStr = lhs->toString();
-    std::string rhsStr = rhs->toString();
-    return std::format("BinOp {{ op: {}, left: {}, right: {} }}", opStr, lhsStr, rhsStr);
+void BinaryOperation::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void BinaryOperation::accept(Visitor &visitor) {}
-
 // NewSingleton
-NewSingleton::NewSingleton(std::shared_ptr<Type> type) {
+NewSingleton::NewSingleton(std::shared_ptr<Type> type) : Expression(NodeKind::NEW_SINGLETON) {
     this->type = std::move(type);
 }
 
-std::shared_ptr<Type> NewSingleton::check(const Gamma &gamma, const Delta &delta) const {
-    if (type->getTypeKind() == TypeKind::NIL || type->getTypeKind() == TypeKind::FUNCTION) {
-        throw std::runtime_error(std::format("invalid type used for allocation '{}'", toString()));
-    }
-    
-    return std::make_shared<PointerType>(type);
+void NewSingleton::renderParts(Renderer &renderer) const {
+    renderer.text("NewSingle(");
+    renderer.type(*type);
+    renderer.text(")");
 }
 
-std::string NewSingleton::toString() const {
-    return std::format("NewSingle({})", type->toString());
+void NewSingleton::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void NewSingleton::accept(Visitor &visitor) {}
-
 // NewArray
-NewArray::NewArray(std::shared_ptr<Type> type, std::unique_ptr<Expression> size) {
+NewArray::NewArray(std::shared_ptr<Type> type, NodePtr<Expression> size) : Expression(NodeKind::NEW_ARRAY) {
     this->type = std::move(type);
     this->size = std::move(size);
 }
 
-std::shared_ptr<Type> NewArray::check(const Gamma &gamma, const Delta &delta) const {
-    std::shared_ptr<Type> sizeType = size->check(gamma, delta);
-    
-    std::string sizeTypeStr = sizeType->toStringPretty();
-    std::string thisStr = toString();
-
-    if (!typesEqual(sizeType, INT_TYPE)) {
-        throw std::runtime_error(std::format("non-int type {} used for second argument of allocation '{}'", sizeTypeStr, thisStr));
-    }
-
-    if (type->getTypeKind() == TypeKind::NIL || type->getTypeKind() == TypeKind::FUNCTION || type->getTypeKind() == TypeKind::STRUCT) {
-        throw std::runtime_error(std::format("invalid type used for first argument of allocation '{}'", thisStr));
-    }
-
-    return std::make_shared<ArrayType>(type);
+void NewArray::renderParts(Renderer &renderer) const {
+    renderer.text("NewArray(");
+    renderer.type(*type);
+    renderer.text(", ");
+    renderer.node(*size);
+    renderer.text(")");
 }
 
-std::string NewArray::toString() const {
-    std::string typeStr = type->toString();
-    std::string sizeStr = size->toString();
-    return std::format("NewArray({}, {})", typeStr, sizeStr);
+void NewArray::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void NewArray::accept(Visitor &visitor) {}
-
 // CallExpression
-CallExpression::CallExpression(std::unique_ptr<FunctionCall> functionCall) {
+CallExpression::CallExpression(NodePtr<FunctionCall> functionCall) : Expression(NodeKind::CALL_EXPRESSION) {
     this->functionCall = std::move(functionCall);
 }
 
-std::shared_ptr<Type> CallExpression::check(const Gamma &gamma, const Delta &delta) const {
-    return functionCall->check(gamma, delta); 
+void CallExpression::renderParts(Renderer &renderer) const {
+    renderer.text("Call(");
+    renderer.node(*functionCall);
+    renderer.text(")");
 }
 
-std::string CallExpression::toString() const {
-    return std::format("Call({})", functionCall->toString());
+void CallExpression::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void CallExpression::accept(Visitor &visitor) {}
-
 /* Places */
 
+// Place
+Place::Place(NodeKind kind) : Node(kind) {}
+
+const Type *Place::check(const Scope &gamma, const Delta &delta) const {
+    Checker checker(gamma, delta);
+    return orThrow(checker, checker.checkExpression(*this));
+}
+
 // Identifier
-Identifier::Identifier(std::string name) {
-    this->name = std::move(name); 
+Identifier::Identifier(std::string_view name) : Place(NodeKind::IDENTIFIER) {
+    this->symbol = SymbolTable::global().intern(name);
+    this->name = SymbolTable::global().name(symbol);
 }
 
-std::shared_ptr<Type> Identifier::check(const Gamma &gamma, const Delta &delta) const {
-    auto it = gamma.find(name);
-    
-    if (it != gamma.end()) {
-        return it->second;
-    } else {
-        throw std::runtime_error(std::format("id {} does not exist in this scope", name));
-    }
+Identifier::Identifier(Symbol symbol) : Place(NodeKind::IDENTIFIER) {
+    this->symbol = symbol;
+    this->name = SymbolTable::global().name(symbol);
 }
 
-std::string Identifier::toString() const {
-    return std::format("Id(\"{}\")", name);
+void Identifier::renderParts(Renderer &renderer) const {
+    renderer.text("Id(\"");
+    renderer.text(name);
+    renderer.text("\")");
 }
 
-void Identifier::accept(Visitor &visitor) {}
+void Identifier::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 // Dereference
-Dereference::Dereference(std::unique_ptr<Expression> expression) {
+Dereference::Dereference(NodePtr<Expression> expression) : Place(NodeKind::DEREFERENCE) {
     this->expression = std::move(expression);
 }
 
-std::shared_ptr<Type> Dereference::check(const Gamma &gamma, const Delta &delta) const {
-    std::shared_ptr<Type> pointeeType = expression->check(gamma, delta);
-    
-    if (auto pointerType = std::dynamic_pointer_cast<PointerType>(pointeeType)) {
-        return pointerType->pointeeType;
-    }
-
-    std::string pointeeTypeStr = pointeeType->toStringPretty();
-    std::string thisStr = toString();
-
-    throw std::runtime_error(std::format("non-pointer type {} for dereference 'Val({})'", pointeeTypeStr, thisStr));
+void Dereference::renderParts(Renderer &renderer) const {
+    renderer.text("Deref(");
+    renderer.node(*expression);
+    renderer.text(")");
 }
 
-std::string Dereference::toString() const {
-    return std::format("Deref({})", expression->toString());
+void Dereference::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void Dereference::accept(Visitor &visitor) {}
-
 // ArrayAccess
-ArrayAccess::ArrayAccess(std::unique_ptr<Expression> array, std::unique_ptr<Expression> index) {
+ArrayAccess::ArrayAccess(NodePtr<Expression> array, NodePtr<Expression> index) : Place(NodeKind::ARRAY_ACCESS) {
     this->array = std::move(array);
     this->index = std::move(index);
 }
 
-std::shared_ptr<Type> ArrayAccess::check(const Gamma &gamma, const Delta &delta) const {
-    std::shared_ptr<Type> arrayType = array->check(gamma, delta); 
-    std::shared_ptr<Type> indexType = index->check(gamma, delta); 
-
-    std::string arrayTypeStr = arrayType->toStringPretty();
-    std::string indexTypeStr = indexType->toStringPretty();
-    std::string thisStr = toString();
-
-    if (!typesEqual(indexType, INT_TYPE)) {
-        throw std::runtime_error(std::format("non-int index type {} for array access '{}'", indexTypeStr, thisStr));
-    }
-
-    if (auto actualArrayType = std::dynamic_pointer_cast<ArrayType>(arrayType)) {
-        return actualArrayType->elementType;
-    }
-    
-    if (typesEqual(arrayType, NIL_TYPE)) {
-        throw std::runtime_error(std::format("non-array type {} for array access '{}'", arrayTypeStr, thisStr));
-    }
-
-    throw std::runtime_error(std::format("non-array type {} for array access '{}'", arrayTypeStr, thisStr));
+void ArrayAccess::renderParts(Renderer &renderer) const {
+    renderer.text("ArrayAccess { array: ");
+    renderer.node(*array);
+    renderer.text(", idx: ");
+    renderer.node(*index);
+    renderer.text(" }");
 }
 
-std::string ArrayAccess::toString() const {
-    std::string arrayStr = array->toString();
-    std::string indexStr = index->toString();
-    return std::format("ArrayAccess {{ array: {}, idx: {} }}", arrayStr, indexStr);
+void ArrayAccess::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void ArrayAccess::accept(Visitor &visitor) {}
-
 // FieldAccess
-FieldAccess::FieldAccess(std::unique_ptr<Expression> pointer, std::string field) {
+FieldAccess::FieldAccess(NodePtr<Expression> pointer, std::string_view field) : Place(NodeKind::FIELD_ACCESS) {
     this->pointer = std::move(pointer);
-    this->field = std::move(field);
+    this->fieldSymbol = SymbolTable::global().intern(field);
+    this->field = SymbolTable::global().name(fieldSymbol);
 }
 
-std::shared_ptr<Type> FieldAccess::check(const Gamma &gamma, const Delta &delta) const {
-    std::shared_ptr<Type> baseType = pointer->check(gamma, delta);
-    
-    std::string baseTypeStr = baseType->toStringPretty();
-    std::string thisStr = this->toString();
-
-    auto ptrType = std::dynamic_pointer_cast<PointerType>(baseType);
-
-    if (!ptrType) {
-        throw std::runtime_error(std::format("{} is not a struct pointer type in field access '{}'", baseTypeStr, thisStr));
-    }
-    
-    auto structPtrType = std::dynamic_pointer_cast<StructType>(ptrType->pointeeType);
-    
-    if (!structPtrType) {
-        throw std::runtime_error(std::format("{} is not a struct pointer type in field access '{}'", baseTypeStr, thisStr));
-    }
-
-    std::string structPtrTypeStr = structPtrType->toStringPretty();
-    
-    if (!delta.count(structPtrType->name)) {
-        throw std::runtime_error(std::format("non-existent struct type {} in field access '{}'", structPtrTypeStr, thisStr));
-    }
-
-    const auto &fields = delta.at(structPtrTypeStr);
-    
-    if (!fields.count(field)) {
-         throw std::runtime_error(std::format("non-existent field {}::{} in field access '{}'", structPtrTypeStr, field, thisStr));
-    }
-    
-    return fields.at(field);
+FieldAccess::FieldAccess(NodePtr<Expression> pointer, Symbol fieldSymbol) : Place(NodeKind::FIELD_ACCESS) {
+    this->pointer = std::move(pointer);
+    this->fieldSymbol = fieldSymbol;
+    this->field = SymbolTable::global().name(fieldSymbol);
 }
 
-std::string FieldAccess::toString() const {
-    std::string ptrStr = pointer->toString();
-    return std::format("FieldAccess {{ ptr: {}, field: \"{}\" }}", ptrStr, field);
+void FieldAccess::renderParts(Renderer &renderer) const {
+    renderer.text("FieldAccess { ptr: ");
+    renderer.node(*pointer);
+    renderer.text(", field: \"");
+    renderer.text(field);
+    renderer.text("\" }");
 }
 
-void FieldAccess::accept(Visitor &visitor) {}
+void FieldAccess::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 // Function call
-FunctionCall::FunctionCall(std::unique_ptr<Expression> callee, std::vector<std::unique_ptr<Expression>> args) {
+FunctionCall::FunctionCall(NodePtr<Expression> callee, Arguments args) : Node(NodeKind::FUNCTION_CALL) {
     this->callee = std::move(callee);
     this->args = std::move(args);
 }
 
-std::shared_ptr<Type> FunctionCall::check(const Gamma &gamma, const Delta &delta) const {
-    const Identifier *directId = nullptr;
+const Type *FunctionCall::check(const Scope &gamma, const Delta &delta) const {
+    Checker checker(gamma, delta);
+    return orThrow(checker, checker.checkExpression(*this));
+}
 
-    if (auto id = dynamic_cast<Identifier*>(callee.get())) {
-        directId = id;
-    } else if (auto value = dynamic_cast<Value*>(callee.get())) {
-        directId = dynamic_cast<Identifier*>(value->place.get());
-    }
+void FunctionCall::renderParts(Renderer &renderer) const {
+    renderer.text("FunCall { callee: ");
 
-    if (directId) {
-        if (directId->name == "main") {
-            throw std::runtime_error("trying to call 'main'");
-        }
-    }
-    
-    std::shared_ptr<Type> calleeType = callee->check(gamma, delta);
-    std::shared_ptr<FunctionType> functionType = nullptr;
-    
-    if (auto directFunction = std::dynamic_pointer_cast<FunctionType>(calleeType)) {
-        functionType = directFunction;
-    } else if (auto pointerFunction = std::dynamic_pointer_cast<PointerType>(calleeType)) {
-        functionType = std::dynamic_pointer_cast<FunctionType>(pointerFunction->pointeeType);
-    }
-
-    if (!functionType) {
-         throw std::runtime_error("trying to call type " + calleeType->toStringPretty() + " as function pointer in call '" + toString() + "'");
+    if (callee) {
+        renderer.node(*callee);
+    } else {
+        renderer.text("<null>");
     }
 
-    if (args.size() != functionType->paramTypes.size()) {
-         throw std::runtime_error("incorrect number of arguments (" + std::to_string(args.size()) + " vs " + std::to_string(functionType->paramTypes.size()) + 
-                 ") in call '" + toString() + 
-                 "'");
-    }
+    renderer.text(", args: [");
 
     for (size_t i = 0; i < args.size(); i++) {
-        std::shared_ptr<Type> argType = args[i]->check(gamma, delta);
-        const auto& paramType = functionType->paramTypes[i];
-        
-        if (!typesEqual(argType, paramType)) {
-             throw std::runtime_error("incompatible argument type " + argType->toStringPretty() + " vs parameter type " + paramType->toStringPretty() + 
-                " for argument '" + args[i]->toString() + "' in call '" + toString() + 
-                "'");
-        }
+        renderer.node(*args[i]);
+        if (i < args.size() - 1) renderer.text(", ");
     }
 
-    return functionType->returnType;
+    renderer.text("] }");
 }
 
-std::string FunctionCall::toString() const {
-    std::string calleeStr = callee ? callee->toString() : "<null>";
-
-    std::stringstream ss;
-    ss << "FunCall { "; 
-    ss << "callee: " << callee->toString() << ", ";
-    ss << "args: [";
-    
-    for (size_t i = 0; i < args.size(); i++) {
-        ss << args[i]->toString();
-        if (i < args.size() - 1) ss << ", ";
-    }
-
-    ss << "] ";
-    ss << "}";
-    return ss.str();
+void FunctionCall::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void FunctionCall::accept(Visitor &visitor) {}
-
 /* Statements */
 
-// Statements
-bool Statements::check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const {
-    bool doesReturn = false;
-
-    for (const auto &statement : statements) {
-        if (doesReturn) {
-            statement->check(gamma, delta, returnType, inLoop);
-        } else {
-            doesReturn = statement->check(gamma, delta, returnType, inLoop);
-        }
-    }
+// Statement
+Statement::Statement(NodeKind kind) : Node(kind) {}
 
-    return doesReturn;
+bool Statement::check(const Scope &gamma, const Delta &delta, const Type *returnType, bool inLoop) const {
+    Checker checker(gamma, delta);
+    return orThrow(checker, checker.checkStatement(*this, returnType, inLoop));
 }
 
-std::string Statements::toString() const {
-    std::stringstream ss;
-    ss << "[";
-    
-    for (size_t i = 0; i < statements.size(); i++) {
-        ss << statements[i]->toString();
-        if (i < statements.size())
-            ss << ", ";
+// Statements
+Statements::Statements() : Statement(NodeKind::STATEMENTS) {}
+
+void Statements::renderParts(Renderer &renderer) const {
+    renderer.text("[");
+
+    // Every statement is followed by a separator, the last one included
+    for (const NodePtr<Statement> &statement : statements) {
+        renderer.node(*statement);
+        renderer.text(", ");
     }
 
-    ss << "]";
-    return ss.str();
+    renderer.text("]");
 }
 
-void Statements::accept(Visitor &visitor) {}
+void Statements::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 // Assignment
-Assignment::Assignment(std::unique_ptr<Place> place, std::unique_ptr<Expression> expression) { 
+Assignment::Assignment(NodePtr<Place> place, NodePtr<Expression> expression) : Statement(NodeKind::ASSIGNMENT) { 
     this->place = std::move(place);
     this->expression = std::move(expression);
 }
 
-bool Assignment::check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const {
-    std::shared_ptr<Type> lhsType = place->check(gamma, delta);
-    std::shared_ptr<Type> rhsType = expression->check(gamma, delta);
-
-    if (dynamic_cast<StructType*>(lhsType.get()) || dynamic_cast<FunctionType*>(lhsType.get()) || dynamic_cast<NilType*>(lhsType.get())) {
-        throw std::runtime_error("invalid type " + lhsType->toStringPretty() + " for left-hand side of assignment '" + toString() + "'");
-    }
-
-    if (!typesEqual(lhsType, rhsType)) {
-         throw std::runtime_error("incompatible types " + lhsType->toStringPretty() + " vs " + rhsType->toStringPretty() + " for assignment '" + toString() + "'");
-    }
-
-    return false;
+void Assignment::renderParts(Renderer &renderer) const {
+    renderer.text("Assign(");
+    renderer.node(*place);
+    renderer.text(", ");
+    renderer.node(*expression);
+    renderer.text(")");
 }
 
-std::string Assignment::toString() const {
-    return "Assign(" + place->toString() + ", " + expression->toString() + ")";
+void Assignment::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void Assignment::accept(Visitor &visitor) {}
-
 // CallStatement
-CallStatement::CallStatement(std::unique_ptr<FunctionCall> functionCall) {
+CallStatement::CallStatement(NodePtr<FunctionCall> functionCall) : Statement(NodeKind::CALL_STATEMENT) {
     this->functionCall = std::move(functionCall);
 }
 
-bool CallStatement::check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const {
-    functionCall->check(gamma, delta);
-    return false;
+void CallStatement::renderParts(Renderer &renderer) const {
+    renderer.text("Call(");
+    renderer.node(*functionCall);
+    renderer.text(")");
 }
 
-std::string CallStatement::toString() const {
-    return "Call(" + functionCall->toString() + ")";
+void CallStatement::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void CallStatement::accept(Visitor &visitor) {}
-
 // If
-If::If(std::unique_ptr<Expression> guard, std::unique_ptr<Statement> happyPath, std::optional<std::unique_ptr<Statement>> unhappyPath) {
+If::If(NodePtr<Expression> guard, NodePtr<Statement> happyPath, std::optional<NodePtr<Statement>> unhappyPath) : Statement(NodeKind::IF) {
     this->guard = std::move(guard);
     this->happyPath = std::move(happyPath);
     this->unhappyPath = std::move(unhappyPath);
 }
 
-bool If::check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const {
-    std::shared_ptr<Type> guardType = guard->check(gamma, delta);
+void If::renderParts(Renderer &renderer) const {
+    renderer.text("If { guard: ");
+    renderer.node(*guard);
+    renderer.text(", true: ");
+    renderer.node(*happyPath);
+    renderer.text(", unhappyPath: ");
 
-    if (!typesEqual(guardType, std::make_shared<IntType>())) {
-        throw std::runtime_error("non-int type " + guardType->toStringPretty() + " for if guard '" + guard->toString() + "'");
+    if (unhappyPath) {
+        renderer.node(**unhappyPath);
+    } else {
+        renderer.text("<None>");
     }
 
-    bool happyPathReturns = happyPath->check(gamma, delta, returnType, inLoop); 
-    bool unhappyPathReturns = unhappyPath.has_value() ? (*unhappyPath)->check(gamma, delta, returnType, inLoop) : false; 
-    return happyPathReturns && unhappyPathReturns;
+    renderer.text(" }");
 }
 
-std::string If::toString() const {
-    std::stringstream ss;
-    ss << "If { "; 
-    ss << "guard: " << guard->toString() << ", ";
-    ss << "true: " << happyPath->toString() << ", ";
-    ss << "unhappyPath: " << (unhappyPath ? (*unhappyPath)->toString() : "<None>");
-    ss << " }";
-    return ss.str();
+void If::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void If::accept(Visitor &visitor) {}
-
 // While
-While::While(std::unique_ptr<Expression> guard, std::unique_ptr<Statement> body) {
+While::While(NodePtr<Expression> guard, NodePtr<Statement> body) : Statement(NodeKind::WHILE) {
     this->guard = std::move(guard);
     this->body = std::move(body);
 }
 
-bool While::check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const {
-    std::shared_ptr<Type> guardType = guard->check(gamma, delta);
-    
-    if (!typesEqual(guardType, std::make_shared<IntType>())) {
-        throw std::runtime_error("non-int type " + guardType->toStringPretty() + " for while guard '" + guard->toString() + "'");
-    }
-
-    body->check(gamma, delta, returnType, true);
-    return false;
+void While::renderParts(Renderer &renderer) const {
+    renderer.text("While(");
+    renderer.node(*guard);
+    renderer.text(", ");
+    renderer.node(*body);
+    renderer.text(")");
 }
 
-std::string While::toString() const {
-    return "While(" + guard->toString() + ", " + body->toString() + ")";
+void While::accept(Visitor &visitor) {
+    visitor.visit(*this);
 }
 
-void While::accept(Visitor &visitor) {}
-
 // Break
-bool Break::check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const {
-    if (!inLoop) {
-        throw std::runtime_error("break outside loop");
-    }
-    return false;
-}
+Break::Break() : Statement(NodeKind::BREAK) {}
 
-std::string Break::toString() const { 
-    return "Break"; 
+void Break::renderParts(Renderer &renderer) const {
+    renderer.text("Break");
 }
 
-void Break::accept(Visitor &visitor) {}
+void Break::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 // Continue
-bool Continue::check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const {
-    if (!inLoop) {
-        throw std::runtime_error("continue outside loop");
-    }
-    return false;
-}
+Continue::Continue() : Statement(NodeKind::CONTINUE) {}
 
-std::string Continue::toString() const {
-    return "Continue";
+void Continue::renderParts(Renderer &renderer) const {
+    renderer.text("Continue");
 }
 
-void Continue::accept(Visitor &visitor) {}
+void Continue::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 // Return
-Return::Return(std::optional<std::unique_ptr<Expression>> expression) {
+Return::Return(std::optional<NodePtr<Expression>> expression) : Statement(NodeKind::RETURN) {
     this->expression = std::move(expression);
 }
 
-bool Return::check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const {
-    if (expression.has_value()) {
-        std::shared_ptr<Type> expressionType = (*expression)->check(gamma, delta);
-        
-        if (!typesEqual(expressionType, returnType)) {
-             throw std::runtime_error(
-                "incompatible return type " + 
-                expressionType->toStringPretty() + 
-                " for 'return " + (*expression)->toString() + 
-                "', should be " + returnType->toStringPretty()
-            );
-        }
+void Return::renderParts(Renderer &renderer) const {
+    renderer.text("Return(");
+
+    if (expression) {
+        renderer.node(**expression);
     } else {
-        if (!typesEqual(returnType, std::make_shared<IntType>())) {
-            throw std::runtime_error("missing return expression for non-int function type " + returnType->toStringPretty());
-        }
-        throw std::runtime_error("return statement requires an expression in this function");
+        renderer.text("<void>");
     }
-    
-    return true; 
-}
 
-std::string Return::toString() const {
-    std::stringstream ss;
-    ss << "Return(";
-    ss << (expression ? (*expression)->toString() : "<void>");
-    ss << ")";
-    return ss.str();
+    renderer.text(")");
 }
 
-void Return::accept(Visitor &visitor) {}
+void Return::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 /* Top level nodes*/
 
 // StructDefinition
-void StructDefinition::check(const Gamma &gamma, const Delta &delta) const {
+StructDefinition::StructDefinition() : Node(NodeKind::STRUCT_DEFINITION) {}
+
+std::optional<Diagnostic> StructDefinition::diagnose(const Gamma &, const Delta &delta) const {
     if (fields.empty()) {
-        throw std::runtime_error("empty struct " + name);
+        return Diagnostic{.rule = Rule::EMPTY_STRUCT, .node = this};
     }
 
-    std::set<std::string> fieldNames;
+    // Field names are resolved through the struct's own run in Delta, where a
+    // repeated name resolves to its last occurrence
+    const StructTable::Layout *layout = delta.find(SymbolTable::global().intern(name));
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        const Declaration &field = fields[i];
 
-    for (const auto& field : fields) {
-        if (dynamic_cast<NilType*>(field.type.get()) || dynamic_cast<StructType*>(field.type.get()) || dynamic_cast<FunctionType*>(field.type.get())) {
-             throw std::runtime_error("invalid type " + field.type->toStringPretty() + " for struct field " + name + "::" + field.name);
+        if (!isStorableKind(field.type->getTypeKind())) {
+            return Diagnostic{.rule = Rule::FIELD_INVALID_TYPE, .node = this, .detail = &field};
         }
         
-        if (fieldNames.find(field.name) != fieldNames.end()) {
-             throw std::runtime_error("Duplicate field name '" + field.name + "' in struct '" + name + "'");
+        if (layout && delta.fieldIndex(*layout, field.symbol) != static_cast<ptrdiff_t>(i)) {
+            return Diagnostic{.rule = Rule::DUPLICATE_FIELD, .node = this, .detail = &field};
         }
     }
+
+    return std::nullopt;
+}
+
+void StructDefinition::check(const Gamma &gamma, const Delta &delta) const {
+    if (std::optional<Diagnostic> failure = diagnose(gamma, delta)) {
+        throw std::runtime_error(::render(*failure));
+    }
 }
 
-std::string StructDefinition::toString() const {
-    std::stringstream ss;
-    ss << name << " {";
-    
+void StructDefinition::renderParts(Renderer &renderer) const {
+    renderer.text(name);
+    renderer.text(" {");
+
     for (size_t i = 0; i < fields.size(); i++) {
-        ss << fields[i].toString();
-        if (i < fields.size() - 1)
-            ss << ", ";
+        renderer.node(fields[i]);
+        if (i < fields.size() - 1) renderer.text(", ");
     }
 
-    ss << "}";
-    
-    return ss.str();
+    renderer.text("}");
 }
 
-void StructDefinition::accept(Visitor &visitor) {}
+void StructDefinition::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 // Extern
-std::string Extern::toString() const {
-    std::stringstream ss;
-    ss << "Extern { ";
-    ss << "name: \"" << name << "\", "; 
-    
-    ss << "params: [";
-    
+Extern::Extern() : Node(NodeKind::EXTERN) {}
+
+void Extern::renderParts(Renderer &renderer) const {
+    renderer.text("Extern { name: \"");
+    renderer.text(name);
+    renderer.text("\", params: [");
+
     for (size_t i = 0; i < paramTypes.size(); i++) {
-        ss << paramTypes[i]->toString();
-        if (i < paramTypes.size() - 1) {
-            ss << ", ";
-        }
+        renderer.type(*paramTypes[i]);
+        if (i < paramTypes.size() - 1) renderer.text(", ");
     }
 
-    ss << "], "; 
-    ss << "returnType: " << returnType->toString() << " }";
-    
-    return ss.str();
+    renderer.text("], returnType: ");
+    renderer.type(*returnType);
+    renderer.text(" }");
 }
 
-void Extern::accept(Visitor &visitor) {}
+void Extern::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 // FunctionDefinition
-void FunctionDefinition::check(const Gamma &gamma, const Delta &delta) const {
-    Gamma localGamma = gamma;
-    std::set<std::string> localNames; 
+FunctionDefinition::FunctionDefinition() : Node(NodeKind::FUNCTION_DEFINITION) {}
+
+std::optional<Diagnostic> FunctionDefinition::diagnoseSignature() const {
+    std::set<Symbol> localNames;
 
     for(const auto& param : params) {
-        if (dynamic_cast<NilType*>(param.type.get()) || 
-            dynamic_cast<StructType*>(param.type.get()) || 
-            dynamic_cast<FunctionType*>(param.type.get())) {
-            throw std::runtime_error("invalid type " + param.type->toStringPretty() + " for variable " + param.name + " in function " + name);
+        if (!isStorableKind(param.type->getTypeKind())) {
+            return Diagnostic{.rule = Rule::VARIABLE_INVALID_TYPE, .node = this, .detail = &param};
         }
 
-        if (localNames.find(param.name) != localNames.end()) {
-            throw std::runtime_error("Duplicate parameter/local name '" + param.name + "' in function '" + name + "'");
+        if (localNames.find(param.symbol) != localNames.end()) {
+            return Diagnostic{.rule = Rule::DUPLICATE_VARIABLE, .node = this, .detail = &param};
         }
-
-        localGamma[param.name] = param.type;
     }
     
     for(const auto& local : locals) {
-        if (dynamic_cast<NilType*>(local.type.get()) || 
-            dynamic_cast<StructType*>(local.type.get()) || 
-            dynamic_cast<FunctionType*>(local.type.get())) {
-            throw std::runtime_error("invalid type " + local.type->toStringPretty() + " for variable " + local.name + " in function " + name);
+        if (!isStorableKind(local.type->getTypeKind())) {
+            return Diagnostic{.rule = Rule::VARIABLE_INVALID_TYPE, .node = this, .detail = &local};
         }
 
-        if (localNames.find(local.name) != localNames.end()) {
-            throw std::runtime_error("Duplicate parameter/local name '" + local.name + "' in function '" + name + "'");
+        if (localNames.find(local.symbol) != localNames.end()) {
+            return Diagnostic{.rule = Rule::DUPLICATE_VARIABLE, .node = this, .detail = &local};
         }
-
-        localGamma[local.name] = local.type;
     }
 
     if (!body) {
-        throw std::runtime_error("function " + name + " has an empty body");
+        return Diagnostic{.rule = Rule::EMPTY_BODY, .node = this};
     }
 
-    if (auto statementsPointer = dynamic_cast<Statements*>(body.get())) {
-        if (statementsPointer->statements.empty()) {
-            throw std::runtime_error("function " + name + " has an empty body");
+    if (body->kind == NodeKind::STATEMENTS) {
+        if (static_cast<const Statements*>(body.get())->statements.empty()) {
+            return Diagnostic{.rule = Rule::EMPTY_BODY, .node = this};
         }
     } else {
-        throw std::runtime_error("function " + name + " has an invalid body structure (expected Stmts)");
+        return Diagnostic{.rule = Rule::BODY_NOT_STATEMENTS, .node = this};
     }
 
-    bool doesReturn = body->check(localGamma, delta, returnType, false);
+    return std::nullopt;
+}
+
+std::optional<Diagnostic> FunctionDefinition::diagnoseDeclarations(Scope &localGamma) const {
+    if (std::optional<Diagnostic> failure = diagnoseSignature()) {
+        return failure;
+    }
+
+    for (const auto &param : params) {
+        localGamma.declare(param.symbol, param.type);
+    }
+
+    for (const auto &local : locals) {
+        localGamma.declare(local.symbol, local.type);
+    }
+
+    return std::nullopt;
+}
+
+std::optional<Diagnostic> FunctionDefinition::diagnose(const Gamma &gamma, const Delta &delta, TypeTable *types, CancelToken cancel) const {
+    // Locals shadow the shared global layer instead of copying it per function
+    Scope localGamma(gamma);
+
+    if (std::optional<Diagnostic> failure = diagnoseDeclarations(localGamma)) {
+        return failure;
+    }
+
+    Checker checker(localGamma, delta, types, cancel);
+    bool doesReturn = checker.checkStatement(*body, returnType.get(), false);
+
+    if (checker.failure()) {
+        return checker.failure();
+    }
 
     if (!doesReturn) {
-        throw std::runtime_error("function " + name + " may not execute a return");
+        return Diagnostic{.rule = Rule::MISSING_RETURN, .node = this};
     }
+
+    return std::nullopt;
 }
 
-std::string FunctionDefinition::toString() const {
-    std::stringstream ss;
-    ss << "Function { name: \"" << name << "\", "; 
-    ss << " params: [";
-    
+void FunctionDefinition::check(const Gamma &gamma, const Delta &delta) const {
+    if (std::optional<Diagnostic> failure = diagnose(gamma, delta)) {
+        throw std::runtime_error(::render(*failure));
+    }
+}
+
+void FunctionDefinition::renderParts(Renderer &renderer) const {
+    renderer.text("Function { name: \"");
+    renderer.text(name);
+    renderer.text("\",  params: [");
+
     for (size_t i = 0; i < params.size(); i++) {
-        ss << params[i].toString();
-        if (i < params.size() - 1)
-            ss << ", ";
+        renderer.node(params[i]);
+        if (i < params.size() - 1) renderer.text(", ");
     }
-    
-    ss << "], "; 
-    ss << "returnType: " << returnType << ", "; 
-    
-    ss << "locals: {";
-    
+
+    renderer.text("], returnType: ");
+    renderer.type(*returnType);
+    renderer.text(", locals: {");
+
     for (size_t i = 0; i < locals.size(); i++) {
-        ss << locals[i].toString();
-        if (i < locals.size() - 1)
-            ss << ", ";
+        renderer.node(locals[i]);
+        if (i < locals.size() - 1) renderer.text(", ");
     }
 
-    ss << "}, ";
-    ss << "body: " << body->toString() << " }";
-    
-    return ss.str();
+    renderer.text("}, body: ");
+    renderer.node(*body);
+    renderer.text(" }");
 }
 
-void FunctionDefinition::accept(Visitor &visitor) {}
+void FunctionDefinition::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
 
 // Program
-void Program::check() const {
+
+// Checks one function, answering from the cache when its key is already known
+static std::optional<Diagnostic> diagnoseFunction(const FunctionDefinition &function, const Gamma &gamma, const Delta &delta, CheckCache *cache, bool flat, TypeTable *types, CancelToken cancel = {}) {
+    memory::checkLimit();
+
+    // Neither a cached verdict nor the flat checker leaves types behind
+    if (types) {
+        return function.diagnose(gamma, delta, types, cancel);
+    }
+
+    if (!cache) {
+        return flat ? diagnoseFlat(function, gamma, delta, cancel) : function.diagnose(gamma, delta, nullptr, cancel);
+    }
+
+    uint64_t key = functionKey(function, gamma, delta);
+    CheckCache::Verdict verdict;
+
+    if (cache->lookup(key, verdict)) {
+        if (verdict) {
+            return Diagnostic{.rule = verdict->rule, .node = &function, .cachedMessage = std::move(verdict->message)};
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<Diagnostic> failure = flat ? diagnoseFlat(function, gamma, delta, cancel) : function.diagnose(gamma, delta, nullptr, cancel);
+
+    // A cancelled check never learnt the function's verdict
+    if (!failure || failure->rule != Rule::CANCELLED) {
+        cache->store(key, failure ? CheckCache::Verdict({failure->rule, ::render(*failure)}) : std::nullopt);
+    }
+
+    return failure;
+}
+
+Program::Program() : Node(NodeKind::PROGRAM) {}
+
+Program::~Program() {
+    std::vector<NodePtr<Node>> roots;
+
+    for (auto &s : structs) {
+        roots.push_back(std::move(s));
+    }
+
+    for (auto &f : functions) {
+        roots.push_back(std::move(f));
+    }
+
+    destroyTree(std::move(roots));
+}
+
+std::optional<Diagnostic> Program::diagnose(ThreadPool *pool, CheckCache *cache, bool flat, TypeTable *types) const {
     std::set<std::string> topLevelNames;
     
     for (const auto &s : structs) {
         if (topLevelNames.find(s->name) != topLevelNames.end()) {
-            throw std::runtime_error("Duplicate name: " + s->name);
+            return Diagnostic{.rule = Rule::DUPLICATE_NAME, .name = s->name};
         } 
     }
     
     for (const auto &e : externs) {
         if (topLevelNames.find(e.name) != topLevelNames.end()) {
-            throw std::runtime_error("Duplicate name: " + e.name);
+            return Diagnostic{.rule = Rule::DUPLICATE_NAME, .name = e.name};
         }
     }
     
     for (const auto &f : functions) {
         if (f->name != "main" && topLevelNames.find(f->name) != topLevelNames.end()) {
-            throw std::runtime_error("Duplicate name: " + f->name);
+            return Diagnostic{.rule = Rule::DUPLICATE_NAME, .name = f->name};
         } 
     }
 
-    Gamma gamma = constructGamma(externs, functions);
-    Delta delta = constructDelta(structs);
+    Gamma gamma;
+    Delta delta;
+
+    {
+        stats::PhaseTimer timer(stats::Phase::GAMMA);
+        gamma = constructGamma(externs, functions);
+    }
+
+    {
+        stats::PhaseTimer timer(stats::Phase::DELTA);
+        delta = constructDelta(structs);
+    }
 
     bool mainFound = false;
     
     for (const auto &f : functions) {
         if (f->name == "main") {
-            if (f->params.empty() && typesEqual(f->returnType, std::make_shared<IntType>())) {
+            if (f->params.empty() && typesEqual(f->returnType, INT_TYPE)) {
                 mainFound = true;
             }         
         }
     }
 
     if (!mainFound) {
-        throw std::runtime_error("no 'main' function with type '() -> int' exists");
+        return Diagnostic{.rule = Rule::NO_MAIN};
     }
 
-    for (const auto &s : structs) {
-        s->check(gamma, delta);
+    // A program has at most one error, so the rules that need no body are all
+    // settled first, and a program whose error is in a struct or a signature
+    // is answered without checking a single body
+    {
+        stats::PhaseTimer timer(stats::Phase::STRUCTS);
+
+        for (const auto &s : structs) {
+            if (std::optional<Diagnostic> failure = s->diagnose(gamma, delta)) {
+                return failure;
+            }
+        }
     }
 
-    for (const auto &f : functions) {
-        f->check(gamma, delta);
+    {
+        stats::PhaseTimer timer(stats::Phase::SIGNATURES);
+
+        for (const auto &f : functions) {
+            if (std::optional<Diagnostic> failure = f->diagnoseSignature()) {
+                return failure;
+            }
+        }
+    }
+
+    if (!pool || pool->size() == 1) {
+        stats::PhaseTimer timer(stats::Phase::FUNCTIONS);
+
+        for (const auto &f : functions) {
+            if (std::optional<Diagnostic> failure = diagnoseFunction(*f, gamma, delta, cache, flat, types)) {
+                return failure;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // Bodies only read Gamma and Delta, so they can be checked in any order.
+    // Failures are kept per function and the earliest one in source order is
+    // returned, exactly as the serial loop above would report it. A function
+    // whose check fails cancels every function after it, which either never
+    // starts or stops partway with a CANCELLED result that is never reached.
+    // Anything else thrown, such as std::bad_alloc, is rethrown the same way.
+    std::vector<std::optional<Diagnostic>> failures(functions.size());
+    std::vector<std::exception_ptr> errors(functions.size());
+    Cancellation cancellation;
+
+    pool->parallelFor(functions.size(), [&](size_t i) {
+        if (cancellation.cancelled(i)) {
+            return;
+        }
+
+        // Timed per function, so this phase adds up the time spent on every thread
+        stats::PhaseTimer timer(stats::Phase::FUNCTIONS);
+
+        try {
+            failures[i] = diagnoseFunction(*functions[i], gamma, delta, cache, flat, types, {&cancellation, i});
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+
+        if (failures[i] || errors[i]) {
+            cancellation.fail(i);
+        }
+    });
+
+    for (size_t i = 0; i < functions.size(); i++) {
+        if (errors[i]) {
+            std::rethrow_exception(errors[i]);
+        }
+
+        if (failures[i]) {
+            return std::move(failures[i]);
+        }
+    }
+
+    return std::nullopt;
+}
+
+void Program::check(ThreadPool *pool, CheckCache *cache, bool flat) const {
+    if (std::optional<Diagnostic> failure = diagnose(pool, cache, flat)) {
+        throw std::runtime_error(::render(*failure));
     }
 }
 
-std::string Program::toString() const {
-    std::stringstream ss;
-    ss << "Program { ";
+void Program::renderParts(Renderer &renderer) const {
+    renderer.text("Program { structs: { ");
 
-    ss << "structs: { ";
-    
-    for (size_t i = 0; i < structs.size(); i++) {    
-        ss << structs[i]->toString();
-        if (i < structs.size() - 1) ss << ", ";
+    for (size_t i = 0; i < structs.size(); i++) {
+        renderer.node(*structs[i]);
+        if (i < structs.size() - 1) renderer.text(", ");
     }
-    
-    ss << "}, ";
-    ss << "externs: {";
-    
+
+    renderer.text("}, externs: {");
+
     for (size_t i = 0; i < externs.size(); i++) {
-        ss << externs[i].toString();
-        if (i < externs.size() - 1) ss << ", ";
+        renderer.node(externs[i]);
+        if (i < externs.size() - 1) renderer.text(", ");
     }
-    
-    ss << "}, "; 
-    ss << "functions: {";
-    
+
+    renderer.text("}, functions: {");
+
     for (size_t i = 0; i < functions.size(); i++) {
-        ss << functions[i]->toString();
-        if (i < functions.size() - 1) ss << ", ";
+        renderer.node(*functions[i]);
+        if (i < functions.size() - 1) renderer.text(", ");
     }
 
-    ss << "} }";
-    
-    return ss.str();
+    renderer.text("} }");
 }
 
-void Program::accept(Visitor &visitor) {}
+void Program::accept(Visitor &visitor) {
+    visitor.visit(*this);
+}
@@ -1,8 +1,13 @@
 #ifndef AST_HPP
 #define AST_HPP
 
+#include <cstdint>
 #include <optional>
 
+#include "arena.hpp"
+#include "cancel.hpp"
+#include "diagnostic.hpp"
+#include "smallvector.hpp"
 #include "types.hpp"
 #include "visitor.hpp"
 
@@ -51,37 +56,111 @@ struct Extern;
 struct FunctionDefinition;
 struct Program;
 
+class Renderer;
+class ThreadPool;
+class CheckCache;
+class TypeTable;
+
+// Child lists, with inline room for their usual sizes: calls rarely pass more
+// than four arguments, blocks and signatures are short and most structs have
+// fewer than eight fields
+using Arguments = SmallVector<NodePtr<Expression>, 4>;
+using StatementList = SmallVector<NodePtr<Statement>, 4>;
+using Fields = SmallVector<Declaration, 8>;
+using Variables = SmallVector<Declaration, 4>;
+
+// The concrete type of a node, so hot paths can switch on it and static_cast
+// rather than going through dynamic_cast
+enum class NodeKind {
+    // Declarations
+    DECLARATION,
+
+    // Expressions
+    VALUE,
+    NUMBER,
+    NIL,
+    SELECT,
+    UNARY_OPERATION,
+    BINARY_OPERATION,
+    NEW_SINGLETON,
+    NEW_ARRAY,
+    CALL_EXPRESSION,
+
+    // Places
+    IDENTIFIER,
+    DEREFERENCE,
+    ARRAY_ACCESS,
+    FIELD_ACCESS,
+
+    // Function call
+    FUNCTION_CALL,
+
+    // Statements
+    STATEMENTS,
+    ASSIGNMENT,
+    CALL_STATEMENT,
+    IF,
+    WHILE,
+    BREAK,
+    CONTINUE,
+    RETURN,
+
+    // High level nodes
+    STRUCT_DEFINITION,
+    EXTERN,
+    FUNCTION_DEFINITION,
+    PROGRAM,
+};
+
 // Node
 struct Node {
+    NodeKind kind;
+    // Pre-order position in its tree once assignNodeIds (traversal.hpp) has run;
+    // keys side tables such as TypeTable. Sits in the padding after kind.
+    uint32_t id = 0;
+
+    explicit Node(NodeKind kind);
     virtual ~Node() = default;
-    virtual std::string toString() const = 0;
+    // Appends the debug form of the node to out, so a whole tree is rendered
+    // into one growing buffer without recursing (see render.hpp); toString()
+    // is the same in a fresh string
+    void render(std::string &out) const;
+    // Lists the node's parts to a Renderer, which renders its children in turn
+    virtual void renderParts(Renderer &renderer) const = 0;
+    std::string toString() const;
     virtual void accept(Visitor &visitor) = 0;
 };
 
 // Declaration
 struct Declaration : public Node {
-    std::string name;
+    Symbol symbol;
+    std::string_view name;
     std::shared_ptr<Type> type;
 
-    Declaration(std::string name, std::shared_ptr<Type> type);
-    std::string toString() const override; 
+    Declaration(std::string_view name, std::shared_ptr<Type> type);
+    Declaration(Symbol symbol, std::shared_ptr<Type> type);
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 // --------------------------------- Expressions -----------------------------------------
 struct Expression : public Node {
-    virtual std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const = 0;
-    virtual std::string toString() const override = 0;
+    explicit Expression(NodeKind kind);
+
+    // Runs the typing rules in checker.hpp over this expression. This and the
+    // other check() methods throw std::runtime_error with the rendered message
+    // of the first failed rule; the diagnose() methods return it instead.
+    const Type *check(const Scope &gamma, const Delta &delta) const;
+    virtual void renderParts(Renderer &renderer) const override = 0;
     virtual void accept(Visitor &visitor) override = 0;
 };
 
 struct Value : public Expression {
-    std::unique_ptr<Place> place;
+    NodePtr<Place> place;
     
-    explicit Value(std::unique_ptr<Place> place);
+    explicit Value(NodePtr<Place> place);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
@@ -90,26 +169,25 @@ struct Number : public Expression {
     
     explicit Number(long long value);
 
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct Nil : public Expression {
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    Nil();
+
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct Select : public Expression {
-    std::unique_ptr<Expression> guard;
-    std::unique_ptr<Expression> ttCase;
-    std::unique_ptr<Expression> ffCase;
+    NodePtr<Expression> guard;
+    NodePtr<Expression> ttCase;
+    NodePtr<Expression> ffCase;
     
-    Select(std::unique_ptr<Expression> guard, std::unique_ptr<Expression> ttCase, std::unique_ptr<Expression> ffCase);
+    Select(NodePtr<Expression> guard, NodePtr<Expression> ttCase, NodePtr<Expression> ffCase);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
@@ -120,12 +198,11 @@ enum class UnaryOperand {
 
 struct UnaryOperation : public Expression {
     UnaryOperand operand;
-    std::unique_ptr<Expression> expression;
+    NodePtr<Expression> expression;
     
-    UnaryOperation(UnaryOperand operand, std::unique_ptr<Expression> expression);
+    UnaryOperation(UnaryOperand operand, NodePtr<Expression> expression);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
@@ -144,15 +221,18 @@ enum class BinaryOperand {
     GTE
 };
 
+// The .astj spellings of the operators, "Neg", "Add", ...
+extern std::string_view unaryOperandToString(UnaryOperand op);
+extern std::string_view binaryOperandToString(BinaryOperand op);
+
 struct BinaryOperation : public Expression {
     BinaryOperand operand;
-    std::unique_ptr<Expression> lhs;
-    std::unique_ptr<Expression> rhs;
+    NodePtr<Expression> lhs;
+    NodePtr<Expression> rhs;
     
-    BinaryOperation(BinaryOperand operand, std::unique_ptr<Expression> lhs, std::unique_ptr<Expression> rhs);
+    BinaryOperation(BinaryOperand operand, NodePtr<Expression> lhs, NodePtr<Expression> rhs);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
@@ -161,212 +241,244 @@ struct NewSingleton : public Expression {
     
     explicit NewSingleton(std::shared_ptr<Type> type);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct NewArray : public Expression {
     std::shared_ptr<Type> type;
-    std::unique_ptr<Expression> size;
+    NodePtr<Expression> size;
     
-    NewArray(std::shared_ptr<Type> type, std::unique_ptr<Expression> size);
+    NewArray(std::shared_ptr<Type> type, NodePtr<Expression> size);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct CallExpression : public Expression {
-    std::unique_ptr<FunctionCall> functionCall;
+    NodePtr<FunctionCall> functionCall;
     
-    explicit CallExpression(std::unique_ptr<FunctionCall> functionCall);
+    explicit CallExpression(NodePtr<FunctionCall> functionCall);
 
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 // --------------------------------- Places -----------------------------------------
 struct Place : public Node {
-    virtual std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const = 0;
-    virtual std::string toString() const override = 0;
+    explicit Place(NodeKind kind);
+
+    const Type *check(const Scope &gamma, const Delta &delta) const;
+    virtual void renderParts(Renderer &renderer) const override = 0;
     virtual void accept(Visitor &visitor) override = 0;
 };
 
 struct Identifier : public Place {
-    std::string name;
+    Symbol symbol;
+    std::string_view name;
     
-    explicit Identifier(std::string name);
+    explicit Identifier(std::string_view name);
+    explicit Identifier(Symbol symbol);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct Dereference : public Place {
-    std::unique_ptr<Expression> expression;
+    NodePtr<Expression> expression;
     
-    explicit Dereference(std::unique_ptr<Expression> expression);
+    explicit Dereference(NodePtr<Expression> expression);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct ArrayAccess : public Place {
-    std::unique_ptr<Expression> array;
-    std::unique_ptr<Expression> index;
+    NodePtr<Expression> array;
+    NodePtr<Expression> index;
 
-    ArrayAccess(std::unique_ptr<Expression> array, std::unique_ptr<Expression> index);
+    ArrayAccess(NodePtr<Expression> array, NodePtr<Expression> index);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct FieldAccess : public Place {
-    std::unique_ptr<Expression> pointer;
-    std::string field;
+    NodePtr<Expression> pointer;
+    Symbol fieldSymbol;
+    std::string_view field;
 
-    FieldAccess(std::unique_ptr<Expression> pointer, std::string field);
+    FieldAccess(NodePtr<Expression> pointer, std::string_view field);
+    FieldAccess(NodePtr<Expression> pointer, Symbol fieldSymbol);
     
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 // Function call
 struct FunctionCall: Node {
-    std::unique_ptr<Expression> callee;
-    std::vector<std::unique_ptr<Expression>> args;
+    NodePtr<Expression> callee;
+    Arguments args;
 
-    FunctionCall(std::unique_ptr<Expression> callee, std::vector<std::unique_ptr<Expression>> args);
+    FunctionCall(NodePtr<Expression> callee, Arguments args);
         
-    std::shared_ptr<Type> check(const Gamma &gamma, const Delta &delta) const;
-    std::string toString() const override;
+    const Type *check(const Scope &gamma, const Delta &delta) const;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 // ------------------------------------ Statements --------------------------------
 struct Statement : public Node {
-    virtual bool check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const = 0;
+    explicit Statement(NodeKind kind);
+
+    // Whether the statement is guaranteed to execute a return
+    bool check(const Scope &gamma, const Delta &delta, const Type *returnType, bool inLoop) const;
 };
 
 struct Statements : public Statement {
-    std::vector<std::unique_ptr<Statement>> statements;
+    StatementList statements;
     
-    bool check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const override;
-    std::string toString() const override;
+    Statements();
+
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct Assignment : public Statement {
-    std::unique_ptr<Place> place;
-    std::unique_ptr<Expression> expression;
+    NodePtr<Place> place;
+    NodePtr<Expression> expression;
 
-    Assignment(std::unique_ptr<Place> place, std::unique_ptr<Expression> expression);
+    Assignment(NodePtr<Place> place, NodePtr<Expression> expression);
     
-    bool check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct CallStatement : public Statement {
-    std::unique_ptr<FunctionCall> functionCall;
+    NodePtr<FunctionCall> functionCall;
 
-    explicit CallStatement(std::unique_ptr<FunctionCall> functionCall);
+    explicit CallStatement(NodePtr<FunctionCall> functionCall);
     
-    bool check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct If : public Statement {
-    std::unique_ptr<Expression> guard;
-    std::unique_ptr<Statement> happyPath;
-    std::optional<std::unique_ptr<Statement>> unhappyPath;
+    NodePtr<Expression> guard;
+    NodePtr<Statement> happyPath;
+    std::optional<NodePtr<Statement>> unhappyPath;
 
-    If(std::unique_ptr<Expression> guard, std::unique_ptr<Statement> happyPath, std::optional<std::unique_ptr<Statement>> unhappyPath);
+    If(NodePtr<Expression> guard, NodePtr<Statement> happyPath, std::optional<NodePtr<Statement>> unhappyPath);
     
-    bool check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct While : public Statement {
-    std::unique_ptr<Expression> guard;
-    std::unique_ptr<Statement> body;
+    NodePtr<Expression> guard;
+    NodePtr<Statement> body;
 
-    While(std::unique_ptr<Expression> guard, std::unique_ptr<Statement> body);
+    While(NodePtr<Expression> guard, NodePtr<Statement> body);
 
-    bool check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct Break : public Statement {
-    bool check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const override;
-    std::string toString() const override;
+    Break();
+
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct Continue : public Statement {
-    bool check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const override;
-    std::string toString() const override;
+    Continue();
+
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct Return : public Statement {
-    std::optional<std::unique_ptr<Expression>> expression;
+    std::optional<NodePtr<Expression>> expression;
     
-    explicit Return(std::optional<std::unique_ptr<Expression>> expression);
+    explicit Return(std::optional<NodePtr<Expression>> expression);
 
-    bool check(const Gamma &gamma, const Delta &delta, const std::shared_ptr<Type> &returnType, bool inLoop) const override;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 // ------------------------------------ Top level nodes --------------------------------
 struct StructDefinition : public Node {
     std::string name;
-    std::vector<Declaration> fields;
+    Fields fields;
 
+    StructDefinition();
+
+    std::optional<Diagnostic> diagnose(const Gamma &gamma, const Delta &delta) const;
     void check(const Gamma &gamma, const Delta &delta) const;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 struct Extern : public Node {
     std::string name;
-    std::vector<std::shared_ptr<Type>> paramTypes;
+    TypeList paramTypes;
     std::shared_ptr<Type> returnType;
 
-    std::string toString() const override;
+    Extern();
+
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 
 struct FunctionDefinition : public Node {
     std::string name;
-    std::vector<Declaration> params;
+    Variables params;
     std::shared_ptr<Type> returnType;
-    std::vector<Declaration> locals;
-    std::unique_ptr<Statement> body;
-
+    Variables locals;
+    NodePtr<Statement> body;
+
+    FunctionDefinition();
+
+    // The premises on params, locals and the shape of the body, which need
+    // nothing but the function itself
+    std::optional<Diagnostic> diagnoseSignature() const;
+    // diagnoseSignature, then declaring every variable into scope
+    std::optional<Diagnostic> diagnoseDeclarations(Scope &scope) const;
+    // With a table, the type of every expression in the body is recorded in it.
+    // Once cancel is cancelled the body check stops with Rule::CANCELLED.
+    std::optional<Diagnostic> diagnose(const Gamma &gamma, const Delta &delta, TypeTable *types = nullptr, CancelToken cancel = {}) const;
     void check(const Gamma &gamma, const Delta &delta) const;
-    std::string toString() const override;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
 
 struct Program : public Node {
-    std::vector<std::unique_ptr<StructDefinition>> structs;
+    // Declared first so it outlives, and is released after, every node it backs
+    std::unique_ptr<Arena> arena;
+    std::vector<NodePtr<StructDefinition>> structs;
     std::vector<Extern> externs;
-    std::vector<std::unique_ptr<FunctionDefinition>> functions;
-
-    void check() const;
-    std::string toString() const override;
+    std::vector<NodePtr<FunctionDefinition>> functions;
+
+    Program();
+
+    // Tears the tree down iteratively; see destroyTree in traversal.hpp
+    ~Program() override;
+
+    // Structs and function signatures are checked before any body, so a
+    // failure in one of them is reported ahead of any in a body. With a pool,
+    // bodies are checked in parallel, and give up as soon as an earlier one
+    // fails. With a cache, functions whose verdict is already known are not
+    // checked again. Either way the result is the first failed rule in that
+    // order, if any.
+    // With flat, function bodies are checked through flat.hpp instead of the tree.
+    // With a TypeTable sized by assignNodeIds, every function is walked by the
+    // tree checker so its types can be recorded, whatever cache and flat say.
+    std::optional<Diagnostic> diagnose(ThreadPool *pool = nullptr, CheckCache *cache = nullptr, bool flat = false, TypeTable *types = nullptr) const;
+    void check(ThreadPool *pool = nullptr, CheckCache *cache = nullptr, bool flat = false) const;
+    void renderParts(Renderer &renderer) const override;
     void accept(Visitor &visitor) override;
 };
 
@@ -0,0 +1,313 @@
+// Generates synthetic Cflat ASTs in the .astj format for benchmarking.
+//
+//   astgen [--functions N] [--structs M] [--depth D] [--fanout F] [--places P] [--nest K] [--seed S] [--invalid]
+//
+// The program has M structs, each pointing at the next, and N functions
+// f0..f{N-1}. Each function assigns an int expression of depth D (a full
+// binary tree of about 2^D leaves) to a local, makes F calls to earlier
+// functions, and runs an if and a while loop. main calls the last function.
+// With --places P, each function also reads an int through one place chain
+// of P hops from struct to struct, each hop a FieldAccess, an ArrayAccess or
+// a Deref in turn, so places nest about 2P levels deep. With --nest K, each
+// function also assigns a local an int negated K times over, one expression
+// K levels deep.
+// The output is a valid program unless --invalid is given, which plants one
+// type error at the end of the last function so that everything before it is
+// still checked. With --nest, the planted error assigns such an expression to
+// a struct pointer, so its message spells out all K levels.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+struct Options {
+    unsigned functions = 1000;
+    unsigned structs = 10;
+    unsigned depth = 6;
+    unsigned fanout = 2;
+    unsigned places = 0;
+    unsigned nest = 0;
+    unsigned long seed = 1;
+    bool invalid = false;
+};
+
+class Generator {
+public:
+    explicit Generator(const Options &options) : options(options), random(options.seed) {}
+
+    void write(std::ostream &out) {
+        out << "{\"structs\": [";
+
+        for (unsigned i = 0; i < options.structs; i++) {
+            out << (i ? ", " : "") << structDefinition(i);
+        }
+
+        out << "], \"externs\": [], \"functions\": [";
+
+        for (unsigned i = 0; i < options.functions; i++) {
+            out << function(i) << ", ";
+        }
+
+        out << mainFunction() << "]}\n";
+    }
+
+private:
+    static std::string quote(const std::string &text) {
+        return "\"" + text + "\"";
+    }
+
+    static std::string structName(unsigned i) {
+        return "S" + std::to_string(i);
+    }
+
+    static std::string functionName(unsigned i) {
+        return "f" + std::to_string(i);
+    }
+
+    static std::string declaration(const std::string &name, const std::string &type) {
+        return "{\"name\": " + quote(name) + ", \"typ\": " + type + "}";
+    }
+
+    static std::string structPointer(unsigned i) {
+        return "{\"Ptr\": {\"Struct\": " + quote(structName(i)) + "}}";
+    }
+
+    static std::string number(long long value) {
+        return "{\"Num\": " + std::to_string(value) + "}";
+    }
+
+    static std::string id(const std::string &name) {
+        return "{\"Id\": " + quote(name) + "}";
+    }
+
+    static std::string value(const std::string &place) {
+        return "{\"Val\": " + place + "}";
+    }
+
+    static std::string fieldAccess(const std::string &pointer, const std::string &field) {
+        return "{\"FieldAccess\": {\"ptr\": " + pointer + ", \"field\": " + quote(field) + "}}";
+    }
+
+    static std::string deref(const std::string &pointer) {
+        return "{\"Deref\": " + pointer + "}";
+    }
+
+    static std::string arrayAccess(const std::string &array, const std::string &index) {
+        return "{\"ArrayAccess\": {\"array\": " + array + ", \"idx\": " + index + "}}";
+    }
+
+    static std::string binaryOperation(const char *op, const std::string &lhs, const std::string &rhs) {
+        return "{\"BinOp\": {\"op\": " + quote(op) + ", \"left\": " + lhs + ", \"right\": " + rhs + "}}";
+    }
+
+    static std::string assign(const std::string &place, const std::string &expression) {
+        return "{\"Assign\": [" + place + ", " + expression + "]}";
+    }
+
+    static std::string call(unsigned callee, const std::string &arg) {
+        return "{\"Call\": {\"callee\": " + value(id(functionName(callee))) + ", \"args\": [" + arg + ", \"Nil\"]}}";
+    }
+
+    unsigned pick(unsigned count) {
+        return std::uniform_int_distribution<unsigned>(0, count - 1)(random);
+    }
+
+    std::string structDefinition(unsigned i) {
+        unsigned next = (i + 1) % options.structs;
+        std::string fields = declaration("a", "\"Int\"") + ", " +
+                             declaration("next", structPointer(next)) + ", " +
+                             declaration("items", "{\"Array\": \"Int\"}");
+
+        // The other two ways a place chain gets to the next struct
+        if (options.places) {
+            fields += ", " + declaration("links", "{\"Array\": " + structPointer(next) + "}") +
+                      ", " + declaration("ref", "{\"Ptr\": " + structPointer(next) + "}");
+        }
+
+        return "{\"name\": " + quote(structName(i)) + ", \"fields\": [" + fields + "]}";
+    }
+
+    // An int-typed leaf reading a param, a local, a struct field or an array element
+    std::string leaf() {
+        switch (pick(6)) {
+            case 0:
+                return number(pick(100));
+            case 1:
+                return value(id("n"));
+            case 2:
+                return value(id("x"));
+            case 3:
+                return value(fieldAccess(value(id("p")), "a"));
+            case 4:
+                return value(fieldAccess(value(fieldAccess(value(id("p")), "next")), "a"));
+            default:
+                return value(arrayAccess(value(id("items")), number(pick(16))));
+        }
+    }
+
+    // p.next, p.links[0] and *p.ref, in turn, places times over, then .a
+    std::string placeChain(unsigned places) {
+        std::string pointer = value(id("p"));
+
+        for (unsigned hop = 0; hop < places; hop++) {
+            switch (hop % 3) {
+                case 0:
+                    pointer = value(fieldAccess(pointer, "next"));
+                    break;
+                case 1:
+                    pointer = value(arrayAccess(value(fieldAccess(pointer, "links")), number(0)));
+                    break;
+                default:
+                    pointer = value(deref(value(fieldAccess(pointer, "ref"))));
+                    break;
+            }
+        }
+
+        return value(fieldAccess(pointer, "a"));
+    }
+
+    // UnOp(Neg, ...) levels times around a number, built without recursing
+    static std::string negations(unsigned levels) {
+        static const std::string OPEN = "{\"UnOp\": [\"Neg\", ";
+        std::string expression;
+        expression.reserve(levels * (OPEN.size() + 2) + 16);
+
+        for (unsigned i = 0; i < levels; i++) {
+            expression += OPEN;
+        }
+
+        expression += number(1);
+
+        for (unsigned i = 0; i < levels; i++) {
+            expression += "]}";
+        }
+
+        return expression;
+    }
+
+    std::string intExpression(unsigned depth) {
+        if (depth == 0) {
+            return leaf();
+        }
+
+        static const char *const OPERATORS[] = {"Add", "Sub", "Mul", "Div"};
+
+        switch (pick(8)) {
+            case 0:
+                return "{\"UnOp\": [\"Neg\", " + intExpression(depth - 1) + "]}";
+            case 1:
+                return "{\"Select\": {\"guard\": " + leaf() + ", \"tt\": " + intExpression(depth - 1) +
+                       ", \"ff\": " + intExpression(depth - 1) + "}}";
+            default:
+                return binaryOperation(OPERATORS[pick(4)], intExpression(depth - 1), intExpression(depth - 1));
+        }
+    }
+
+    std::string function(unsigned i) {
+        unsigned own = i % options.structs;
+        std::string body;
+
+        body += assign(id("x"), intExpression(options.depth));
+        body += ", " + assign(id("items"), "{\"NewArray\": [\"Int\", " + number(16) + "]}");
+        body += ", " + assign(id("q"), "{\"NewSingle\": {\"Struct\": " + quote(structName(own)) + "}}");
+
+        if (options.places) {
+            body += ", " + assign(id("x"), placeChain(options.places));
+        }
+
+        if (options.nest) {
+            body += ", " + assign(id("x"), negations(options.nest));
+        }
+
+        for (unsigned k = 0; i > 0 && k < options.fanout; k++) {
+            body += ", " + assign(id("x"), call(pick(i), intExpression(1)));
+        }
+
+        body += ", {\"If\": {\"guard\": " + binaryOperation("Lt", value(id("x")), number(10)) +
+                ", \"tt\": [" + assign(id("x"), binaryOperation("Add", value(id("x")), number(1))) + "]" +
+                ", \"ff\": [" + assign(id("x"), binaryOperation("Sub", value(id("x")), number(1))) + "]}}";
+
+        body += ", {\"While\": [" + binaryOperation("Gt", value(id("x")), number(0)) + ", [" +
+                assign(id("x"), binaryOperation("Sub", value(id("x")), number(1))) + ", " +
+                "{\"If\": {\"guard\": " + binaryOperation("Eq", value(id("x")), number(5)) + ", \"tt\": [\"Break\"]}}]]}";
+
+        if (options.invalid && i + 1 == options.functions) {
+            body += ", " + (options.nest ? assign(id("q"), negations(options.nest)) : assign(id("x"), value(id("p"))));
+        }
+
+        body += ", {\"Return\": " + value(id("x")) + "}";
+
+        return "{\"name\": " + quote(functionName(i)) +
+               ", \"prms\": [" + declaration("n", "\"Int\"") + ", " + declaration("p", structPointer(own)) + "]" +
+               ", \"rettyp\": \"Int\"" +
+               ", \"locals\": [" + declaration("x", "\"Int\"") + ", " + declaration("q", structPointer(own)) + ", " +
+               declaration("items", "{\"Array\": \"Int\"}") + "]" +
+               ", \"stmts\": [" + body + "]}";
+    }
+
+    std::string mainFunction() {
+        std::string result = options.functions ? call(options.functions - 1, number(1)) : number(0);
+        return "{\"name\": \"main\", \"prms\": [], \"rettyp\": \"Int\", \"locals\": [], \"stmts\": [{\"Return\": " + result + "}]}";
+    }
+
+    const Options &options;
+    std::mt19937_64 random;
+};
+
+int usage(const char *program) {
+    std::cerr << "Usage: " << program << " [--functions N] [--structs M] [--depth D] [--fanout F] [--places P] [--nest K] [--seed S] [--invalid]" << std::endl;
+    return 1;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        auto number = [&](unsigned long &value) {
+            if (i + 1 >= argc) {
+                return false;
+            }
+
+            char *end = nullptr;
+            value = std::strtoul(argv[++i], &end, 10);
+            return *end == '\0';
+        };
+
+        unsigned long value = 0;
+
+        if (std::strcmp(argv[i], "--invalid") == 0) {
+            options.invalid = true;
+        } else if (std::strcmp(argv[i], "--functions") == 0 && number(value)) {
+            options.functions = static_cast<unsigned>(value);
+        } else if (std::strcmp(argv[i], "--structs") == 0 && number(value)) {
+            options.structs = static_cast<unsigned>(value);
+        } else if (std::strcmp(argv[i], "--depth") == 0 && number(value)) {
+            options.depth = static_cast<unsigned>(value);
+        } else if (std::strcmp(argv[i], "--fanout") == 0 && number(value)) {
+            options.fanout = static_cast<unsigned>(value);
+        } else if (std::strcmp(argv[i], "--places") == 0 && number(value)) {
+            options.places = static_cast<unsigned>(value);
+        } else if (std::strcmp(argv[i], "--nest") == 0 && number(value)) {
+            options.nest = static_cast<unsigned>(value);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && number(options.seed)) {
+            continue;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    // Every function takes a struct pointer, so there is always at least one struct
+    if (options.structs == 0) {
+        options.structs = 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    Generator(options).write(std::cout);
+    return 0;
+}
@@ -0,0 +1,238 @@
+// Times each phase of checking an .astj file separately.
+//
+//   bench [--repeat R] <input.astj>...
+//
+// Each phase runs R times on every input and the fastest run is reported,
+// with its throughput in AST nodes per second. The phases are:
+//   read       map or read the file (InputBuffer) and touch every page of it
+//   parse      JSON text to an nlohmann::json DOM
+//   build-dom  buildProgram from that DOM
+//   build-sax  buildProgramStreaming straight from the text (parse included)
+//   load-bin   loadProgramBinary from the binary format of the same program
+//   gamma      constructGamma
+//   delta      constructDelta
+//   structs    StructDefinition::check for every struct
+//   functions  FunctionDefinition::check for every function
+//   flatten    flattenFunction for every function (flat.hpp)
+//   flat-funcs the same checks as functions, with FlatChecker over those bodies
+//   check      the whole of Program::check (gamma, delta and both of the above)
+// Peak RSS is the process-wide high-water mark after the input's runs.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "ast.hpp"
+#include "binary.hpp"
+#include "builder.hpp"
+#include "flat.hpp"
+#include "input.hpp"
+#include "json.hpp"
+#include "saxbuilder.hpp"
+#include "traversal.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Fastest of repeat runs, in seconds. A phase that throws, such as checking
+// an invalid program, still counts: the time to find the error is the time.
+double fastest(unsigned repeat, const std::function<void()> &phase) {
+    double best = 0;
+
+    for (unsigned i = 0; i < repeat; i++) {
+        auto start = Clock::now();
+
+        try {
+            phase();
+        } catch (const std::exception &) {
+        }
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        best = i == 0 ? seconds : std::min(best, seconds);
+    }
+
+    return best;
+}
+
+size_t countNodes(Node &root) {
+    std::vector<Node *> pending{&root};
+    size_t count = 0;
+
+    while (!pending.empty()) {
+        Node *node = pending.back();
+        pending.pop_back();
+        count++;
+        collectChildren(*node, pending);
+    }
+
+    return count;
+}
+
+long peakRssKilobytes() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void report(const std::string &phase, double seconds, size_t nodes) {
+    std::printf("  %-10s %10.3f ms %10.2f Mnodes/s\n", phase.c_str(), seconds * 1e3,
+                seconds > 0 ? nodes / seconds / 1e6 : 0.0);
+}
+
+bool benchFile(const std::string &path, unsigned repeat) {
+    InputBuffer input(path);
+
+    if (!input.isOpen()) {
+        std::cerr << "Could not open file " << path << "." << std::endl;
+        return false;
+    }
+
+    std::string_view contents = input.contents();
+    std::unique_ptr<Program> program;
+
+    try {
+        program = buildProgramStreaming(contents);
+    } catch (const std::exception &e) {
+        std::cerr << path << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    size_t nodes = countNodes(*program);
+    std::string verdict = "valid";
+
+    try {
+        program->check();
+    } catch (const std::exception &e) {
+        verdict = std::string("invalid: ") + e.what();
+    }
+
+    std::printf("%s: %zu bytes, %zu nodes, %s\n", path.c_str(), contents.size(), nodes, verdict.substr(0, 60).c_str());
+
+    // Mapping alone is lazy, so one byte per page is read to fault the file in
+    volatile unsigned char sink = 0;
+    report("read", fastest(repeat, [&] {
+        InputBuffer again(path);
+        std::string_view bytes = again.contents();
+
+        for (size_t i = 0; i < bytes.size(); i += 4096) {
+            sink = sink + static_cast<unsigned char>(bytes[i]);
+        }
+    }), nodes);
+
+    nlohmann::json json;
+    report("parse", fastest(repeat, [&] {
+        json = nlohmann::json::parse(contents.begin(), contents.end(), nullptr, true, false);
+    }), nodes);
+
+    report("build-dom", fastest(repeat, [&] {
+        buildProgram(json);
+    }), nodes);
+
+    json = nlohmann::json();
+
+    report("build-sax", fastest(repeat, [&] {
+        buildProgramStreaming(contents);
+    }), nodes);
+
+    std::string binary = writeProgramBinary(*program);
+    report("load-bin", fastest(repeat, [&] {
+        loadProgramBinary(binary);
+    }), nodes);
+
+    Gamma gamma;
+    report("gamma", fastest(repeat, [&] {
+        gamma = constructGamma(program->externs, program->functions);
+    }), nodes);
+
+    Delta delta;
+    report("delta", fastest(repeat, [&] {
+        delta = constructDelta(program->structs);
+    }), nodes);
+
+    report("structs", fastest(repeat, [&] {
+        for (const auto &s : program->structs) {
+            s->check(gamma, delta);
+        }
+    }), nodes);
+
+    report("functions", fastest(repeat, [&] {
+        for (const auto &f : program->functions) {
+            f->check(gamma, delta);
+        }
+    }), nodes);
+
+    std::vector<FlatFunction> flatFunctions;
+    report("flatten", fastest(repeat, [&] {
+        flatFunctions.clear();
+
+        for (const auto &f : program->functions) {
+            flatFunctions.push_back(flattenFunction(*f));
+        }
+    }), nodes);
+
+    // Like the functions phase, this stops at the first function that fails
+    report("flat-funcs", fastest(repeat, [&] {
+        for (size_t i = 0; i < flatFunctions.size(); i++) {
+            const FunctionDefinition &f = *program->functions[i];
+            Scope scope(gamma);
+
+            if (f.diagnoseDeclarations(scope)) {
+                return;
+            }
+
+            FlatChecker checker(scope, delta);
+
+            if (!checker.checkBody(flatFunctions[i], f.returnType.get())) {
+                return;
+            }
+        }
+    }), nodes);
+
+    report("check", fastest(repeat, [&] {
+        program->check();
+    }), nodes);
+
+    std::printf("  peak RSS   %10ld KB\n", peakRssKilobytes());
+    return true;
+}
+
+int usage(const char *program) {
+    std::cerr << "Usage: " << program << " [--repeat R] <input.astj>..." << std::endl;
+    return 1;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    unsigned repeat = 5;
+    std::vector<std::string> inputPaths;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            inputPaths.push_back(argv[i]);
+        }
+    }
+
+    if (inputPaths.empty() || repeat == 0) {
+        return usage(argv[0]);
+    }
+
+    bool ok = true;
+
+    for (const auto &path : inputPaths) {
+        ok = benchFile(path, repeat) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
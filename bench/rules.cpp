@@ -0,0 +1,408 @@
+// Measures how fast Program::check rejects each kind of type error.
+//
+//   rules [--time MS] [--first] <valid.astj>
+//
+// The input is loaded once and must be valid. For every typing rule, a copy
+// of it is made with cloneProgram and one violation of that rule is planted
+// in the copy: a struct, an extern and a function "planted" are added, and
+// the error goes into the function body, its signature, a struct or main, as
+// the rule requires. The function goes after every other one, so the whole
+// input is still checked first, or before them all with --first. Each copy is
+// then checked over and over for at least MS milliseconds (200 by default),
+// with nothing parsed again, and the rate is reported per rule and per class
+// of rule. The same copy without a planted error is the baseline.
+//
+// Every copy is first checked once to confirm that it fails with exactly the
+// planted rule, so the run also covers each way a check can fail.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ast.hpp"
+#include "input.hpp"
+#include "saxbuilder.hpp"
+#include "traversal.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/* Building blocks for planted code */
+
+// The names the planted code declares. The function's locals are i: int,
+// p: &int, a: [int], s: &planted_s and q: &planted_missing, a struct that is
+// never defined.
+constexpr const char *HOST = "planted";
+constexpr const char *STRUCT = "planted_s";
+constexpr const char *EXTERN = "planted_ext";
+
+TypeContext &types() {
+    return TypeContext::global();
+}
+
+NodePtr<Expression> num(long long value) {
+    return makeNode<Number>(value);
+}
+
+NodePtr<Place> id(std::string_view name) {
+    return makeNode<Identifier>(name);
+}
+
+NodePtr<Expression> val(NodePtr<Place> place) {
+    return makeNode<Value>(std::move(place));
+}
+
+NodePtr<Expression> val(std::string_view name) {
+    return val(id(name));
+}
+
+NodePtr<Statement> assign(std::string_view name, NodePtr<Expression> expression) {
+    return makeNode<Assignment>(id(name), std::move(expression));
+}
+
+template <typename... Args>
+NodePtr<Statement> call(NodePtr<Expression> callee, Args... args) {
+    Arguments arguments;
+    (arguments.push_back(std::move(args)), ...);
+    return makeNode<CallStatement>(makeNode<FunctionCall>(std::move(callee), std::move(arguments)));
+}
+
+NodePtr<Statement> block(NodePtr<Statement> statement) {
+    auto statements = makeNode<Statements>();
+    statements->statements.push_back(std::move(statement));
+    return statements;
+}
+
+StatementList &statementsOf(FunctionDefinition &function) {
+    return static_cast<Statements&>(*function.body).statements;
+}
+
+// Puts statement ahead of the host's return, so it is the first thing checked
+void prepend(FunctionDefinition &host, NodePtr<Statement> statement) {
+    StatementList &statements = statementsOf(host);
+    statements.insert(statements.begin(), std::move(statement));
+}
+
+void addStruct(Program &program, const std::string &name, Fields fields) {
+    auto structDefinition = makeNode<StructDefinition>();
+    structDefinition->name = name;
+    structDefinition->fields = std::move(fields);
+    program.structs.push_back(std::move(structDefinition));
+}
+
+// Adds the struct, extern and function that the planted errors use, all of
+// them valid, and returns the function
+FunctionDefinition &addHost(Program &program, bool first) {
+    addStruct(program, STRUCT, {Declaration("v", types().intType())});
+
+    Extern externDefinition;
+    externDefinition.name = EXTERN;
+    externDefinition.paramTypes = {types().intType()};
+    externDefinition.returnType = types().intType();
+    program.externs.push_back(std::move(externDefinition));
+
+    auto host = makeNode<FunctionDefinition>();
+    host->name = HOST;
+    host->returnType = types().intType();
+    host->locals.emplace_back("i", types().intType());
+    host->locals.emplace_back("p", types().pointerType(types().intType()));
+    host->locals.emplace_back("a", types().arrayType(types().intType()));
+    host->locals.emplace_back("s", types().pointerType(types().structType(STRUCT)));
+    host->locals.emplace_back("q", types().pointerType(types().structType("planted_missing")));
+    host->body = block(makeNode<Return>(num(0)));
+
+    FunctionDefinition &function = *host;
+    program.functions.insert(first ? program.functions.begin() : program.functions.end(), std::move(host));
+    return function;
+}
+
+/* One violation per rule */
+
+struct Plant {
+    const char *ruleClass;
+    Rule rule;
+    void (*plant)(Program &program, FunctionDefinition &host);
+};
+
+// Grouped as in diagnostic.hpp. DUPLICATE_VARIABLE and DUPLICATE_NAME are
+// naming rules, which inputs are assumed to satisfy (see the README), so
+// they are never checked and have nothing to plant.
+const Plant PLANTS[] = {
+    /* Expressions */
+    {"expressions", Rule::SELECT_GUARD_NOT_INT, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", makeNode<Select>(val("p"), num(1), num(2))));
+    }},
+    {"expressions", Rule::SELECT_BRANCHES_INCOMPATIBLE, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", makeNode<Select>(num(1), num(1), val("p"))));
+    }},
+    {"expressions", Rule::UNARY_OPERAND_NOT_INT, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", makeNode<UnaryOperation>(UnaryOperand::NEG, val("p"))));
+    }},
+    {"expressions", Rule::BINARY_OPERANDS_INCOMPATIBLE, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", makeNode<BinaryOperation>(BinaryOperand::EQ, num(1), val("p"))));
+    }},
+    {"expressions", Rule::BINARY_OPERAND_INVALID, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", makeNode<BinaryOperation>(BinaryOperand::EQ, val(EXTERN), val(EXTERN))));
+    }},
+    {"expressions", Rule::BINARY_LEFT_NOT_INT, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", makeNode<BinaryOperation>(BinaryOperand::ADD, val("p"), num(1))));
+    }},
+    {"expressions", Rule::BINARY_RIGHT_NOT_INT, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", makeNode<BinaryOperation>(BinaryOperand::ADD, num(1), val("p"))));
+    }},
+    {"expressions", Rule::NEW_SINGLE_INVALID_TYPE, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("p", makeNode<NewSingleton>(types().nilType())));
+    }},
+    {"expressions", Rule::NEW_ARRAY_SIZE_NOT_INT, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("a", makeNode<NewArray>(types().intType(), val("p"))));
+    }},
+    {"expressions", Rule::NEW_ARRAY_INVALID_TYPE, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("a", makeNode<NewArray>(types().structType(STRUCT), num(1))));
+    }},
+
+    /* Places */
+    {"places", Rule::UNKNOWN_ID, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", val("planted_unknown")));
+    }},
+    {"places", Rule::DEREFERENCE_NOT_POINTER, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", val(makeNode<Dereference>(val("i")))));
+    }},
+    {"places", Rule::ARRAY_INDEX_NOT_INT, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", val(makeNode<ArrayAccess>(val("a"), val("p")))));
+    }},
+    {"places", Rule::ARRAY_ACCESS_NOT_ARRAY, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", val(makeNode<ArrayAccess>(val("p"), num(0)))));
+    }},
+    {"places", Rule::FIELD_ACCESS_NOT_STRUCT_POINTER, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", val(makeNode<FieldAccess>(val("p"), "v"))));
+    }},
+    {"places", Rule::FIELD_ACCESS_UNKNOWN_STRUCT, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", val(makeNode<FieldAccess>(val("q"), "v"))));
+    }},
+    {"places", Rule::FIELD_ACCESS_UNKNOWN_FIELD, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", val(makeNode<FieldAccess>(val("s"), "planted_w"))));
+    }},
+
+    /* Function call */
+    {"calls", Rule::CALL_TO_MAIN, [](Program &, FunctionDefinition &host) {
+        prepend(host, call(val("main")));
+    }},
+    {"calls", Rule::CALL_NOT_FUNCTION, [](Program &, FunctionDefinition &host) {
+        prepend(host, call(val("i")));
+    }},
+    {"calls", Rule::CALL_ARGUMENT_COUNT, [](Program &, FunctionDefinition &host) {
+        prepend(host, call(val(EXTERN)));
+    }},
+    {"calls", Rule::CALL_ARGUMENT_TYPE, [](Program &, FunctionDefinition &host) {
+        prepend(host, call(val(EXTERN), val("p")));
+    }},
+
+    /* Statements */
+    {"statements", Rule::ASSIGN_INVALID_LHS, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign(EXTERN, val(EXTERN)));
+    }},
+    {"statements", Rule::ASSIGN_INCOMPATIBLE, [](Program &, FunctionDefinition &host) {
+        prepend(host, assign("i", val("p")));
+    }},
+    {"statements", Rule::IF_GUARD_NOT_INT, [](Program &, FunctionDefinition &host) {
+        prepend(host, makeNode<If>(val("p"), block(assign("i", num(0))), std::nullopt));
+    }},
+    {"statements", Rule::WHILE_GUARD_NOT_INT, [](Program &, FunctionDefinition &host) {
+        prepend(host, makeNode<While>(val("p"), block(assign("i", num(0)))));
+    }},
+    {"statements", Rule::BREAK_OUTSIDE_LOOP, [](Program &, FunctionDefinition &host) {
+        prepend(host, makeNode<Break>());
+    }},
+    {"statements", Rule::CONTINUE_OUTSIDE_LOOP, [](Program &, FunctionDefinition &host) {
+        prepend(host, makeNode<Continue>());
+    }},
+    {"statements", Rule::RETURN_TYPE_MISMATCH, [](Program &, FunctionDefinition &host) {
+        prepend(host, makeNode<Return>(val("p")));
+    }},
+    {"statements", Rule::RETURN_MISSING_EXPRESSION, [](Program &, FunctionDefinition &host) {
+        host.returnType = types().pointerType(types().intType());
+        prepend(host, makeNode<Return>(std::nullopt));
+    }},
+    {"statements", Rule::RETURN_WITHOUT_EXPRESSION, [](Program &, FunctionDefinition &host) {
+        prepend(host, makeNode<Return>(std::nullopt));
+    }},
+
+    /* Structs and functions */
+    {"declarations", Rule::EMPTY_STRUCT, [](Program &program, FunctionDefinition &) {
+        addStruct(program, "planted_empty", {});
+    }},
+    {"declarations", Rule::FIELD_INVALID_TYPE, [](Program &program, FunctionDefinition &) {
+        addStruct(program, "planted_nested", {Declaration("v", types().structType(STRUCT))});
+    }},
+    {"declarations", Rule::DUPLICATE_FIELD, [](Program &program, FunctionDefinition &) {
+        addStruct(program, "planted_twice", {Declaration("v", types().intType()), Declaration("v", types().intType())});
+    }},
+    {"declarations", Rule::VARIABLE_INVALID_TYPE, [](Program &, FunctionDefinition &host) {
+        host.locals.emplace_back("planted_value", types().structType(STRUCT));
+    }},
+    {"declarations", Rule::EMPTY_BODY, [](Program &, FunctionDefinition &host) {
+        statementsOf(host).clear();
+    }},
+    {"declarations", Rule::BODY_NOT_STATEMENTS, [](Program &, FunctionDefinition &host) {
+        host.body = makeNode<Return>(num(0));
+    }},
+    {"declarations", Rule::MISSING_RETURN, [](Program &, FunctionDefinition &host) {
+        statementsOf(host).clear();
+        statementsOf(host).push_back(assign("i", num(0)));
+    }},
+
+    /* Program */
+    {"program", Rule::NO_MAIN, [](Program &program, FunctionDefinition &) {
+        for (auto &function : program.functions) {
+            if (function->name == "main") {
+                function->name = "planted_main";
+            }
+        }
+    }},
+};
+
+// A copy of base with the host added and plant, if any, applied to it
+std::unique_ptr<Program> mutate(const Program &base, const Plant *plant, bool first) {
+    std::unique_ptr<Program> mutant = cloneProgram(base);
+    Arena::Scope arenaScope(*mutant->arena);
+    FunctionDefinition &host = addHost(*mutant, first);
+
+    if (plant) {
+        plant->plant(*mutant, host);
+    }
+
+    return mutant;
+}
+
+// Checks program back to back for at least minSeconds
+double checksPerSecond(const Program &program, double minSeconds) {
+    size_t checks = 0;
+    double seconds = 0;
+    auto start = Clock::now();
+
+    do {
+        try {
+            program.check();
+        } catch (const std::exception &) {
+        }
+
+        checks++;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (seconds < minSeconds);
+
+    return checks / seconds;
+}
+
+void report(const char *ruleClass, std::string_view rule, double rate) {
+    std::printf("  %-13s %-32.*s %12.1f checks/s\n", ruleClass, static_cast<int>(rule.size()), rule.data(), rate);
+}
+
+bool benchRules(const std::string &path, double minSeconds, bool first) {
+    InputBuffer input(path);
+
+    if (!input.isOpen()) {
+        std::cerr << "Could not open file " << path << "." << std::endl;
+        return false;
+    }
+
+    std::unique_ptr<Program> base;
+
+    try {
+        base = buildProgramStreaming(input.contents());
+    } catch (const std::exception &e) {
+        std::cerr << path << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    if (std::optional<Diagnostic> failure = base->diagnose()) {
+        std::cerr << path << ": needs a valid program, but it is invalid: " << render(*failure) << std::endl;
+        return false;
+    }
+
+    std::printf("%s: planted %s every other function\n", path.c_str(), first ? "before" : "after");
+
+    std::unique_ptr<Program> baseline = mutate(*base, nullptr, first);
+
+    if (std::optional<Diagnostic> failure = baseline->diagnose()) {
+        std::cerr << path << ": the planted code is invalid on its own: " << render(*failure) << std::endl;
+        return false;
+    }
+
+    report("-", "valid", checksPerSecond(*baseline, minSeconds));
+    baseline.reset();
+
+    // Totals per class, in the order the classes first appear
+    struct ClassTotal {
+        const char *ruleClass;
+        double seconds;
+        size_t rules;
+    };
+
+    std::vector<ClassTotal> totals;
+    bool ok = true;
+
+    for (const Plant &plant : PLANTS) {
+        std::unique_ptr<Program> mutant = mutate(*base, &plant, first);
+        std::optional<Diagnostic> failure = mutant->diagnose();
+
+        if (!failure || failure->rule != plant.rule) {
+            std::cerr << path << ": planting " << ruleName(plant.rule) << " gave "
+                      << (failure ? render(*failure) : std::string("valid")) << std::endl;
+            ok = false;
+            continue;
+        }
+
+        double rate = checksPerSecond(*mutant, minSeconds);
+        report(plant.ruleClass, ruleName(plant.rule), rate);
+
+        if (totals.empty() || std::strcmp(totals.back().ruleClass, plant.ruleClass) != 0) {
+            totals.push_back({plant.ruleClass, 0, 0});
+        }
+
+        totals.back().seconds += 1 / rate;
+        totals.back().rules++;
+    }
+
+    // A class's rate is that of checking each of its rules once in turn
+    std::printf("  by class:\n");
+
+    for (const ClassTotal &total : totals) {
+        report(total.ruleClass, std::to_string(total.rules) + (total.rules == 1 ? " rule" : " rules"), total.rules / total.seconds);
+    }
+
+    return ok;
+}
+
+int usage(const char *program) {
+    std::cerr << "Usage: " << program << " [--time MS] [--first] <valid.astj>" << std::endl;
+    return 1;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    double milliseconds = 200;
+    bool first = false;
+    std::vector<std::string> inputPaths;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            milliseconds = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--first") == 0) {
+            first = true;
+        } else {
+            inputPaths.push_back(argv[i]);
+        }
+    }
+
+    if (inputPaths.size() != 1 || milliseconds <= 0) {
+        return usage(argv[0]);
+    }
+
+    return benchRules(inputPaths[0], milliseconds / 1e3, first) ? 0 : 1;
+}
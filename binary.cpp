@@ -0,0 +1,784 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "binary.hpp"
+#include "memory.hpp"
+#include "traversal.hpp"
+
+static constexpr char MAGIC[8] = {'C', 'F', 'L', 'A', 'T', 'A', 'S', 'T'};
+// Bump whenever the layout of a record or table entry changes
+static constexpr uint32_t VERSION = 1;
+
+bool isBinaryProgram(std::string_view input) {
+    return input.size() >= sizeof(MAGIC) && std::memcmp(input.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+[[noreturn]] static void invalid(const std::string &reason) {
+    throw std::runtime_error("Invalid binary AST: " + reason);
+}
+
+namespace {
+
+/* Writing */
+
+class ByteWriter {
+public:
+    std::string bytes;
+
+    void u8(uint8_t value) {
+        bytes.push_back(static_cast<char>(value));
+    }
+
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            u8(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void i64(int64_t value) {
+        for (int i = 0; i < 8; i++) {
+            u8(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+        }
+    }
+};
+
+// Emits a record for every node as the walk leaves it, which is post-order.
+// Names and types are written once to their tables and referred to by index.
+class BinaryWriter : public Walker {
+public:
+    std::string finish() {
+        ByteWriter header;
+        header.bytes.append(MAGIC, sizeof(MAGIC));
+        header.u32(VERSION);
+        header.u32(stringCount);
+        header.u32(typeCount);
+        return header.bytes + strings.bytes + types.bytes + records.bytes;
+    }
+
+    /* Declarations */
+
+    void visit(Declaration &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(stringIndex(node.symbol));
+        records.u32(typeIndex(node.type.get()));
+    }
+
+    /* Expressions */
+
+    void visit(Value &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(Number &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.i64(node.value);
+    }
+
+    void visit(Nil &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(Select &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(UnaryOperation &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u8(static_cast<uint8_t>(node.operand));
+    }
+
+    void visit(BinaryOperation &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u8(static_cast<uint8_t>(node.operand));
+    }
+
+    void visit(NewSingleton &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(typeIndex(node.type.get()));
+    }
+
+    void visit(NewArray &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(typeIndex(node.type.get()));
+    }
+
+    void visit(CallExpression &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    /* Places */
+
+    void visit(Identifier &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(stringIndex(node.symbol));
+    }
+
+    void visit(Dereference &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(ArrayAccess &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(FieldAccess &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(stringIndex(node.fieldSymbol));
+    }
+
+    /* Function call */
+
+    void visit(FunctionCall &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(static_cast<uint32_t>(node.args.size()));
+    }
+
+    /* Statements */
+
+    void visit(Statements &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(static_cast<uint32_t>(node.statements.size()));
+    }
+
+    void visit(Assignment &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(CallStatement &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(If &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u8(node.unhappyPath.has_value());
+    }
+
+    void visit(While &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(Break &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(Continue &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+    }
+
+    void visit(Return &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u8(node.expression.has_value());
+    }
+
+    /* High level nodes */
+
+    void visit(StructDefinition &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(stringIndex(node.name));
+        records.u32(static_cast<uint32_t>(node.fields.size()));
+    }
+
+    void visit(Extern &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(stringIndex(node.name));
+        records.u32(typeIndex(TypeContext::global().functionType(node.paramTypes, node.returnType).get()));
+    }
+
+    void visit(FunctionDefinition &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(stringIndex(node.name));
+        records.u32(typeIndex(node.returnType.get()));
+        records.u32(static_cast<uint32_t>(node.params.size()));
+        records.u32(static_cast<uint32_t>(node.locals.size()));
+        records.u8(node.body != nullptr);
+    }
+
+    void visit(Program &node) override {
+        if (!leaving()) return;
+        record(node.kind);
+        records.u32(static_cast<uint32_t>(node.structs.size()));
+        records.u32(static_cast<uint32_t>(node.externs.size()));
+        records.u32(static_cast<uint32_t>(node.functions.size()));
+    }
+
+private:
+    bool leaving() const {
+        return phase() == WalkPhase::LEAVE;
+    }
+
+    void record(NodeKind kind) {
+        records.u8(static_cast<uint8_t>(kind));
+    }
+
+    uint32_t stringIndex(Symbol symbol) {
+        auto [it, inserted] = stringIndices.try_emplace(symbol, stringCount);
+
+        if (inserted) {
+            std::string_view name = SymbolTable::global().name(symbol);
+            strings.u32(static_cast<uint32_t>(name.size()));
+            strings.bytes.append(name);
+            stringCount++;
+        }
+
+        return it->second;
+    }
+
+    uint32_t stringIndex(const std::string &name) {
+        return stringIndex(SymbolTable::global().intern(name));
+    }
+
+    // Operands are written before the type that uses them, so every index in
+    // the table refers to an earlier entry
+    uint32_t typeIndex(const Type *type) {
+        if (!type) {
+            throw std::runtime_error("Cannot serialize a node without a type");
+        }
+
+        if (auto it = typeIndices.find(type); it != typeIndices.end()) {
+            return it->second;
+        }
+
+        ByteWriter entry;
+        entry.u8(static_cast<uint8_t>(type->getTypeKind()));
+
+        switch (type->getTypeKind()) {
+            case TypeKind::INT:
+            case TypeKind::NIL:
+                break;
+            case TypeKind::STRUCT:
+                entry.u32(stringIndex(static_cast<const StructType*>(type)->symbol));
+                break;
+            case TypeKind::ARRAY:
+                entry.u32(typeIndex(static_cast<const ArrayType*>(type)->elementType.get()));
+                break;
+            case TypeKind::POINTER:
+                entry.u32(typeIndex(static_cast<const PointerType*>(type)->pointeeType.get()));
+                break;
+            case TypeKind::FUNCTION: {
+                const auto *functionType = static_cast<const FunctionType*>(type);
+                entry.u32(static_cast<uint32_t>(functionType->paramTypes.size()));
+
+                for (const auto &paramType : functionType->paramTypes) {
+                    entry.u32(typeIndex(paramType.get()));
+                }
+
+                entry.u32(typeIndex(functionType->returnType.get()));
+                break;
+            }
+        }
+
+        types.bytes += entry.bytes;
+        typeIndices.emplace(type, typeCount);
+        return typeCount++;
+    }
+
+    ByteWriter strings;
+    ByteWriter types;
+    ByteWriter records;
+    uint32_t stringCount = 0;
+    uint32_t typeCount = 0;
+    std::unordered_map<Symbol, uint32_t> stringIndices;
+    std::unordered_map<const Type*, uint32_t> typeIndices;
+};
+
+/* Loading */
+
+class ByteReader {
+public:
+    explicit ByteReader(std::string_view input) : cursor(input.data()), end(input.data() + input.size()) {}
+
+    bool atEnd() const {
+        return cursor == end;
+    }
+
+    size_t remaining() const {
+        return static_cast<size_t>(end - cursor);
+    }
+
+    uint8_t u8() {
+        need(1);
+        return static_cast<uint8_t>(*cursor++);
+    }
+
+    uint32_t u32() {
+        need(4);
+        uint32_t value = 0;
+
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(cursor[i])) << (8 * i);
+        }
+
+        cursor += 4;
+        return value;
+    }
+
+    int64_t i64() {
+        need(8);
+        uint64_t value = 0;
+
+        for (int i = 0; i < 8; i++) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(cursor[i])) << (8 * i);
+        }
+
+        cursor += 8;
+        return static_cast<int64_t>(value);
+    }
+
+    std::string_view bytes(size_t count) {
+        need(count);
+        std::string_view view(cursor, count);
+        cursor += count;
+        return view;
+    }
+
+private:
+    void need(size_t count) const {
+        if (static_cast<size_t>(end - cursor) < count) {
+            invalid("truncated input");
+        }
+    }
+
+    const char *cursor;
+    const char *end;
+};
+
+// Whether a node of this kind may stand where a T is expected. Relies on
+// NodeKind listing the kinds of each node family next to each other.
+template <typename T>
+static bool isKindOf(NodeKind kind) {
+    if constexpr (std::is_same_v<T, Expression>) {
+        return kind >= NodeKind::VALUE && kind <= NodeKind::CALL_EXPRESSION;
+    } else if constexpr (std::is_same_v<T, Place>) {
+        return kind >= NodeKind::IDENTIFIER && kind <= NodeKind::FIELD_ACCESS;
+    } else if constexpr (std::is_same_v<T, Statement>) {
+        return kind >= NodeKind::STATEMENTS && kind <= NodeKind::RETURN;
+    } else if constexpr (std::is_same_v<T, FunctionCall>) {
+        return kind == NodeKind::FUNCTION_CALL;
+    } else if constexpr (std::is_same_v<T, StructDefinition>) {
+        return kind == NodeKind::STRUCT_DEFINITION;
+    } else {
+        static_assert(std::is_same_v<T, FunctionDefinition>);
+        return kind == NodeKind::FUNCTION_DEFINITION;
+    }
+}
+
+// Rebuilds the tree from its post-order records: each record pops its
+// children off a stack of finished nodes and pushes itself
+class BinaryLoader {
+public:
+    explicit BinaryLoader(std::string_view input) : reader(input) {}
+
+    // A partly built tree is torn down iteratively, as Program does for a whole one
+    ~BinaryLoader() {
+        destroyTree(std::move(nodes));
+    }
+
+    std::unique_ptr<Program> load() {
+        readHeader();
+        Arena::Scope arenaScope(*arena);
+
+        while (true) {
+            memory::checkLimit();
+            NodeKind kind = readKind();
+
+            if (kind == NodeKind::PROGRAM) {
+                break;
+            }
+
+            loadRecord(kind);
+        }
+
+        // Counts are in the order the program's children were written
+        uint32_t structCount = readCount(nodes.size());
+        uint32_t externCount = reader.u32();
+        uint32_t functionCount = readCount(nodes.size());
+
+        // Popped last to first; pushing rather than filling a resized vector
+        // means a failure part way leaves no null entries for ~Program
+        auto program = std::make_unique<Program>();
+
+        for (uint32_t i = 0; i < functionCount; i++) {
+            program->functions.push_back(pop<FunctionDefinition>());
+        }
+
+        for (uint32_t i = 0; i < structCount; i++) {
+            program->structs.push_back(pop<StructDefinition>());
+        }
+
+        std::reverse(program->functions.begin(), program->functions.end());
+        std::reverse(program->structs.begin(), program->structs.end());
+
+        if (externCount != externs.size()) {
+            invalid("extern count does not match its records");
+        }
+
+        if (!nodes.empty() || !declarations.empty() || !reader.atEnd()) {
+            invalid("records left over after the program");
+        }
+
+        program->externs = std::move(externs);
+        program->arena = std::move(arena);
+        return program;
+    }
+
+private:
+    void readHeader() {
+        reader.bytes(sizeof(MAGIC));
+        uint32_t version = reader.u32();
+
+        if (version != VERSION) {
+            invalid("unsupported version " + std::to_string(version));
+        }
+
+        // Every string and type entry takes at least one byte
+        symbols.resize(readCount(reader.remaining()));
+        uint32_t typeCount = readCount(reader.remaining());
+
+        for (Symbol &symbol : symbols) {
+            uint32_t length = reader.u32();
+            symbol = SymbolTable::global().intern(reader.bytes(length));
+        }
+
+        types.reserve(typeCount);
+
+        for (uint32_t i = 0; i < typeCount; i++) {
+            types.push_back(readType());
+        }
+    }
+
+    std::shared_ptr<Type> readType() {
+        TypeContext &context = TypeContext::global();
+        uint8_t kind = reader.u8();
+
+        switch (static_cast<TypeKind>(kind)) {
+            case TypeKind::INT:
+                return context.intType();
+            case TypeKind::NIL:
+                return context.nilType();
+            case TypeKind::STRUCT:
+                return context.structType(std::string(SymbolTable::global().name(symbolAt(reader.u32()))));
+            case TypeKind::ARRAY:
+                return context.arrayType(typeAt(reader.u32()));
+            case TypeKind::POINTER:
+                return context.pointerType(typeAt(reader.u32()));
+            case TypeKind::FUNCTION: {
+                TypeList paramTypes(readCount(reader.remaining()));
+
+                for (auto &paramType : paramTypes) {
+                    paramType = typeAt(reader.u32());
+                }
+
+                return context.functionType(paramTypes, typeAt(reader.u32()));
+            }
+        }
+
+        invalid("unknown type kind " + std::to_string(kind));
+    }
+
+    // Reads a count and rejects it up front if there cannot be that many
+    // items, so a corrupt file fails cleanly rather than allocating wildly
+    uint32_t readCount(size_t available) {
+        uint32_t count = reader.u32();
+
+        if (count > available) {
+            invalid("count " + std::to_string(count) + " exceeds the input");
+        }
+
+        return count;
+    }
+
+    NodeKind readKind() {
+        uint8_t kind = reader.u8();
+
+        if (kind > static_cast<uint8_t>(NodeKind::PROGRAM)) {
+            invalid("unknown record kind " + std::to_string(kind));
+        }
+
+        return static_cast<NodeKind>(kind);
+    }
+
+    Symbol symbolAt(uint32_t index) const {
+        if (index >= symbols.size()) {
+            invalid("string index out of range");
+        }
+
+        return symbols[index];
+    }
+
+    // Only entries already loaded may be referred to, which rules out cycles
+    const std::shared_ptr<Type> &typeAt(uint32_t index) const {
+        if (index >= types.size()) {
+            invalid("type index out of range");
+        }
+
+        return types[index];
+    }
+
+    template <typename T>
+    NodePtr<T> pop() {
+        if (nodes.empty() || !isKindOf<T>(nodes.back()->kind)) {
+            invalid("record is missing a child or has one of the wrong kind");
+        }
+
+        NodePtr<Node> node = std::move(nodes.back());
+        nodes.pop_back();
+        NodeDeleter deleter = node.get_deleter();
+        return NodePtr<T>(static_cast<T*>(node.release()), deleter);
+    }
+
+    template <typename T>
+    void push(NodePtr<T> node) {
+        NodeDeleter deleter = node.get_deleter();
+        nodes.emplace_back(node.release(), deleter);
+    }
+
+    // Moves the last count declarations off their stack, in order
+    template <typename List>
+    List popDeclarations(uint32_t count) {
+        if (count > declarations.size()) {
+            invalid("record is missing declarations");
+        }
+
+        auto first = declarations.end() - count;
+        List popped(std::make_move_iterator(first), std::make_move_iterator(declarations.end()));
+        declarations.erase(first, declarations.end());
+        return popped;
+    }
+
+    void loadRecord(NodeKind kind) {
+        switch (kind) {
+            case NodeKind::DECLARATION: {
+                Symbol symbol = symbolAt(reader.u32());
+                declarations.emplace_back(symbol, typeAt(reader.u32()));
+                break;
+            }
+            case NodeKind::VALUE:
+                push(makeNode<Value>(pop<Place>()));
+                break;
+            case NodeKind::NUMBER:
+                push(makeNode<Number>(reader.i64()));
+                break;
+            case NodeKind::NIL:
+                push(makeNode<Nil>());
+                break;
+            case NodeKind::SELECT: {
+                auto ffCase = pop<Expression>();
+                auto ttCase = pop<Expression>();
+                auto guard = pop<Expression>();
+                push(makeNode<Select>(std::move(guard), std::move(ttCase), std::move(ffCase)));
+                break;
+            }
+            case NodeKind::UNARY_OPERATION: {
+                uint8_t operand = reader.u8();
+
+                if (operand > static_cast<uint8_t>(UnaryOperand::NOT)) {
+                    invalid("unknown unary operator");
+                }
+
+                push(makeNode<UnaryOperation>(static_cast<UnaryOperand>(operand), pop<Expression>()));
+                break;
+            }
+            case NodeKind::BINARY_OPERATION: {
+                uint8_t operand = reader.u8();
+
+                if (operand > static_cast<uint8_t>(BinaryOperand::GTE)) {
+                    invalid("unknown binary operator");
+                }
+
+                auto rhs = pop<Expression>();
+                auto lhs = pop<Expression>();
+                push(makeNode<BinaryOperation>(static_cast<BinaryOperand>(operand), std::move(lhs), std::move(rhs)));
+                break;
+            }
+            case NodeKind::NEW_SINGLETON:
+                push(makeNode<NewSingleton>(typeAt(reader.u32())));
+                break;
+            case NodeKind::NEW_ARRAY: {
+                auto type = typeAt(reader.u32());
+                push(makeNode<NewArray>(std::move(type), pop<Expression>()));
+                break;
+            }
+            case NodeKind::CALL_EXPRESSION:
+                push(makeNode<CallExpression>(pop<FunctionCall>()));
+                break;
+            case NodeKind::IDENTIFIER:
+                push(makeNode<Identifier>(symbolAt(reader.u32())));
+                break;
+            case NodeKind::DEREFERENCE:
+                push(makeNode<Dereference>(pop<Expression>()));
+                break;
+            case NodeKind::ARRAY_ACCESS: {
+                auto index = pop<Expression>();
+                auto array = pop<Expression>();
+                push(makeNode<ArrayAccess>(std::move(array), std::move(index)));
+                break;
+            }
+            case NodeKind::FIELD_ACCESS: {
+                Symbol field = symbolAt(reader.u32());
+                push(makeNode<FieldAccess>(pop<Expression>(), field));
+                break;
+            }
+            case NodeKind::FUNCTION_CALL: {
+                Arguments args(readCount(nodes.size()));
+
+                for (size_t i = args.size(); i-- > 0;) {
+                    args[i] = pop<Expression>();
+                }
+
+                auto callee = pop<Expression>();
+                push(makeNode<FunctionCall>(std::move(callee), std::move(args)));
+                break;
+            }
+            case NodeKind::STATEMENTS: {
+                auto statements = makeNode<Statements>();
+                statements->statements.resize(readCount(nodes.size()));
+
+                for (size_t i = statements->statements.size(); i-- > 0;) {
+                    statements->statements[i] = pop<Statement>();
+                }
+
+                push(std::move(statements));
+                break;
+            }
+            case NodeKind::ASSIGNMENT: {
+                auto expression = pop<Expression>();
+                auto place = pop<Place>();
+                push(makeNode<Assignment>(std::move(place), std::move(expression)));
+                break;
+            }
+            case NodeKind::CALL_STATEMENT:
+                push(makeNode<CallStatement>(pop<FunctionCall>()));
+                break;
+            case NodeKind::IF: {
+                std::optional<NodePtr<Statement>> unhappyPath;
+
+                if (reader.u8()) {
+                    unhappyPath = pop<Statement>();
+                }
+
+                auto happyPath = pop<Statement>();
+                auto guard = pop<Expression>();
+                push(makeNode<If>(std::move(guard), std::move(happyPath), std::move(unhappyPath)));
+                break;
+            }
+            case NodeKind::WHILE: {
+                auto body = pop<Statement>();
+                auto guard = pop<Expression>();
+                push(makeNode<While>(std::move(guard), std::move(body)));
+                break;
+            }
+            case NodeKind::BREAK:
+                push(makeNode<Break>());
+                break;
+            case NodeKind::CONTINUE:
+                push(makeNode<Continue>());
+                break;
+            case NodeKind::RETURN: {
+                std::optional<NodePtr<Expression>> expression;
+
+                if (reader.u8()) {
+                    expression = pop<Expression>();
+                }
+
+                push(makeNode<Return>(std::move(expression)));
+                break;
+            }
+            case NodeKind::STRUCT_DEFINITION: {
+                auto structDefinition = makeNode<StructDefinition>();
+                structDefinition->name = SymbolTable::global().name(symbolAt(reader.u32()));
+                structDefinition->fields = popDeclarations<Fields>(reader.u32());
+                push(std::move(structDefinition));
+                break;
+            }
+            case NodeKind::EXTERN: {
+                Extern externDefinition;
+                externDefinition.name = SymbolTable::global().name(symbolAt(reader.u32()));
+                const auto &type = typeAt(reader.u32());
+
+                if (type->getTypeKind() != TypeKind::FUNCTION) {
+                    invalid("extern " + externDefinition.name + " does not have a function type");
+                }
+
+                const auto *functionType = static_cast<const FunctionType*>(type.get());
+                externDefinition.paramTypes = functionType->paramTypes;
+                externDefinition.returnType = functionType->returnType;
+                externs.push_back(std::move(externDefinition));
+                break;
+            }
+            case NodeKind::FUNCTION_DEFINITION: {
+                auto function = makeNode<FunctionDefinition>();
+                function->name = SymbolTable::global().name(symbolAt(reader.u32()));
+                function->returnType = typeAt(reader.u32());
+                uint32_t paramCount = reader.u32();
+                uint32_t localCount = reader.u32();
+
+                if (reader.u8()) {
+                    function->body = pop<Statement>();
+                }
+
+                function->locals = popDeclarations<Variables>(localCount);
+                function->params = popDeclarations<Variables>(paramCount);
+                push(std::move(function));
+                break;
+            }
+            case NodeKind::PROGRAM:
+                break;
+        }
+    }
+
+    ByteReader reader;
+    // Declared first so the nodes it backs are all gone before it is
+    std::unique_ptr<Arena> arena = std::make_unique<Arena>();
+    std::vector<Symbol> symbols;
+    std::vector<std::shared_ptr<Type>> types;
+    std::vector<NodePtr<Node>> nodes;
+    std::vector<Declaration> declarations;
+    std::vector<Extern> externs;
+};
+
+}
+
+std::string writeProgramBinary(Program &program) {
+    BinaryWriter writer;
+    writer.walk(program);
+    return writer.finish();
+}
+
+std::unique_ptr<Program> loadProgramBinary(std::string_view input) {
+    if (!isBinaryProgram(input)) {
+        invalid("missing magic bytes");
+    }
+
+    return BinaryLoader(input).load();
+}
@@ -0,0 +1,29 @@
+#ifndef BINARY_HPP
+#define BINARY_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "ast.hpp"
+
+// Compact binary serialization of a Program (.astb), meant to be produced once
+// per AST and loaded many times. The layout is sequential and holds no
+// absolute offsets, so a file can be loaded straight from a mapped buffer:
+//
+//   header   "CFLATAST", u32 version, u32 string count, u32 type count
+//   strings  per string: u32 length, bytes
+//   types    per type: u8 TypeKind, operands (string or earlier type indices)
+//   records  one per node in post-order: u8 NodeKind, fixed payload
+//
+// Every record's children come before it, so the loader rebuilds the tree
+// with a stack and never recurses. The last record is the Program. Integers
+// are little-endian.
+
+// Whether input starts with the binary format's magic bytes
+extern bool isBinaryProgram(std::string_view input);
+
+extern std::string writeProgramBinary(Program &program);
+extern std::unique_ptr<Program> loadProgramBinary(std::string_view input);
+
+#endif
@@ -2,110 +2,166 @@
 
 #include "json.hpp"
 #include "builder.hpp"
-
-std::shared_ptr<Type> buildType(const nlohmann::json &json) {
-    if (json.is_string()) {
-        const std::string &kind = json.get<std::string>();
-        
-        if (kind == "Int") {
-            return std::make_shared<IntType>();
-        }
-        
-        if (kind == "Nil") {
-            return std::make_shared<NilType>();
+#include "memory.hpp"
+#include "tags.hpp"
+
+// The DOM builder recurses once per nested type, expression, statement and
+// place, so input nested deeper than this is refused rather than left to
+// overflow the stack. It leaves room on the stack of a pool thread, even in a
+// debug build. The default SAX builder keeps its own stack and has no limit.
+static constexpr unsigned MAX_NESTING = 5000;
+
+static thread_local unsigned nesting = 0;
+
+// Counts one level of nesting for the scope of a build function
+class NestingGuard {
+public:
+    NestingGuard() {
+        if (nesting == MAX_NESTING) {
+            throw std::length_error("input nests more than " + std::to_string(MAX_NESTING) +
+                                    " levels deep, the most --dom builds; build it without --dom");
         }
-        
-        throw std::runtime_error("Unknown simple type string: " + kind);
+
+        nesting++;
     }
 
-    if (json.is_object()) {
-        if (json.contains("Struct")) {
-            return std::make_shared<StructType>(json.at("Struct").get<std::string>());
-        }
+    ~NestingGuard() {
+        nesting--;
+    }
 
-        if (json.contains("Ptr")) {
-            return std::make_shared<PointerType>(buildType(json.at("Ptr")));
-        }
+    NestingGuard(const NestingGuard &) = delete;
+    NestingGuard &operator=(const NestingGuard &) = delete;
+};
 
-        if (json.contains("Array")) {
-            return std::make_shared<ArrayType>(buildType(json.at("Array")));
-        }
+std::shared_ptr<Type> buildType(const nlohmann::json &json) {
+    NestingGuard guard;
 
-        if (json.contains("Fn")) {
-            const auto &funcSig = json.at("Fn");
-            
-            if (!funcSig.is_array() || funcSig.size() != 2 ||
-                !funcSig[0].is_array()) {
-                throw std::runtime_error("Invalid JSON for Function type signature.");
-            }
-            
-            std::vector<std::shared_ptr<Type>> params;
-            
-            for (const auto &param : funcSig[0]) {
-                params.push_back(buildType(param));
-            }
-            
-            return std::make_shared<FunctionType>(std::move(params), buildType(funcSig[1]));
+    if (json.is_string()) {
+        const std::string &kind = json.get<std::string>();
+        
+        switch (lookupTag(kind)) {
+            case Tag::INT:
+                return TypeContext::global().intType();
+            case Tag::NIL:
+                return TypeContext::global().nilType();
+            default:
+                throw std::runtime_error("Unknown simple type string: " + kind);
         }
+    }
 
-        if (json.contains("kind")) {
-            const std::string &kind = json.at("kind").get<std::string>();
-            
-            if (kind == "Int") {
-                return std::make_shared<IntType>();
-            }
-            
-            if (kind == "Nil") {
-                return std::make_shared<NilType>();
+    // Type objects have a single key, which names the kind of type
+    if (json.is_object() && !json.empty()) {
+        const auto &value = json.begin().value();
+
+        switch (lookupTag(json.begin().key())) {
+            case Tag::STRUCT:
+                return TypeContext::global().structType(value.get<std::string>());
+            case Tag::PTR:
+                return TypeContext::global().pointerType(buildType(value));
+            case Tag::ARRAY:
+                return TypeContext::global().arrayType(buildType(value));
+            case Tag::FN: {
+                if (!value.is_array() || value.size() != 2 ||
+                    !value[0].is_array()) {
+                    throw std::runtime_error("Invalid JSON for Function type signature.");
+                }
+                
+                TypeList params;
+                
+                for (const auto &param : value[0]) {
+                    params.push_back(buildType(param));
+                }
+                
+                return TypeContext::global().functionType(params, buildType(value[1]));
             }
+            case Tag::KEY_KIND:
+                switch (lookupTag(value.get<std::string>())) {
+                    case Tag::INT:
+                        return TypeContext::global().intType();
+                    case Tag::NIL:
+                        return TypeContext::global().nilType();
+                    default:
+                        break;
+                }
+                break;
+            default:
+                break;
         }
     }
 
     throw std::runtime_error("Invalid JSON for Type: " + json.dump());
 }
 
-std::unique_ptr<Place> buildPlace(const nlohmann::json &json) {
+NodePtr<Place> buildPlace(const nlohmann::json &json) {
     if (!json.is_object() || json.empty()) {
         throw std::runtime_error("Invalid JSON for Place: Must be non-empty object");
     }
 
-    const auto &key = json.begin().key();
-    const auto &value = json.begin().value();
-
-    if (key == "Id") {
-        return std::make_unique<Identifier>(value.get<std::string>());
-    }
+    return buildPlace(json.begin().key(), json.begin().value());
+}
 
-    if (key == "Deref") {
-        return std::make_unique<Dereference>(buildExpression(value));
+// Builds a place from an already split {key: value} pair, so callers that have
+// already looked at the key don't need to wrap the value in a new object
+NodePtr<Place> buildPlace(const std::string &key, const nlohmann::json &value) {
+    NestingGuard guard;
+
+    switch (lookupTag(key)) {
+        case Tag::ID:
+            return makeNode<Identifier>(value.get<std::string>());
+        case Tag::DEREF:
+            return makeNode<Dereference>(buildExpression(value));
+        case Tag::ARRAY_ACCESS:
+            if (!value.is_object() || !value.contains("array") || !value.contains("idx")) {
+                throw std::runtime_error("Invalid JSON for ArrayAccess content");
+            }
+            return makeNode<ArrayAccess>(buildExpression(value.at("array")), buildExpression(value.at("idx")));
+        case Tag::FIELD_ACCESS:
+            if (!value.is_object() || !value.contains("ptr") || !value.contains("field")) {
+                throw std::runtime_error("Invalid JSON for FieldAccess content");
+            }
+            return makeNode<FieldAccess>(buildExpression(value.at("ptr")), value.at("field").get<std::string>());
+        default:
+            throw std::runtime_error("JSON node is not a valid Place kind: " + key);
     }
+}
 
-    if (key == "ArrayAccess") {
-        if (!value.is_object() || !value.contains("array") || !value.contains("idx")) {
-            throw std::runtime_error("Invalid JSON for ArrayAccess content");
-        }
-        return std::make_unique<ArrayAccess>(buildExpression(value.at("array")), buildExpression(value.at("idx")));
+UnaryOperand buildUnaryOperand(const std::string &opStr) {
+    switch (lookupTag(opStr)) {
+        case Tag::NEG: return UnaryOperand::NEG;
+        case Tag::NOT: return UnaryOperand::NOT;
+        default:       throw std::runtime_error("Unknown unary operator: " + opStr);
     }
+}
 
-    if (key == "FieldAccess") {
-        if (!value.is_object() || !value.contains("ptr") || !value.contains("field")) {
-            throw std::runtime_error("Invalid JSON for FieldAccess content");
-        }
-        return std::make_unique<FieldAccess>(buildExpression(value.at("ptr")), value.at("field").get<std::string>());
+BinaryOperand buildBinaryOperand(const std::string &opStr) {
+    switch (lookupTag(opStr)) {
+        case Tag::ADD:    return BinaryOperand::ADD;
+        case Tag::SUB:    return BinaryOperand::SUB;
+        case Tag::MUL:    return BinaryOperand::MUL;
+        case Tag::DIV:    return BinaryOperand::DIV;
+        case Tag::AND:    return BinaryOperand::AND;
+        case Tag::OR:     return BinaryOperand::OR;
+        case Tag::EQ:     return BinaryOperand::EQ;
+        case Tag::NOT_EQ: return BinaryOperand::NOT_EQ;
+        case Tag::LT:     return BinaryOperand::LT;
+        case Tag::LTE:    return BinaryOperand::LTE;
+        case Tag::GT:     return BinaryOperand::GT;
+        case Tag::GTE:    return BinaryOperand::GTE;
+        default:          throw std::runtime_error("Unknown binary operator: " + opStr);
     }
-
-    throw std::runtime_error("JSON node is not a valid Place kind: " + key);
 }
 
-std::unique_ptr<Expression> buildExpression(const nlohmann::json &json) {
+NodePtr<Expression> buildExpression(const nlohmann::json &json) {
+    NestingGuard guard;
+
     if (!json.is_object() || json.empty()) {
         if (json.is_string() && json.get<std::string>() == "Nil") { // Check if Nil is just a string
-            return std::make_unique<Nil>();
+            return makeNode<Nil>();
         }
         
         if (json.is_object() && json.contains("kind") &&
             json.at("kind") == "Nil") {
-            return std::make_unique<Nil>();
+            return makeNode<Nil>();
         }
 
         throw std::runtime_error("Invalid JSON for Exp: Must be non-empty object or known literal");
@@ -114,127 +170,93 @@ std::unique_ptr<Expression> buildExpression(const nlohmann::json &json) {
     const auto &key = json.begin().key();
     const auto &value = json.begin().value();
 
-    if (key == "Id" || key == "Deref" || key == "ArrayAccess" || key == "FieldAccess") {
-        nlohmann::json placeObj;
-        placeObj[key] = value;
-        return std::make_unique<Value>(buildPlace(placeObj));
-    }
-    
-    if (key == "Num") {
-        return std::make_unique<Number>(value.get<long long>());
-    }
-    
-    if (key == "Nil") {
-        return std::make_unique<Nil>();
-    }
-    
-    if (key == "Select") {
-        if (!value.is_object() || !value.contains("guard") || !value.contains("tt") || !value.contains("ff")) {
-            throw std::runtime_error("Invalid JSON for Select content");
-        }
-        return std::make_unique<Select>(buildExpression(value.at("guard")), buildExpression(value.at("tt")), buildExpression(value.at("ff")));
-    }
-    if (key == "UnOp") { 
-        if (!value.is_array() || value.size() != 2) {
-            throw std::runtime_error("Invalid JSON for UnOp content: Expected 2-element array [op, exp]");
-        }
-        
-        if (!value[0].is_string()) {
-            throw std::runtime_error("Invalid JSON for UnOp content: Operator name must be a string");
-        }
+    switch (lookupTag(key)) {
+        case Tag::ID:
+        case Tag::DEREF:
+        case Tag::ARRAY_ACCESS:
+        case Tag::FIELD_ACCESS:
+            return makeNode<Value>(buildPlace(key, value));
 
-        UnaryOperand operand;
-        std::string opStr = value[0].get<std::string>();
-        
-        if (opStr == "Neg") {
-            operand = UnaryOperand::NEG;
-        } else if (opStr == "Not") {
-            operand = UnaryOperand::NOT;
-        } else {
-            throw std::runtime_error("Unknown unary operator: " + opStr);
-        }
-        return std::make_unique<UnaryOperation>(operand, buildExpression(value[1]));
-    }
-    if (key == "BinOp") {
-        if (!value.is_object() || !value.contains("op") || !value.contains("left") || !value.contains("right")) {
-            throw std::runtime_error("Invalid JSON for BinaryOperation content");
+        case Tag::NUM:
+            return makeNode<Number>(value.get<long long>());
+
+        case Tag::NIL:
+            return makeNode<Nil>();
+
+        case Tag::SELECT:
+            if (!value.is_object() || !value.contains("guard") || !value.contains("tt") || !value.contains("ff")) {
+                throw std::runtime_error("Invalid JSON for Select content");
+            }
+            return makeNode<Select>(buildExpression(value.at("guard")), buildExpression(value.at("tt")), buildExpression(value.at("ff")));
+
+        case Tag::UN_OP: {
+            if (!value.is_array() || value.size() != 2) {
+                throw std::runtime_error("Invalid JSON for UnOp content: Expected 2-element array [op, exp]");
+            }
+            
+            if (!value[0].is_string()) {
+                throw std::runtime_error("Invalid JSON for UnOp content: Operator name must be a string");
+            }
+
+            UnaryOperand operand = buildUnaryOperand(value[0].get<std::string>());
+            return makeNode<UnaryOperation>(operand, buildExpression(value[1]));
         }
-        
-        BinaryOperand operand;
-        std::string opStr = value.at("op").get<std::string>();
-        
-        if (opStr == "Add") { 
-            operand = BinaryOperand::ADD;
-        } else if (opStr == "Sub") {
-            operand = BinaryOperand::SUB;
-        } else if (opStr == "Mul") {
-            operand = BinaryOperand::MUL;
-        } else if (opStr == "Div") {
-            operand = BinaryOperand::DIV;
-        } else if (opStr == "And") {
-            operand = BinaryOperand::AND;
-        } else if (opStr == "Or") {
-            operand = BinaryOperand::OR;
-        } else if (opStr == "Eq") {
-            operand = BinaryOperand::EQ;
-        } else if (opStr == "NotEq") {
-            operand = BinaryOperand::NOT_EQ;
-        } else if (opStr == "Lt") {
-            operand = BinaryOperand::LT;
-        } else if (opStr == "Lte") {
-            operand = BinaryOperand::LTE;
-        } else if (opStr == "Gt") {
-            operand = BinaryOperand::GT;
-        } else if (opStr == "Gte") {
-            operand = BinaryOperand::GTE;
-        } else {
-            throw std::runtime_error("Unknown binary operator: " + opStr);
+
+        case Tag::BIN_OP: {
+            if (!value.is_object() || !value.contains("op") || !value.contains("left") || !value.contains("right")) {
+                throw std::runtime_error("Invalid JSON for BinaryOperation content");
+            }
+            
+            BinaryOperand operand = buildBinaryOperand(value.at("op").get<std::string>());
+            return makeNode<BinaryOperation>(operand, buildExpression(value.at("left")), buildExpression(value.at("right")));
         }
-        return std::make_unique<BinaryOperation>(operand, buildExpression(value.at("left")), buildExpression(value.at("right")));
-    }
-    
-    if (key == "NewSingle") {
-        return std::make_unique<NewSingleton>(buildType(value));
-    }
-    
-    if (key == "NewArray") {
-        if (!value.is_array() || value.size() != 2) {
-            throw std::runtime_error("Invalid JSON for NewArray content: Expected 2-element array [Type, Exp]");
+
+        case Tag::NEW_SINGLE:
+            return makeNode<NewSingleton>(buildType(value));
+
+        case Tag::NEW_ARRAY: {
+            if (!value.is_array() || value.size() != 2) {
+                throw std::runtime_error("Invalid JSON for NewArray content: Expected 2-element array [Type, Exp]");
+            }
+            
+            auto type = buildType(value[0]);
+            auto sizeExp = buildExpression(value[1]);
+            return makeNode<NewArray>(std::move(type), std::move(sizeExp));
         }
-        
-        auto type = buildType(value[0]);
-        auto sizeExp = buildExpression(value[1]);
-        return std::make_unique<NewArray>(std::move(type), std::move(sizeExp));
-    }
-    
-    if (key == "Call") {
-        return std::make_unique<CallExpression>(buildFunctionCall(value));
-    }
-    
-    if (key == "Val") {
-        return std::make_unique<Value>(buildPlace(value));
+
+        case Tag::CALL:
+            return makeNode<CallExpression>(buildFunctionCall(value));
+
+        case Tag::VAL:
+            return makeNode<Value>(buildPlace(value));
+
+        default:
+            break;
     }
 
     throw std::runtime_error("Unknown/Unhandled expression kind: " + key + " with value " + value.dump());
 }
 
-std::unique_ptr<FunctionCall> buildFunctionCall(const nlohmann::json &json) {
+NodePtr<FunctionCall> buildFunctionCall(const nlohmann::json &json) {
     if (!json.is_object() || !json.contains("callee") || !json.contains("args") || !json.at("args").is_array()) {
         throw std::runtime_error("Invalid JSON for FunctionCall");
     }
     
-    std::vector<std::unique_ptr<Expression>> args;
+    Arguments args;
     
     for (const auto &arg : json.at("args")) {
         args.push_back(buildExpression(arg));
     }
     
-    return std::make_unique<FunctionCall>(buildExpression(json.at("callee")), std::move(args));
+    return makeNode<FunctionCall>(buildExpression(json.at("callee")), std::move(args));
 }
 
-std::unique_ptr<Statement> buildStatement(const nlohmann::json &json) {
+NodePtr<Statement> buildStatement(const nlohmann::json &json) {
+    NestingGuard guard;
+    memory::checkLimit();
+
     if (json.is_array()) {
-        auto statementsNode = std::make_unique<Statements>();
+        auto statementsNode = makeNode<Statements>();
         
         for (const auto &element : json) {
             statementsNode->statements.push_back(buildStatement(element));
@@ -246,15 +268,14 @@ std::unique_ptr<Statement> buildStatement(const nlohmann::json &json) {
     if (json.is_string()) {
         const std::string &kind = json.get<std::string>();
         
-        if (kind == "Break") {
-            return std::make_unique<Break>();
-        }
-
-        if (kind == "Continue") {
-            return std::make_unique<Continue>();
+        switch (lookupTag(kind)) {
+            case Tag::BREAK:
+                return makeNode<Break>();
+            case Tag::CONTINUE:
+                return makeNode<Continue>();
+            default:
+                throw std::runtime_error("Unknown simple string statement: " + kind);
         }
-
-        throw std::runtime_error("Unknown simple string statement: " + kind);
     }
 
     if (!json.is_object() || json.empty()) {
@@ -264,62 +285,64 @@ std::unique_ptr<Statement> buildStatement(const nlohmann::json &json) {
     const auto &key = json.begin().key();
     const auto &value = json.begin().value();
 
-    if (key == "Assign") {
-        if (!value.is_array() || value.size() != 2) {
-            throw std::runtime_error("Invalid JSON for Assign content: Expected [Place, Exp]");
-        }
-        return std::make_unique<Assignment>(buildPlace(value[0]), buildExpression(value[1]));
-    }
+    switch (lookupTag(key)) {
+        case Tag::ASSIGN:
+            if (!value.is_array() || value.size() != 2) {
+                throw std::runtime_error("Invalid JSON for Assign content: Expected [Place, Exp]");
+            }
+            return makeNode<Assignment>(buildPlace(value[0]), buildExpression(value[1]));
 
-    if (key == "Call") {
-        return std::make_unique<CallStatement>(buildFunctionCall(value));
-    }
+        case Tag::CALL:
+            return makeNode<CallStatement>(buildFunctionCall(value));
 
-    if (key == "If") {
-        if (!value.is_object() || !value.contains("guard") || !value.contains("tt")) {
-            throw std::runtime_error("Invalid JSON for If content: Missing guard or tt");
-        }
-        
-        std::optional<std::unique_ptr<Statement>> ff = std::nullopt;
-        nlohmann::json ffJson = value.value("ff", nlohmann::json());
-        
-        if (!ffJson.is_null() && !(ffJson.is_array() && ffJson.empty())) {
-            ff = buildStatement(ffJson);
+        case Tag::IF: {
+            if (!value.is_object() || !value.contains("guard") || !value.contains("tt")) {
+                throw std::runtime_error("Invalid JSON for If content: Missing guard or tt");
+            }
+            
+            std::optional<NodePtr<Statement>> ff = std::nullopt;
+            nlohmann::json ffJson = value.value("ff", nlohmann::json());
+            
+            if (!ffJson.is_null() && !(ffJson.is_array() && ffJson.empty())) {
+                ff = buildStatement(ffJson);
+            }
+            
+            return makeNode<If>(buildExpression(value.at("guard")), buildStatement(value.at("tt")), std::move(ff));
         }
-        
-        return std::make_unique<If>(buildExpression(value.at("guard")), buildStatement(value.at("tt")), std::move(ff));
-    }
 
-    if (key == "While") {
-        if (!value.is_array() || value.size() != 2) {
-            throw std::runtime_error("Invalid JSON for While content: Expected [GuardExp, BodyStmtArray]");
-        }
+        case Tag::WHILE:
+            if (!value.is_array() || value.size() != 2) {
+                throw std::runtime_error("Invalid JSON for While content: Expected [GuardExp, BodyStmtArray]");
+            }
 
-        return std::make_unique<While>(buildExpression(value[0]), buildStatement(value[1]));
-    }
+            return makeNode<While>(buildExpression(value[0]), buildStatement(value[1]));
 
-    if (key == "Return") {
-        std::optional<std::unique_ptr<Expression>> expression = std::nullopt;
-        
-        if (!value.is_null()) {
-            expression = buildExpression(value);
+        case Tag::RETURN: {
+            std::optional<NodePtr<Expression>> expression = std::nullopt;
+            
+            if (!value.is_null()) {
+                expression = buildExpression(value);
+            }
+
+            return makeNode<Return>(std::move(expression));
         }
 
-        return std::make_unique<Return>(std::move(expression));
-    }
+        case Tag::STMTS: {
+            if (!value.is_array()) {
+                throw std::runtime_error("Invalid JSON for nested Stmts content");
+            }
 
-    if (key == "Stmts") {
-        if (!value.is_array()) {
-            throw std::runtime_error("Invalid JSON for nested Stmts content");
+            auto statementsNode = makeNode<Statements>();
+            
+            for (const auto &statement : value) {
+                statementsNode->statements.push_back(buildStatement(statement));
+            }
+            
+            return statementsNode;
         }
 
-        auto statementsNode = std::make_unique<Statements>();
-        
-        for (const auto &statement : value) {
-            statementsNode->statements.push_back(buildStatement(statement));
-        }
-        
-        return statementsNode;
+        default:
+            break;
     }
 
     throw std::runtime_error("Unknown statement kind object: " + key);
@@ -332,12 +355,12 @@ Declaration buildDeclaration(const nlohmann::json &json) {
     return {json.at("name").get<std::string>(), buildType(json.at("typ"))};
 }
 
-std::unique_ptr<FunctionDefinition> buildFunctionDefintion(const nlohmann::json &json) {
+NodePtr<FunctionDefinition> buildFunctionDefintion(const nlohmann::json &json) {
     if (!json.is_object() || !json.contains("name") || !json.contains("prms") || !json.contains("rettyp") || !json.contains("locals") || !json.contains("stmts")) {
         throw std::runtime_error("Invalid JSON for Function definition");
     }
     
-    auto function = std::make_unique<FunctionDefinition>();
+    auto function = makeNode<FunctionDefinition>();
     function->name = json.at("name").get<std::string>();
     function->returnType = buildType(json.at("rettyp"));
     
@@ -349,7 +372,7 @@ std::unique_ptr<FunctionDefinition> buildFunctionDefintion(const nlohmann::json
         function->locals.push_back(buildDeclaration(local));
     }
     
-    auto bodyStatements = std::make_unique<Statements>();
+    auto bodyStatements = makeNode<Statements>();
     
     if (!json.at("stmts").is_array()) {
         throw std::runtime_error("Invalid JSON: function 'stmts' must be an array");
@@ -364,11 +387,11 @@ std::unique_ptr<FunctionDefinition> buildFunctionDefintion(const nlohmann::json
     return function;
 }
 
-std::unique_ptr<StructDefinition> buildStructDefinition(const nlohmann::json &json) {
+NodePtr<StructDefinition> buildStructDefinition(const nlohmann::json &json) {
     if (!json.is_object() || !json.contains("name") || !json.contains("fields") || !json.at("fields").is_array()) {
         throw std::runtime_error("Invalid JSON for Struct definition");
     }
-    auto struc = std::make_unique<StructDefinition>();
+    auto struc = makeNode<StructDefinition>();
     struc->name = json.at("name").get<std::string>();
     for (const auto &field : json.at("fields")) {
         struc->fields.push_back(buildDeclaration(field));
@@ -386,7 +409,8 @@ Extern buildExtern(const nlohmann::json &json) {
 
     auto builtType = buildType(json.at("typ"));
 
-    if (auto funcType = std::dynamic_pointer_cast<FunctionType>(builtType)) {
+    if (builtType->getTypeKind() == TypeKind::FUNCTION) {
+        const auto *funcType = static_cast<const FunctionType*>(builtType.get());
         e.returnType = funcType->returnType;
         e.paramTypes = funcType->paramTypes;
     } else {
@@ -402,6 +426,9 @@ std::unique_ptr<Program> buildProgram(const nlohmann::json &json) {
     }
     
     auto program = std::make_unique<Program>();
+    program->arena = std::make_unique<Arena>();
+    Arena::Scope arenaScope(*program->arena);
+
     for (const auto &s: json.at("structs")) {
         program->structs.push_back(buildStructDefinition(s));
     }
@@ -417,34 +444,38 @@ std::unique_ptr<Program> buildProgram(const nlohmann::json &json) {
     return program;
 }
 
-Gamma constructGamma(const std::vector<Extern> &externs, const std::vector<std::unique_ptr<FunctionDefinition>> &functions) {
-    Gamma gamma;
+// Names are interned here, once per program, so lookups during checking compare Symbols
+Gamma constructGamma(const std::vector<Extern> &externs, const std::vector<NodePtr<FunctionDefinition>> &functions) {
+    std::vector<Gamma::Entry> entries;
+    entries.reserve(externs.size() + functions.size());
+
     for (const auto &e: externs) {
-        gamma[e.name] = std::make_shared<FunctionType>(e.paramTypes, e.returnType);
+        entries.emplace_back(SymbolTable::global().intern(e.name), TypeContext::global().functionType(e.paramTypes, e.returnType));
     }
     for (const auto &f: functions) {
         if (f->name != "main") {
-            std::vector<std::shared_ptr<Type>> paramTypes;
+            // Inline for the usual parameter counts, so no allocation per function
+            TypeList paramTypes;
             for (const auto &param : f->params) {
                 paramTypes.push_back(param.type);
             }
-            auto functionType = std::make_shared<FunctionType>(std::move(paramTypes), f->returnType);
-            gamma[f->name] = std::make_shared<PointerType>(functionType);
+            auto functionType = TypeContext::global().functionType(paramTypes, f->returnType);
+            entries.emplace_back(SymbolTable::global().intern(f->name), TypeContext::global().pointerType(functionType));
         }
     }
     
-    return gamma;
+    return Gamma(std::move(entries));
 }
 
-Delta constructDelta(const std::vector<std::unique_ptr<StructDefinition>> &structs) {
+Delta constructDelta(const std::vector<NodePtr<StructDefinition>> &structs) {
     Delta delta;
     for (const auto &s: structs) {
-        std::unordered_map<std::string, std::shared_ptr<Type>> fields;
+        delta.addStruct(SymbolTable::global().intern(s->name));
         for (const auto &field : s->fields) {
-            fields[field.name] = field.type;
+            delta.addField(field.symbol, field.type);
         }
-        delta[s->name] = std::move(fields);
     }
+    delta.finish();
     
     return delta;
 }
@@ -6,17 +6,20 @@
 #include "ast.hpp"
 
 extern std::shared_ptr<Type> buildType(const nlohmann::json &json);
-extern std::unique_ptr<Expression> buildExpression(const nlohmann::json &json);
-extern std::unique_ptr<Place> buildPlace(const nlohmann::json &json);
-extern std::unique_ptr<Statement> buildStatement(const nlohmann::json &json);
+extern NodePtr<Expression> buildExpression(const nlohmann::json &json);
+extern NodePtr<Place> buildPlace(const nlohmann::json &json);
+extern NodePtr<Place> buildPlace(const std::string &key, const nlohmann::json &value);
+extern NodePtr<Statement> buildStatement(const nlohmann::json &json);
 extern Declaration buildDeclaration(const nlohmann::json &json);
-extern std::unique_ptr<FunctionDefinition> buildFunctionDefinition(const nlohmann::json &json);
-extern std::unique_ptr<StructDefinition> buildStructDefinition(const nlohmann::json &json);
+extern NodePtr<FunctionDefinition> buildFunctionDefinition(const nlohmann::json &json);
+extern NodePtr<StructDefinition> buildStructDefinition(const nlohmann::json &json);
 extern Extern buildExtern(const nlohmann::json &json);
 extern std::unique_ptr<Program> buildProgram(const nlohmann::json &json);
-extern std::unique_ptr<FunctionCall> buildFunctionCall(const nlohmann::json &json);
+extern NodePtr<FunctionCall> buildFunctionCall(const nlohmann::json &json);
+extern UnaryOperand buildUnaryOperand(const std::string &opStr);
+extern BinaryOperand buildBinaryOperand(const std::string &opStr);
 
-Gamma constructGamma(const std::vector<Extern> &externs, const std::vector<std::unique_ptr<FunctionDefinition>> &functions);
-Delta constructDelta(const std::vector<std::unique_ptr<StructDefinition>> &structs);
+Gamma constructGamma(const std::vector<Extern> &externs, const std::vector<NodePtr<FunctionDefinition>> &functions);
+Delta constructDelta(const std::vector<NodePtr<StructDefinition>> &structs);
 
 #endif
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <unordered_set>
+#include <vector>
+
+#include "cache.hpp"
+#include "traversal.hpp"
+
+// Bump whenever a typing rule or message changes, so stale verdicts are dropped
+static constexpr const char *CACHE_HEADER = "cflat-check-cache 2";
+
+namespace {
+
+// 64-bit FNV-1a. Names and types are mixed in as text rather than as Symbols
+// or pointers, so the same program yields the same keys in every process.
+class KeyHasher {
+public:
+    void mix(uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            mixByte(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void mix(std::string_view text) {
+        mix(text.size());
+
+        for (char c : text) {
+            mixByte(static_cast<uint8_t>(c));
+        }
+    }
+
+    // Mixes in the type's text, rendered into a buffer kept across calls
+    void mix(const Type &type) {
+        text.clear();
+        type.render(text);
+        mix(std::string_view(text));
+    }
+
+    uint64_t value() const {
+        return hash;
+    }
+
+private:
+    void mixByte(uint8_t byte) {
+        hash ^= byte;
+        hash *= 1099511628211ULL;
+    }
+
+    uint64_t hash = 14695981039346656037ULL;
+    std::string text;
+};
+
+// Appends the struct types that occur anywhere inside type
+void collectStructTypes(const Type *type, std::vector<const StructType*> &out) {
+    switch (type->getTypeKind()) {
+        case TypeKind::STRUCT:
+            out.push_back(static_cast<const StructType*>(type));
+            break;
+        case TypeKind::POINTER:
+            collectStructTypes(static_cast<const PointerType*>(type)->pointeeType.get(), out);
+            break;
+        case TypeKind::ARRAY:
+            collectStructTypes(static_cast<const ArrayType*>(type)->elementType.get(), out);
+            break;
+        case TypeKind::FUNCTION: {
+            const auto *functionType = static_cast<const FunctionType*>(type);
+
+            for (const auto &paramType : functionType->paramTypes) {
+                collectStructTypes(paramType.get(), out);
+            }
+
+            collectStructTypes(functionType->returnType.get(), out);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+} // namespace
+
+uint64_t functionKey(const FunctionDefinition &function, const Gamma &gamma, const Delta &delta) {
+    KeyHasher hasher;
+    std::vector<const Identifier*> names;
+    std::vector<const StructType*> structTypes;
+
+    // The function's own tree in pre-order, with each node's child count
+    std::vector<Node*> pending{const_cast<FunctionDefinition*>(&function)};
+
+    while (!pending.empty()) {
+        const Node *node = pending.back();
+        pending.pop_back();
+        hasher.mix(static_cast<uint64_t>(node->kind));
+
+        switch (node->kind) {
+            case NodeKind::FUNCTION_DEFINITION: {
+                const auto *definition = static_cast<const FunctionDefinition*>(node);
+                hasher.mix(definition->name);
+                hasher.mix(*definition->returnType);
+                hasher.mix(definition->params.size());
+                collectStructTypes(definition->returnType.get(), structTypes);
+                break;
+            }
+            case NodeKind::DECLARATION: {
+                const auto *declaration = static_cast<const Declaration*>(node);
+                hasher.mix(declaration->name);
+                hasher.mix(*declaration->type);
+                collectStructTypes(declaration->type.get(), structTypes);
+                break;
+            }
+            case NodeKind::NUMBER:
+                hasher.mix(static_cast<uint64_t>(static_cast<const Number*>(node)->value));
+                break;
+            case NodeKind::UNARY_OPERATION:
+                hasher.mix(static_cast<uint64_t>(static_cast<const UnaryOperation*>(node)->operand));
+                break;
+            case NodeKind::BINARY_OPERATION:
+                hasher.mix(static_cast<uint64_t>(static_cast<const BinaryOperation*>(node)->operand));
+                break;
+            case NodeKind::NEW_SINGLETON: {
+                const auto *allocation = static_cast<const NewSingleton*>(node);
+                hasher.mix(*allocation->type);
+                collectStructTypes(allocation->type.get(), structTypes);
+                break;
+            }
+            case NodeKind::NEW_ARRAY: {
+                const auto *allocation = static_cast<const NewArray*>(node);
+                hasher.mix(*allocation->type);
+                collectStructTypes(allocation->type.get(), structTypes);
+                break;
+            }
+            case NodeKind::IDENTIFIER:
+                hasher.mix(static_cast<const Identifier*>(node)->name);
+                names.push_back(static_cast<const Identifier*>(node));
+                break;
+            case NodeKind::FIELD_ACCESS:
+                hasher.mix(static_cast<const FieldAccess*>(node)->field);
+                break;
+            default:
+                break;
+        }
+
+        size_t first = pending.size();
+        collectChildren(const_cast<Node &>(*node), pending);
+        hasher.mix(pending.size() - first);
+        std::reverse(pending.begin() + first, pending.end());
+    }
+
+    // The Gamma entry, or its absence, of every name mentioned, in name order
+    std::sort(names.begin(), names.end(), [](const Identifier *lhs, const Identifier *rhs) {
+        return lhs->name < rhs->name;
+    });
+    names.erase(std::unique(names.begin(), names.end(), [](const Identifier *lhs, const Identifier *rhs) {
+        return lhs->symbol == rhs->symbol;
+    }), names.end());
+
+    for (const Identifier *identifier : names) {
+        hasher.mix(identifier->name);
+
+        if (const std::shared_ptr<Type> *type = gamma.find(identifier->symbol)) {
+            hasher.mix(1);
+            hasher.mix(**type);
+            collectStructTypes(type->get(), structTypes);
+        } else {
+            hasher.mix(0);
+        }
+    }
+
+    // The definition, or absence, of every struct reachable from those types
+    std::unordered_set<Symbol> visited;
+    std::vector<const StructType*> reachable;
+
+    while (!structTypes.empty()) {
+        const StructType *structType = structTypes.back();
+        structTypes.pop_back();
+
+        if (!visited.insert(structType->symbol).second) {
+            continue;
+        }
+
+        reachable.push_back(structType);
+
+        if (const StructTable::Layout *layout = delta.find(structType->symbol)) {
+            for (size_t i = 0; i < layout->count; i++) {
+                collectStructTypes(delta.fieldType(*layout, i).get(), structTypes);
+            }
+        }
+    }
+
+    std::sort(reachable.begin(), reachable.end(), [](const StructType *lhs, const StructType *rhs) {
+        return lhs->name < rhs->name;
+    });
+
+    for (const StructType *structType : reachable) {
+        hasher.mix(structType->name);
+        const StructTable::Layout *layout = delta.find(structType->symbol);
+
+        if (!layout) {
+            hasher.mix(0);
+            continue;
+        }
+
+        hasher.mix(1 + static_cast<uint64_t>(layout->count));
+
+        for (size_t i = 0; i < layout->count; i++) {
+            hasher.mix(SymbolTable::global().name(delta.fieldName(*layout, i)));
+            hasher.mix(*delta.fieldType(*layout, i));
+        }
+    }
+
+    return hasher.value();
+}
+
+/* CheckCache */
+
+CheckCache::CheckCache(std::string path) {
+    this->path = std::move(path);
+    std::ifstream input(this->path, std::ios::binary);
+    std::string header;
+
+    if (!std::getline(input, header) || header != CACHE_HEADER) {
+        return;
+    }
+
+    // One "<key> V" line per valid function, or "<key> I <rule> <length>"
+    // followed by the message, where rule is the rule's ruleName()
+    uint64_t key;
+    std::string tag;
+
+    while (input >> std::hex >> key >> tag) {
+        Verdict verdict;
+
+        if (tag == "I") {
+            std::string name;
+            size_t length;
+
+            if (!(input >> name >> std::dec >> length) || input.get() != '\n') {
+                break;
+            }
+
+            std::optional<Rule> rule = ruleFromName(name);
+            std::string message(length, '\0');
+
+            if (!rule || !input.read(message.data(), length)) {
+                break;
+            }
+
+            verdict = Failure{*rule, std::move(message)};
+        } else if (tag != "V") {
+            break;
+        }
+
+        entries[key] = {std::move(verdict), false};
+    }
+}
+
+bool CheckCache::lookup(uint64_t key, Verdict &verdict) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+
+    if (it == entries.end()) {
+        return false;
+    }
+
+    it->second.used = true;
+    verdict = it->second.verdict;
+    return true;
+}
+
+void CheckCache::store(uint64_t key, Verdict verdict) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[key] = {std::move(verdict), true};
+}
+
+void CheckCache::save() const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Written next to the cache and renamed over it, so readers never see a partial file
+    std::string temporaryPath = path + ".tmp";
+
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        output << CACHE_HEADER << "\n";
+
+        for (const auto &[key, entry] : entries) {
+            if (!entry.used) {
+                continue;
+            }
+
+            output << std::hex << key << std::dec;
+
+            if (entry.verdict) {
+                output << " I " << ruleName(entry.verdict->rule) << " " << entry.verdict->message.size() << "\n"
+                       << entry.verdict->message << "\n";
+            } else {
+                output << " V\n";
+            }
+        }
+
+        if (!output) {
+            std::remove(temporaryPath.c_str());
+            return;
+        }
+    }
+
+    std::rename(temporaryPath.c_str(), path.c_str());
+}
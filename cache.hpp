@@ -0,0 +1,50 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "ast.hpp"
+
+// Identifies everything a FunctionDefinition's verdict depends on: the
+// function's own tree, the Gamma entries of every name it mentions, and the
+// definitions of every struct reachable from the types it mentions
+extern uint64_t functionKey(const FunctionDefinition &function, const Gamma &gamma, const Delta &delta);
+
+// Per-function verdicts kept on disk between runs (--cache). A verdict is
+// either valid (no failure) or the rule the function failed and the message
+// of the error it raised. Lookups and stores may come from several threads at once.
+class CheckCache {
+public:
+    struct Failure {
+        Rule rule;
+        std::string message;
+    };
+
+    using Verdict = std::optional<Failure>;
+
+    // Loads the file if it exists and is a cache of this version; otherwise starts empty
+    explicit CheckCache(std::string path);
+
+    bool lookup(uint64_t key, Verdict &verdict);
+    void store(uint64_t key, Verdict verdict);
+
+    // Writes back the verdicts looked up or stored since loading, so the file
+    // only ever holds the functions of the most recent inputs
+    void save() const;
+
+private:
+    struct Entry {
+        Verdict verdict;
+        bool used = false;
+    };
+
+    std::string path;
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+};
+
+#endif
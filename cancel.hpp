@@ -0,0 +1,41 @@
+#ifndef CANCEL_HPP
+#define CANCEL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Shared by the items of a parallel check, numbered in source order. Only the
+// earliest failure is ever reported, so once an item fails, every item after
+// it can give up: whatever it finds, the earlier failure wins.
+class Cancellation {
+public:
+    void fail(size_t item) {
+        size_t first = firstFailure.load(std::memory_order_relaxed);
+
+        while (item < first && !firstFailure.compare_exchange_weak(first, item, std::memory_order_relaxed)) {}
+    }
+
+    bool cancelled(size_t item) const {
+        return firstFailure.load(std::memory_order_relaxed) < item;
+    }
+
+private:
+    std::atomic<size_t> firstFailure = SIZE_MAX;
+};
+
+// How many nodes or ops a checker gets through between polls of its token
+inline constexpr unsigned CANCEL_POLL_INTERVAL = 1024;
+
+// One item's view of a Cancellation, polled by the checkers as they go. The
+// default token is never cancelled.
+struct CancelToken {
+    const Cancellation *cancellation = nullptr;
+    size_t item = 0;
+
+    bool cancelled() const {
+        return cancellation && cancellation->cancelled(item);
+    }
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include <fstream>
+#include <sstream>
+
+#include "cflatcheck.hpp"
+#include "annotate.hpp"
+#include "ast.hpp"
+#include "binary.hpp"
+#include "cache.hpp"
+#include "check.hpp"
+#include "input.hpp"
+#include "memory.hpp"
+#include "server.hpp"
+#include "stats.hpp"
+#include "threadpool.hpp"
+
+namespace cflatcheck {
+
+/* Result */
+
+struct Result::State {
+    CheckResult result;
+};
+
+Result::Result(std::shared_ptr<const State> state) : state(std::move(state)) {}
+
+Status Result::status() const {
+    switch (state->result.kind) {
+        case CheckResult::Kind::VALID:
+            return Status::VALID;
+        case CheckResult::Kind::INVALID:
+            return Status::INVALID;
+        case CheckResult::Kind::UNREADABLE:
+            return Status::UNREADABLE;
+        case CheckResult::Kind::ERROR:
+            return Status::ERROR;
+        case CheckResult::Kind::MEMORY_LIMIT:
+            return Status::MEMORY_LIMIT;
+    }
+
+    return Status::ERROR;
+}
+
+const std::string &Result::message() const {
+    return state->result.message;
+}
+
+std::string_view Result::rule() const {
+    return state->result.rule ? ruleName(*state->result.rule) : std::string_view();
+}
+
+uint32_t Result::nodeCount() const {
+    return state->result.typed ? state->result.typed->types.size() : 0;
+}
+
+std::optional<uint32_t> Result::failedNode() const {
+    return state->result.node;
+}
+
+std::optional<std::string> Result::typeOf(uint32_t id) const {
+    const Type *type = state->result.typed ? state->result.typed->types.find(id) : nullptr;
+
+    if (!type) {
+        return std::nullopt;
+    }
+
+    std::ostringstream out;
+    writeType(out, type);
+    return std::move(out).str();
+}
+
+bool Result::writeAnnotated(std::ostream &out) const {
+    if (!state->result.typed) {
+        return false;
+    }
+
+    writeAnnotatedProgram(out, *state->result.typed->program, state->result.typed->types);
+    return true;
+}
+
+/* Checker */
+
+struct Checker::State {
+    std::optional<ThreadPool> pool;
+    std::optional<CheckCache> cache;
+    CheckOptions options;
+};
+
+Checker::Checker(const Options &options) : state(std::make_unique<State>()) {
+    if (options.jobs != 1) {
+        state->pool.emplace(options.jobs);
+    }
+
+    if (!options.cachePath.empty()) {
+        state->cache.emplace(options.cachePath);
+    }
+
+    state->options.useDom = options.useDom;
+    state->options.useFlat = options.useFlat;
+    state->options.recordTypes = options.recordTypes;
+    state->options.pool = state->pool ? &*state->pool : nullptr;
+    state->options.cache = state->cache ? &*state->cache : nullptr;
+}
+
+Checker::~Checker() = default;
+
+Result Checker::check(std::string_view contents) const {
+    return Result(std::make_shared<const Result::State>(Result::State{checkContents(contents, state->options)}));
+}
+
+Result Checker::checkFile(const std::string &path) const {
+    return Result(std::make_shared<const Result::State>(Result::State{::checkFile(path, state->options)}));
+}
+
+std::vector<Result> Checker::checkFiles(const std::vector<std::string> &paths) const {
+    std::vector<CheckResult> results(paths.size());
+
+    // Files are spread across the pool, and each one is checked on a single thread
+    CheckOptions serialOptions = state->options;
+    serialOptions.pool = nullptr;
+
+    if (state->pool) {
+        state->pool->parallelFor(paths.size(), [&](size_t i) {
+            results[i] = ::checkFile(paths[i], serialOptions);
+        });
+    } else {
+        for (size_t i = 0; i < paths.size(); i++) {
+            results[i] = ::checkFile(paths[i], serialOptions);
+        }
+    }
+
+    std::vector<Result> wrapped;
+    wrapped.reserve(results.size());
+
+    for (CheckResult &result : results) {
+        wrapped.push_back(Result(std::make_shared<const Result::State>(Result::State{std::move(result)})));
+    }
+
+    return wrapped;
+}
+
+int Checker::serve(const std::string &socketPath) const {
+    // Responses are only ever text, so the server has no use for the types
+    CheckOptions serverOptions = state->options;
+    serverOptions.recordTypes = false;
+    return runServer(socketPath, serverOptions);
+}
+
+void Checker::saveCache() {
+    if (state->cache) {
+        state->cache->save();
+    }
+}
+
+/* Conversion, statistics and the memory limit */
+
+bool convertFile(const std::string &inputPath, const std::string &outputPath, bool useDom, std::string &error) {
+    InputBuffer input(inputPath);
+
+    if (!input.isOpen()) {
+        error = "Could not open file " + inputPath + ".";
+        return false;
+    }
+
+    try {
+        std::unique_ptr<Program> program = loadProgram(input.contents(), useDom);
+        std::string bytes = writeProgramBinary(*program);
+        std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+
+        if (!output.write(bytes.data(), bytes.size()) || !output.flush()) {
+            error = "Could not write file " + outputPath + ".";
+            return false;
+        }
+    } catch (const memory::LimitExceeded &e) {
+        error = e.what();
+        return false;
+    } catch (const std::exception &e) {
+        error = std::string("Error: ") + e.what();
+        return false;
+    }
+
+    return true;
+}
+
+void enableStats() {
+    stats::enable();
+}
+
+bool statsEnabled() {
+    return stats::enabled();
+}
+
+void writeStats(std::ostream &out) {
+    stats::report(out);
+}
+
+void setMemoryLimit(size_t bytes) {
+    memory::setLimit(bytes);
+}
+
+} // namespace cflatcheck
@@ -0,0 +1,142 @@
+#ifndef CFLATCHECK_HPP
+#define CFLATCHECK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The checker as a library, built by make lib as libcflatcheck.a and
+// libcflatcheck.so; ./type is a command-line frontend on top of it. This
+// header is the whole interface. It includes none of the checker's own
+// headers and both classes keep their state behind a pointer, so code built
+// against it is unaffected by changes to the AST or the checker internals.
+// The library is compiled with -fvisibility=hidden: only what is marked
+// CFLATCHECK_API here is exported from libcflatcheck.so.
+#define CFLATCHECK_API __attribute__((visibility("default")))
+
+namespace cflatcheck {
+
+enum class Status {
+    VALID,
+    INVALID,
+    UNREADABLE, // could not open or parse the input
+    ERROR,      // any other failure while building or checking
+    MEMORY_LIMIT, // the process went over the limit of setMemoryLimit
+};
+
+struct Options {
+    // Build JSON input from an nlohmann::json tree rather than straight from the SAX event stream
+    bool useDom = false;
+    // Check function bodies through their flattened form
+    bool useFlat = false;
+    // Threads to check each program on, or across files in checkFiles; 0 means one per core
+    unsigned jobs = 1;
+    // Keep per-function verdicts in this file between runs, if set (see saveCache)
+    std::string cachePath;
+    // Keep every program and the type of each of its expressions in the Result.
+    // Functions are then always checked by the tree checker, ignoring the
+    // cache and useFlat.
+    bool recordTypes = false;
+};
+
+// How one input fared. Copies are cheap and share the same state.
+class CFLATCHECK_API Result {
+public:
+    Status status() const;
+
+    // "valid", "invalid: <message>" or why the input could not be checked,
+    // exactly as ./type prints it
+    const std::string &message() const;
+
+    // For an INVALID result from the typing rules, the stable name of the rule
+    // that failed, such as "unknown-id"; otherwise empty. A verdict answered
+    // from the cache names the same rule as the check it replays.
+    std::string_view rule() const;
+
+    /* With Options::recordTypes, once the program could be built */
+
+    // Nodes are numbered 0 .. nodeCount() - 1 in pre-order, in the order they
+    // appear in the input: the program, then its structs and their fields,
+    // its externs, and its functions with their parameters, locals and body
+    uint32_t nodeCount() const;
+
+    // The node the failed rule is about, if it is about one
+    std::optional<uint32_t> failedNode() const;
+
+    // The type of node id, spelled as in .astj input (e.g. {"Ptr": "Int"}), or
+    // nothing if it is not an expression or checking stopped before reaching it
+    std::optional<std::string> typeOf(uint32_t id) const;
+
+    // Writes the program as .astj with a "type" member on every typed
+    // expression, place and call. Returns false, writing nothing, without types.
+    bool writeAnnotated(std::ostream &out) const;
+
+private:
+    friend class Checker;
+    struct State;
+    explicit Result(std::shared_ptr<const State> state);
+
+    std::shared_ptr<const State> state;
+};
+
+// Checks inputs with one set of options. The thread pool, the cache and the
+// interned types and symbols are kept from one input to the next. Check one
+// input at a time per Checker. Interned types and symbols are shared by every
+// Checker in the process and never freed, so a long-lived one grows by each
+// distinct name and type it sees.
+class CFLATCHECK_API Checker {
+public:
+    explicit Checker(const Options &options = {});
+    ~Checker();
+
+    Checker(const Checker &) = delete;
+    Checker &operator=(const Checker &) = delete;
+
+    // contents hold either JSON or the binary format written by convertFile
+    Result check(std::string_view contents) const;
+    Result checkFile(const std::string &path) const;
+
+    // Checks every file, in parallel across files when jobs is not 1, with
+    // each file checked on a single thread; results are in input order
+    std::vector<Result> checkFiles(const std::vector<std::string> &paths) const;
+
+    // Serves check requests on a Unix socket until SIGINT or SIGTERM, one
+    // request per line (a path or a single-line JSON program) and one response
+    // line each. Returns the exit status.
+    int serve(const std::string &socketPath) const;
+
+    // Writes the cache back to cachePath, if there is one
+    void saveCache();
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+// Writes the program in inputPath, JSON or binary, to outputPath in the binary
+// format. On failure returns false and sets error to the reason.
+CFLATCHECK_API bool convertFile(const std::string &inputPath, const std::string &outputPath, bool useDom, std::string &error);
+
+// Turns on the phase timers and node counts behind --stats. Call before
+// anything is checked; the totals cover every input checked afterwards.
+CFLATCHECK_API void enableStats();
+CFLATCHECK_API bool statsEnabled();
+// Writes the totals as JSON lines
+CFLATCHECK_API void writeStats(std::ostream &out);
+
+// Fails the input being loaded or checked, with a MEMORY_LIMIT result, once
+// the process holds more than bytes of heap and mapped input; 0 means no
+// limit. The count starts here, so call it before anything is checked. With
+// jobs, the limit is shared by every input being checked at once. Heap bytes
+// are only counted in a program that links allocator.cpp (see memory.hpp);
+// without it, only mapped input files count.
+CFLATCHECK_API void setMemoryLimit(size_t bytes);
+
+} // namespace cflatcheck
+
+#endif
@@ -0,0 +1,153 @@
+#include <exception>
+#include <optional>
+
+#include "check.hpp"
+#include "ast.hpp"
+#include "json.hpp"
+#include "builder.hpp"
+#include "saxbuilder.hpp"
+#include "input.hpp"
+#include "memory.hpp"
+#include "binary.hpp"
+#include "stats.hpp"
+#include "traversal.hpp"
+
+// The DOM parser, polling the memory limit as each object, array, key or string comes in
+class LimitedDomParser : public nlohmann::detail::json_sax_dom_parser<nlohmann::json> {
+public:
+    using json_sax_dom_parser::json_sax_dom_parser;
+
+    bool start_object(std::size_t count) {
+        memory::checkLimit();
+        return json_sax_dom_parser::start_object(count);
+    }
+
+    bool start_array(std::size_t count) {
+        memory::checkLimit();
+        return json_sax_dom_parser::start_array(count);
+    }
+
+    bool key(string_t &value) {
+        memory::checkLimit();
+        return json_sax_dom_parser::key(value);
+    }
+
+    bool string(string_t &value) {
+        memory::checkLimit();
+        return json_sax_dom_parser::string(value);
+    }
+};
+
+static std::unique_ptr<Program> loadProgramDom(std::string_view contents) {
+    // Non-strict like operator>>, so trailing input after the root value is ignored
+    nlohmann::json json;
+
+    {
+        stats::PhaseTimer timer(stats::Phase::PARSE);
+        LimitedDomParser domBuilder(json);
+        nlohmann::json::sax_parse(contents.data(), contents.data() + contents.size(), &domBuilder,
+                                  nlohmann::json::input_format_t::json, false);
+    }
+
+    stats::PhaseTimer timer(stats::Phase::BUILD);
+    return buildProgram(json);
+}
+
+std::unique_ptr<Program> loadProgram(std::string_view contents, bool useDom) {
+    if (isBinaryProgram(contents)) {
+        stats::PhaseTimer timer(stats::Phase::BUILD);
+        return loadProgramBinary(contents);
+    }
+
+    if (useDom) {
+        return loadProgramDom(contents);
+    }
+
+    std::exception_ptr streamingError;
+
+    try {
+        // Parsing and building are one pass here, so it all counts as build time
+        stats::PhaseTimer timer(stats::Phase::BUILD);
+        return buildProgramStreaming(contents);
+    } catch (const std::runtime_error &) {
+        streamingError = std::current_exception();
+    }
+
+    // The streaming builder sees a malformed value before the rest of it, so it
+    // can't dump it or check its parts in the DOM builder's order, and it is
+    // stricter about a few shapes nlohmann converts (true as a Num, {} as an
+    // empty list). Rebuild the program the DOM way, so the input loads or fails
+    // exactly as with --dom. Only if the DOM can't load it at all (too deep,
+    // over the limit) does the streaming error stand.
+    try {
+        return loadProgramDom(contents);
+    } catch (const std::runtime_error &) {
+        throw;
+    } catch (const nlohmann::json::exception &) {
+        throw;
+    } catch (const std::exception &) {
+    }
+
+    std::rethrow_exception(streamingError);
+}
+
+CheckResult checkContents(std::string_view contents, const CheckOptions &options) {
+    try {
+        // An input that is itself over the limit fails before it is parsed
+        memory::checkLimit();
+        std::unique_ptr<Program> program = loadProgram(contents, options.useDom);
+
+        if (stats::enabled()) {
+            stats::countNodes(*program);
+        }
+
+        std::optional<TypeTable> types;
+
+        if (options.recordTypes) {
+            types.emplace(assignNodeIds(*program));
+        }
+
+        // Invalid programs come back as a Diagnostic, not an exception, and are
+        // only rendered here while the nodes they point at still exist
+        std::optional<Diagnostic> failure = program->diagnose(options.pool, options.cache, options.useFlat, types ? &*types : nullptr);
+        CheckResult result = failure ? CheckResult{CheckResult::Kind::INVALID, "invalid: ", failure->rule}
+                                     : CheckResult{CheckResult::Kind::VALID, "valid"};
+
+        if (failure) {
+            render(*failure, result.message);
+        }
+
+        if (types) {
+            if (failure && failure->node) {
+                result.node = failure->node->id;
+            }
+
+            result.typed = std::make_shared<const TypedProgram>(TypedProgram{std::move(program), std::move(*types)});
+        }
+
+        return result;
+    } catch (const memory::LimitExceeded &e) {
+        return {CheckResult::Kind::MEMORY_LIMIT, e.what()};
+    } catch (const nlohmann::json::parse_error &e) {
+        return {CheckResult::Kind::UNREADABLE, std::string("JSON parsing error ") + e.what()};
+    } catch (const std::runtime_error &e) {
+        return {CheckResult::Kind::INVALID, std::string("invalid: ") + e.what()};
+    } catch (const std::exception &e) {
+        return {CheckResult::Kind::ERROR, std::string("Error: ") + e.what()};
+    }
+}
+
+CheckResult checkFile(const std::string &inputPath, const CheckOptions &options) {
+    std::optional<InputBuffer> input;
+
+    {
+        stats::PhaseTimer timer(stats::Phase::READ);
+        input.emplace(inputPath);
+    }
+
+    if (!input->isOpen()) {
+        return {CheckResult::Kind::UNREADABLE, "Could not open file " + inputPath + "."};
+    }
+
+    return checkContents(input->contents(), options);
+}
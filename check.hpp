@@ -0,0 +1,69 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "annotate.hpp"
+#include "diagnostic.hpp"
+
+class ThreadPool;
+class CheckCache;
+struct Program;
+
+// A program kept after a check with CheckOptions::recordTypes, numbered by
+// assignNodeIds, with the type of every expression checked
+struct TypedProgram {
+    std::unique_ptr<Program> program;
+    TypeTable types;
+};
+
+// How checking a single input ended, and the text single-file mode prints for it
+struct CheckResult {
+    enum class Kind {
+        VALID,
+        INVALID,
+        UNREADABLE, // could not open or parse the input
+        ERROR,      // any other failure while building or checking
+        MEMORY_LIMIT, // over the limit of --max-memory
+    };
+
+    Kind kind;
+    std::string message;
+
+    // For an INVALID result from the typing rules: the rule that failed and,
+    // with recordTypes, the id of the node it is about, if it is about one
+    std::optional<Rule> rule = std::nullopt;
+    std::optional<uint32_t> node = std::nullopt;
+
+    // With recordTypes, whenever the program could be built
+    std::shared_ptr<const TypedProgram> typed = nullptr;
+};
+
+// How inputs are loaded and checked, as chosen on the command line
+struct CheckOptions {
+    // Build JSON input from an nlohmann::json tree rather than straight from the SAX event stream (--dom)
+    bool useDom = false;
+    // Check function bodies through the flattened form of flat.hpp (--flat)
+    bool useFlat = false;
+    ThreadPool *pool = nullptr;
+    CheckCache *cache = nullptr;
+    // Keep the program and the type of every expression in the result (--annotate).
+    // Functions are then checked by the tree checker, without the cache or --flat.
+    bool recordTypes = false;
+};
+
+// Builds a program from contents, which hold either the binary format of
+// binary.hpp or JSON. useDom builds JSON input from an nlohmann::json tree
+// rather than straight from the SAX event stream. Either way, malformed JSON
+// fails with the DOM builder's message.
+std::unique_ptr<Program> loadProgram(std::string_view contents, bool useDom);
+
+// Loads and checks a program, reporting every failure as a result
+CheckResult checkContents(std::string_view contents, const CheckOptions &options);
+CheckResult checkFile(const std::string &inputPath, const CheckOptions &options);
+
+#endif
@@ -0,0 +1,464 @@
+#include "checker.hpp"
+
+const FunctionType *calleeFunctionType(const Type *calleeType) {
+    switch (calleeType->getTypeKind()) {
+        case TypeKind::FUNCTION:
+            return static_cast<const FunctionType*>(calleeType);
+        case TypeKind::POINTER: {
+            const Type *pointeeType = static_cast<const PointerType*>(calleeType)->pointeeType.get();
+            return pointeeType->getTypeKind() == TypeKind::FUNCTION ? static_cast<const FunctionType*>(pointeeType) : nullptr;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+Checker::Checker(const Scope &gamma, const Delta &delta, TypeTable *table, CancelToken cancel)
+    : gamma(gamma), delta(delta), table(table), cancel(cancel) {}
+
+// The walk only reads the tree; Visitor takes nodes by non-const reference
+const Type *Checker::checkExpression(const Node &expression) {
+    // Types in the table were derived under this same scope, so a subtree
+    // checked before is answered without walking it again
+    if (table) {
+        if (const Type *type = table->find(expression)) {
+            return type;
+        }
+    }
+
+    types.clear();
+    returns.clear();
+    diagnostic.reset();
+    walk(const_cast<Node &>(expression));
+    return diagnostic ? nullptr : popType();
+}
+
+bool Checker::checkStatement(const Statement &statement, const Type *returnType, bool inLoop) {
+    this->returnType = returnType;
+    this->loopDepth = inLoop ? 1 : 0;
+    types.clear();
+    returns.clear();
+    diagnostic.reset();
+    walk(const_cast<Statement &>(statement));
+    return diagnostic ? false : popReturns();
+}
+
+const std::optional<Diagnostic> &Checker::failure() const {
+    return diagnostic;
+}
+
+const Type *Checker::popType() {
+    const Type *type = types.back();
+    types.pop_back();
+    return type;
+}
+
+bool Checker::popReturns() {
+    bool doesReturn = returns.back();
+    returns.pop_back();
+    return doesReturn;
+}
+
+void Checker::push(const Node &node, const Type *type) {
+    if (table) {
+        table->record(node, type);
+    }
+
+    types.push_back(type);
+
+    // Every expression pushes a type, so this bounds the work done after a cancel
+    if (++pushes % CANCEL_POLL_INTERVAL == 0 && cancel.cancelled()) {
+        fail({.rule = Rule::CANCELLED});
+    }
+}
+
+void Checker::fail(Diagnostic diagnostic) {
+    this->diagnostic = std::move(diagnostic);
+    stop();
+}
+
+/* Expressions */
+
+// Value and CallExpression take their child's type, which is already on the
+// stack; they only need an entry of their own in the table
+void Checker::visit(Value &node) {
+    if (phase() == WalkPhase::LEAVE && table) {
+        table->record(node, types.back());
+    }
+}
+
+void Checker::visit(CallExpression &node) {
+    if (phase() == WalkPhase::LEAVE && table) {
+        table->record(node, types.back());
+    }
+}
+
+// Number
+void Checker::visit(Number &node) {
+    if (phase() == WalkPhase::LEAVE) {
+        push(node, INT_TYPE.get());
+    }
+}
+
+// Nil
+void Checker::visit(Nil &node) {
+    if (phase() == WalkPhase::LEAVE) {
+        push(node, NIL_TYPE.get());
+    }
+}
+
+// Select
+void Checker::visit(Select &node) {
+    if (phase() == WalkPhase::CHILD && childIndex() == 0) {
+        const Type *guardType = popType();
+
+        if (guardType->getTypeKind() != TypeKind::INT) {
+            return fail({.rule = Rule::SELECT_GUARD_NOT_INT, .node = &node, .types = {guardType}});
+        }
+    } else if (phase() == WalkPhase::LEAVE) {
+        const Type *ffCaseType = popType();
+        const Type *ttCaseType = popType();
+
+        if (!typesEqual(ttCaseType, ffCaseType)) {
+            return fail({.rule = Rule::SELECT_BRANCHES_INCOMPATIBLE, .node = &node, .types = {ttCaseType, ffCaseType}});
+        }
+
+        push(node, ttCaseType->getTypeKind() == TypeKind::NIL ? ffCaseType : ttCaseType);
+    }
+}
+
+// UnaryOperation
+void Checker::visit(UnaryOperation &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    const Type *operandType = popType();
+
+    if (operandType->getTypeKind() != TypeKind::INT) {
+        return fail({.rule = Rule::UNARY_OPERAND_NOT_INT, .node = &node, .types = {operandType}});
+    }
+
+    push(node, INT_TYPE.get());
+}
+
+// BinaryOperation
+void Checker::visit(BinaryOperation &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    const Type *rhsType = popType();
+    const Type *lhsType = popType();
+
+    if (node.operand == BinaryOperand::EQ || node.operand == BinaryOperand::NOT_EQ) {
+        if (!typesEqual(lhsType, rhsType)) {
+            return fail({.rule = Rule::BINARY_OPERANDS_INCOMPATIBLE, .node = &node, .types = {lhsType, rhsType}});
+        }
+
+        if (lhsType->getTypeKind() == TypeKind::STRUCT || lhsType->getTypeKind() == TypeKind::FUNCTION) {
+            return fail({.rule = Rule::BINARY_OPERAND_INVALID, .node = &node, .types = {lhsType}});
+        }
+
+        if (rhsType->getTypeKind() == TypeKind::STRUCT || rhsType->getTypeKind() == TypeKind::FUNCTION) {
+            return fail({.rule = Rule::BINARY_OPERAND_INVALID, .node = &node, .types = {rhsType}});
+        }
+    } else {
+        if (!typesEqual(lhsType, INT_TYPE.get())) {
+            return fail({.rule = Rule::BINARY_LEFT_NOT_INT, .node = &node, .types = {lhsType}});
+        }
+
+        if (!typesEqual(rhsType, INT_TYPE.get())) {
+            return fail({.rule = Rule::BINARY_RIGHT_NOT_INT, .node = &node, .types = {rhsType}});
+        }
+    }
+
+    push(node, INT_TYPE.get());
+}
+
+// NewSingleton
+void Checker::visit(NewSingleton &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    if (node.type->getTypeKind() == TypeKind::NIL || node.type->getTypeKind() == TypeKind::FUNCTION) {
+        return fail({.rule = Rule::NEW_SINGLE_INVALID_TYPE, .node = &node});
+    }
+
+    push(node, TypeContext::global().pointerType(node.type).get());
+}
+
+// NewArray
+void Checker::visit(NewArray &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    const Type *sizeType = popType();
+
+    if (!typesEqual(sizeType, INT_TYPE.get())) {
+        return fail({.rule = Rule::NEW_ARRAY_SIZE_NOT_INT, .node = &node, .types = {sizeType}});
+    }
+
+    if (node.type->getTypeKind() == TypeKind::NIL || node.type->getTypeKind() == TypeKind::FUNCTION || node.type->getTypeKind() == TypeKind::STRUCT) {
+        return fail({.rule = Rule::NEW_ARRAY_INVALID_TYPE, .node = &node});
+    }
+
+    push(node, TypeContext::global().arrayType(node.type).get());
+}
+
+/* Places */
+
+// Identifier
+void Checker::visit(Identifier &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    if (const std::shared_ptr<Type> *type = gamma.lookup(node.symbol)) {
+        push(node, type->get());
+    } else {
+        fail({.rule = Rule::UNKNOWN_ID, .node = &node});
+    }
+}
+
+// Dereference
+void Checker::visit(Dereference &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    const Type *pointeeType = popType();
+
+    if (pointeeType->getTypeKind() == TypeKind::POINTER) {
+        push(node, static_cast<const PointerType*>(pointeeType)->pointeeType.get());
+        return;
+    }
+
+    fail({.rule = Rule::DEREFERENCE_NOT_POINTER, .node = &node, .types = {pointeeType}});
+}
+
+// ArrayAccess
+void Checker::visit(ArrayAccess &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    const Type *indexType = popType();
+    const Type *arrayType = popType();
+
+    if (!typesEqual(indexType, INT_TYPE.get())) {
+        return fail({.rule = Rule::ARRAY_INDEX_NOT_INT, .node = &node, .types = {indexType}});
+    }
+
+    if (arrayType->getTypeKind() == TypeKind::ARRAY) {
+        push(node, static_cast<const ArrayType*>(arrayType)->elementType.get());
+        return;
+    }
+
+    fail({.rule = Rule::ARRAY_ACCESS_NOT_ARRAY, .node = &node, .types = {arrayType}});
+}
+
+// FieldAccess
+void Checker::visit(FieldAccess &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    const Type *baseType = popType();
+
+    const StructType *structPtrType = nullptr;
+
+    if (baseType->getTypeKind() == TypeKind::POINTER) {
+        const Type *pointeeType = static_cast<const PointerType*>(baseType)->pointeeType.get();
+
+        if (pointeeType->getTypeKind() == TypeKind::STRUCT) {
+            structPtrType = static_cast<const StructType*>(pointeeType);
+        }
+    }
+
+    if (!structPtrType) {
+        return fail({.rule = Rule::FIELD_ACCESS_NOT_STRUCT_POINTER, .node = &node, .types = {baseType}});
+    }
+
+    const StructTable::Layout *layout = delta.find(structPtrType->symbol);
+
+    if (!layout) {
+        return fail({.rule = Rule::FIELD_ACCESS_UNKNOWN_STRUCT, .node = &node, .types = {structPtrType}});
+    }
+
+    ptrdiff_t fieldIndex = delta.fieldIndex(*layout, node.fieldSymbol);
+
+    if (fieldIndex < 0) {
+        return fail({.rule = Rule::FIELD_ACCESS_UNKNOWN_FIELD, .node = &node, .types = {structPtrType}});
+    }
+
+    push(node, delta.fieldType(*layout, fieldIndex).get());
+}
+
+/* Function call */
+
+// The callee's type stays on the stack while the arguments are walked, and
+// each argument is compared against its parameter as soon as it is typed
+void Checker::visit(FunctionCall &node) {
+    if (phase() == WalkPhase::ENTER) {
+        // A callee names a function directly as Val(Id(name))
+        if (node.callee->kind == NodeKind::VALUE) {
+            const Place *place = static_cast<const Value*>(node.callee.get())->place.get();
+
+            if (place->kind == NodeKind::IDENTIFIER && static_cast<const Identifier*>(place)->name == "main") {
+                return fail({.rule = Rule::CALL_TO_MAIN, .node = &node});
+            }
+        }
+    } else if (phase() == WalkPhase::CHILD && childIndex() == 0) {
+        const Type *calleeType = types.back();
+        const FunctionType *functionType = calleeFunctionType(calleeType);
+
+        if (!functionType) {
+            return fail({.rule = Rule::CALL_NOT_FUNCTION, .node = &node, .types = {calleeType}});
+        }
+
+        if (node.args.size() != functionType->paramTypes.size()) {
+            return fail({.rule = Rule::CALL_ARGUMENT_COUNT, .node = &node, .types = {functionType}});
+        }
+    } else if (phase() == WalkPhase::CHILD) {
+        size_t i = childIndex() - 1;
+        const Type *argType = popType();
+        const FunctionType *functionType = calleeFunctionType(types.back());
+        const auto& paramType = functionType->paramTypes[i];
+
+        if (!typesEqual(argType, paramType.get())) {
+            return fail({.rule = Rule::CALL_ARGUMENT_TYPE, .node = &node, .detail = node.args[i].get(), .types = {argType, paramType.get()}});
+        }
+    } else {
+        const FunctionType *functionType = calleeFunctionType(popType());
+        push(node, functionType->returnType.get());
+    }
+}
+
+/* Statements */
+
+// Statements
+void Checker::visit(Statements &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    bool doesReturn = false;
+
+    for (size_t i = 0; i < node.statements.size(); i++) {
+        doesReturn = popReturns() || doesReturn;
+    }
+
+    returns.push_back(doesReturn);
+}
+
+// Assignment
+void Checker::visit(Assignment &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    const Type *rhsType = popType();
+    const Type *lhsType = popType();
+
+    if (!isStorableKind(lhsType->getTypeKind())) {
+        return fail({.rule = Rule::ASSIGN_INVALID_LHS, .node = &node, .types = {lhsType}});
+    }
+
+    if (!typesEqual(lhsType, rhsType)) {
+        return fail({.rule = Rule::ASSIGN_INCOMPATIBLE, .node = &node, .types = {lhsType, rhsType}});
+    }
+
+    returns.push_back(false);
+}
+
+// CallStatement
+void Checker::visit(CallStatement &) {
+    if (phase() == WalkPhase::LEAVE) {
+        popType();
+        returns.push_back(false);
+    }
+}
+
+// If
+void Checker::visit(If &node) {
+    if (phase() == WalkPhase::CHILD && childIndex() == 0) {
+        const Type *guardType = popType();
+
+        if (!typesEqual(guardType, INT_TYPE.get())) {
+            return fail({.rule = Rule::IF_GUARD_NOT_INT, .node = &node, .types = {guardType}});
+        }
+    } else if (phase() == WalkPhase::LEAVE) {
+        bool unhappyPathReturns = node.unhappyPath.has_value() ? popReturns() : false;
+        bool happyPathReturns = popReturns();
+        returns.push_back(happyPathReturns && unhappyPathReturns);
+    }
+}
+
+// While
+void Checker::visit(While &node) {
+    if (phase() == WalkPhase::CHILD && childIndex() == 0) {
+        const Type *guardType = popType();
+
+        if (!typesEqual(guardType, INT_TYPE.get())) {
+            return fail({.rule = Rule::WHILE_GUARD_NOT_INT, .node = &node, .types = {guardType}});
+        }
+
+        loopDepth++;
+    } else if (phase() == WalkPhase::LEAVE) {
+        loopDepth--;
+        popReturns();
+        returns.push_back(false);
+    }
+}
+
+// Break
+void Checker::visit(Break &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    if (loopDepth == 0) {
+        return fail({.rule = Rule::BREAK_OUTSIDE_LOOP, .node = &node});
+    }
+
+    returns.push_back(false);
+}
+
+// Continue
+void Checker::visit(Continue &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    if (loopDepth == 0) {
+        return fail({.rule = Rule::CONTINUE_OUTSIDE_LOOP, .node = &node});
+    }
+
+    returns.push_back(false);
+}
+
+// Return
+void Checker::visit(Return &node) {
+    if (phase() != WalkPhase::LEAVE) {
+        return;
+    }
+
+    if (node.expression.has_value()) {
+        const Type *expressionType = popType();
+
+        if (!typesEqual(expressionType, returnType)) {
+            return fail({.rule = Rule::RETURN_TYPE_MISMATCH, .node = &node, .types = {expressionType, returnType}});
+        }
+    } else {
+        if (!typesEqual(returnType, INT_TYPE.get())) {
+            return fail({.rule = Rule::RETURN_MISSING_EXPRESSION, .node = &node, .types = {returnType}});
+        }
+
+        return fail({.rule = Rule::RETURN_WITHOUT_EXPRESSION, .node = &node});
+    }
+
+    returns.push_back(true);
+}
@@ -0,0 +1,93 @@
+#ifndef CHECKER_HPP
+#define CHECKER_HPP
+
+#include <optional>
+#include <vector>
+
+#include "annotate.hpp"
+#include "ast.hpp"
+#include "cancel.hpp"
+#include "diagnostic.hpp"
+#include "traversal.hpp"
+
+// The function type a call goes through: the callee itself or the function it
+// points to, or nullptr when the callee is not callable
+extern const FunctionType *calleeFunctionType(const Type *calleeType);
+
+// The typing rules for expressions, places and statements, run by a Walker
+// rather than by recursive check() calls. Each rule consumes its children's
+// results from the type and return stacks and pushes its own, so premises are
+// tested in the same order, and fail with the same messages, as a recursive
+// checker would. A failed premise stops the walk and is kept as a Diagnostic
+// rather than thrown. With a TypeTable, every type derived is also recorded
+// against its node. With a CancelToken, the walk stops early, failing with
+// Rule::CANCELLED, once the token is cancelled.
+class Checker : public Walker {
+public:
+    Checker(const Scope &gamma, const Delta &delta, TypeTable *table = nullptr, CancelToken cancel = {});
+
+    // Type of an Expression, Place or FunctionCall, borrowed from TypeContext,
+    // or nullptr once a rule has failed
+    const Type *checkExpression(const Node &expression);
+
+    // Whether the statement is guaranteed to execute a return; false once a rule has failed
+    bool checkStatement(const Statement &statement, const Type *returnType, bool inLoop);
+
+    // The rule that failed in the last check, if any
+    const std::optional<Diagnostic> &failure() const;
+
+    /* Expressions */
+    void visit(Value &node) override;
+    void visit(Number &node) override;
+    void visit(Nil &node) override;
+    void visit(Select &node) override;
+    void visit(UnaryOperation &node) override;
+    void visit(BinaryOperation &node) override;
+    void visit(NewSingleton &node) override;
+    void visit(NewArray &node) override;
+    void visit(CallExpression &node) override;
+
+    /* Places */
+    void visit(Identifier &node) override;
+    void visit(Dereference &node) override;
+    void visit(ArrayAccess &node) override;
+    void visit(FieldAccess &node) override;
+
+    /* Function call */
+    void visit(FunctionCall &node) override;
+
+    /* Statements */
+    void visit(Statements &node) override;
+    void visit(Assignment &node) override;
+    void visit(CallStatement &node) override;
+    void visit(If &node) override;
+    void visit(While &node) override;
+    void visit(Break &node) override;
+    void visit(Continue &node) override;
+    void visit(Return &node) override;
+
+private:
+    const Type *popType();
+    bool popReturns();
+    void push(const Node &node, const Type *type);
+    void fail(Diagnostic diagnostic);
+
+    const Scope &gamma;
+    const Delta &delta;
+    TypeTable *table;
+    CancelToken cancel;
+    // Counts types pushed, so the token is only polled every so often
+    unsigned pushes = 0;
+
+    const Type *returnType = nullptr;
+    unsigned loopDepth = 0;
+
+    // Results are borrowed: every type is owned by TypeContext for the life of
+    // the process, so no reference counts change while checking
+    std::vector<const Type *> types;
+    std::vector<bool> returns;
+
+    std::optional<Diagnostic> diagnostic;
+};
+
+#endif
@@ -0,0 +1,271 @@
+#include <format>
+#include <iterator>
+
+#include "diagnostic.hpp"
+#include "ast.hpp"
+
+template <typename T>
+static const T &as(const Node *node) {
+    return *static_cast<const T*>(node);
+}
+
+// The pieces a message is written from: text, types in their pretty form and
+// nodes in their debug form, all appended to the one buffer
+static void append(std::string &out, std::string_view text) {
+    out += text;
+}
+
+static void append(std::string &out, size_t number) {
+    std::format_to(std::back_inserter(out), "{}", number);
+}
+
+static void append(std::string &out, const Type *type) {
+    type->renderPretty(out);
+}
+
+static void append(std::string &out, const Node *node) {
+    node->render(out);
+}
+
+template <typename T>
+static void append(std::string &out, const NodePtr<T> &node) {
+    node->render(out);
+}
+
+template <typename... Parts>
+static void write(std::string &out, const Parts &...parts) {
+    (append(out, parts), ...);
+}
+
+void render(const Diagnostic &diagnostic, std::string &out) {
+    const Node *node = diagnostic.node;
+    const Type *first = diagnostic.types[0];
+    const Type *second = diagnostic.types[1];
+
+    if (diagnostic.cachedMessage) {
+        write(out, *diagnostic.cachedMessage);
+        return;
+    }
+
+    switch (diagnostic.rule) {
+        /* Expressions */
+        case Rule::SELECT_GUARD_NOT_INT:
+            write(out, "non-int type ", first, " for select guard '", as<Select>(node).guard, "'");
+            return;
+        case Rule::SELECT_BRANCHES_INCOMPATIBLE:
+            write(out, "incompatible types ", first, " vs ", second, " in select branches '", as<Select>(node).ttCase, "' vs '", as<Select>(node).ffCase, "'");
+            return;
+        case Rule::UNARY_OPERAND_NOT_INT:
+            write(out, "non-int operand type ", first, " in unary op '", node, "'");
+            return;
+        case Rule::BINARY_OPERANDS_INCOMPATIBLE:
+            write(out, "incompatible types ", first, " vs ", second, " in binary op '", node, "'");
+            return;
+        case Rule::BINARY_OPERAND_INVALID:
+            write(out, "invalid type ", first, " used in binary op '", node, "'");
+            return;
+        case Rule::BINARY_LEFT_NOT_INT:
+            write(out, "non-int type ", first, " for left operand of binary op '", node, "'");
+            return;
+        case Rule::BINARY_RIGHT_NOT_INT:
+            write(out, "non-int type ", first, " for right operand of binary op '", node, "'");
+            return;
+        case Rule::NEW_SINGLE_INVALID_TYPE:
+            write(out, "invalid type used for allocation '", node, "'");
+            return;
+        case Rule::NEW_ARRAY_SIZE_NOT_INT:
+            write(out, "non-int type ", first, " used for second argument of allocation '", node, "'");
+            return;
+        case Rule::NEW_ARRAY_INVALID_TYPE:
+            write(out, "invalid type used for first argument of allocation '", node, "'");
+            return;
+
+        /* Places */
+        case Rule::UNKNOWN_ID:
+            write(out, "id ", as<Identifier>(node).name, " does not exist in this scope");
+            return;
+        case Rule::DEREFERENCE_NOT_POINTER:
+            write(out, "non-pointer type ", first, " for dereference 'Val(", node, ")'");
+            return;
+        case Rule::ARRAY_INDEX_NOT_INT:
+            write(out, "non-int index type ", first, " for array access '", node, "'");
+            return;
+        case Rule::ARRAY_ACCESS_NOT_ARRAY:
+            write(out, "non-array type ", first, " for array access '", node, "'");
+            return;
+        case Rule::FIELD_ACCESS_NOT_STRUCT_POINTER:
+            write(out, first, " is not a struct pointer type in field access '", node, "'");
+            return;
+        case Rule::FIELD_ACCESS_UNKNOWN_STRUCT:
+            write(out, "non-existent struct type ", first, " in field access '", node, "'");
+            return;
+        case Rule::FIELD_ACCESS_UNKNOWN_FIELD:
+            write(out, "non-existent field ", first, "::", as<FieldAccess>(node).field, " in field access '", node, "'");
+            return;
+
+        /* Function call */
+        case Rule::CALL_TO_MAIN:
+            write(out, "trying to call 'main'");
+            return;
+        case Rule::CALL_NOT_FUNCTION:
+            write(out, "trying to call type ", first, " as function pointer in call '", node, "'");
+            return;
+        case Rule::CALL_ARGUMENT_COUNT:
+            write(out, "incorrect number of arguments (", as<FunctionCall>(node).args.size(), " vs ",
+                  static_cast<const FunctionType*>(first)->paramTypes.size(), ") in call '", node, "'");
+            return;
+        case Rule::CALL_ARGUMENT_TYPE:
+            write(out, "incompatible argument type ", first, " vs parameter type ", second,
+                  " for argument '", diagnostic.detail, "' in call '", node, "'");
+            return;
+
+        /* Statements */
+        case Rule::ASSIGN_INVALID_LHS:
+            write(out, "invalid type ", first, " for left-hand side of assignment '", node, "'");
+            return;
+        case Rule::ASSIGN_INCOMPATIBLE:
+            write(out, "incompatible types ", first, " vs ", second, " for assignment '", node, "'");
+            return;
+        case Rule::IF_GUARD_NOT_INT:
+            write(out, "non-int type ", first, " for if guard '", as<If>(node).guard, "'");
+            return;
+        case Rule::WHILE_GUARD_NOT_INT:
+            write(out, "non-int type ", first, " for while guard '", as<While>(node).guard, "'");
+            return;
+        case Rule::BREAK_OUTSIDE_LOOP:
+            write(out, "break outside loop");
+            return;
+        case Rule::CONTINUE_OUTSIDE_LOOP:
+            write(out, "continue outside loop");
+            return;
+        case Rule::RETURN_TYPE_MISMATCH:
+            write(out, "incompatible return type ", first, " for 'return ", *as<Return>(node).expression, "', should be ", second);
+            return;
+        case Rule::RETURN_MISSING_EXPRESSION:
+            write(out, "missing return expression for non-int function type ", first);
+            return;
+        case Rule::RETURN_WITHOUT_EXPRESSION:
+            write(out, "return statement requires an expression in this function");
+            return;
+
+        /* Structs and functions */
+        case Rule::EMPTY_STRUCT:
+            write(out, "empty struct ", as<StructDefinition>(node).name);
+            return;
+        case Rule::FIELD_INVALID_TYPE: {
+            const Declaration &field = as<Declaration>(diagnostic.detail);
+            write(out, "invalid type ", field.type.get(), " for struct field ", as<StructDefinition>(node).name, "::", field.name);
+            return;
+        }
+        case Rule::DUPLICATE_FIELD:
+            write(out, "Duplicate field name '", as<Declaration>(diagnostic.detail).name, "' in struct '", as<StructDefinition>(node).name, "'");
+            return;
+        case Rule::VARIABLE_INVALID_TYPE: {
+            const Declaration &variable = as<Declaration>(diagnostic.detail);
+            write(out, "invalid type ", variable.type.get(), " for variable ", variable.name, " in function ", as<FunctionDefinition>(node).name);
+            return;
+        }
+        case Rule::DUPLICATE_VARIABLE:
+            write(out, "Duplicate parameter/local name '", as<Declaration>(diagnostic.detail).name, "' in function '", as<FunctionDefinition>(node).name, "'");
+            return;
+        case Rule::EMPTY_BODY:
+            write(out, "function ", as<FunctionDefinition>(node).name, " has an empty body");
+            return;
+        case Rule::BODY_NOT_STATEMENTS:
+            write(out, "function ", as<FunctionDefinition>(node).name, " has an invalid body structure (expected Stmts)");
+            return;
+        case Rule::MISSING_RETURN:
+            write(out, "function ", as<FunctionDefinition>(node).name, " may not execute a return");
+            return;
+
+        /* Program */
+        case Rule::DUPLICATE_NAME:
+            write(out, "Duplicate name: ", diagnostic.name);
+            return;
+        case Rule::NO_MAIN:
+            write(out, "no 'main' function with type '() -> int' exists");
+            return;
+
+        case Rule::CANCELLED:
+            write(out, "check cancelled");
+            return;
+    }
+
+    write(out, "unknown error");
+}
+
+std::string render(const Diagnostic &diagnostic) {
+    std::string out;
+    render(diagnostic, out);
+    return out;
+}
+
+std::string_view ruleName(Rule rule) {
+    switch (rule) {
+        /* Expressions */
+        case Rule::SELECT_GUARD_NOT_INT: return "select-guard-not-int";
+        case Rule::SELECT_BRANCHES_INCOMPATIBLE: return "select-branches-incompatible";
+        case Rule::UNARY_OPERAND_NOT_INT: return "unary-operand-not-int";
+        case Rule::BINARY_OPERANDS_INCOMPATIBLE: return "binary-operands-incompatible";
+        case Rule::BINARY_OPERAND_INVALID: return "binary-operand-invalid";
+        case Rule::BINARY_LEFT_NOT_INT: return "binary-left-not-int";
+        case Rule::BINARY_RIGHT_NOT_INT: return "binary-right-not-int";
+        case Rule::NEW_SINGLE_INVALID_TYPE: return "new-single-invalid-type";
+        case Rule::NEW_ARRAY_SIZE_NOT_INT: return "new-array-size-not-int";
+        case Rule::NEW_ARRAY_INVALID_TYPE: return "new-array-invalid-type";
+
+        /* Places */
+        case Rule::UNKNOWN_ID: return "unknown-id";
+        case Rule::DEREFERENCE_NOT_POINTER: return "dereference-not-pointer";
+        case Rule::ARRAY_INDEX_NOT_INT: return "array-index-not-int";
+        case Rule::ARRAY_ACCESS_NOT_ARRAY: return "array-access-not-array";
+        case Rule::FIELD_ACCESS_NOT_STRUCT_POINTER: return "field-access-not-struct-pointer";
+        case Rule::FIELD_ACCESS_UNKNOWN_STRUCT: return "field-access-unknown-struct";
+        case Rule::FIELD_ACCESS_UNKNOWN_FIELD: return "field-access-unknown-field";
+
+        /* Function call */
+        case Rule::CALL_TO_MAIN: return "call-to-main";
+        case Rule::CALL_NOT_FUNCTION: return "call-not-function";
+        case Rule::CALL_ARGUMENT_COUNT: return "call-argument-count";
+        case Rule::CALL_ARGUMENT_TYPE: return "call-argument-type";
+
+        /* Statements */
+        case Rule::ASSIGN_INVALID_LHS: return "assign-invalid-lhs";
+        case Rule::ASSIGN_INCOMPATIBLE: return "assign-incompatible";
+        case Rule::IF_GUARD_NOT_INT: return "if-guard-not-int";
+        case Rule::WHILE_GUARD_NOT_INT: return "while-guard-not-int";
+        case Rule::BREAK_OUTSIDE_LOOP: return "break-outside-loop";
+        case Rule::CONTINUE_OUTSIDE_LOOP: return "continue-outside-loop";
+        case Rule::RETURN_TYPE_MISMATCH: return "return-type-mismatch";
+        case Rule::RETURN_MISSING_EXPRESSION: return "return-missing-expression";
+        case Rule::RETURN_WITHOUT_EXPRESSION: return "return-without-expression";
+
+        /* Structs and functions */
+        case Rule::EMPTY_STRUCT: return "empty-struct";
+        case Rule::FIELD_INVALID_TYPE: return "field-invalid-type";
+        case Rule::DUPLICATE_FIELD: return "duplicate-field";
+        case Rule::VARIABLE_INVALID_TYPE: return "variable-invalid-type";
+        case Rule::DUPLICATE_VARIABLE: return "duplicate-variable";
+        case Rule::EMPTY_BODY: return "empty-body";
+        case Rule::BODY_NOT_STATEMENTS: return "body-not-statements";
+        case Rule::MISSING_RETURN: return "missing-return";
+
+        /* Program */
+        case Rule::DUPLICATE_NAME: return "duplicate-name";
+        case Rule::NO_MAIN: return "no-main";
+
+        case Rule::CANCELLED: return "cancelled";
+    }
+
+    return "unknown";
+}
+
+std::optional<Rule> ruleFromName(std::string_view name) {
+    for (int i = 0; i <= static_cast<int>(Rule::CANCELLED); i++) {
+        if (ruleName(static_cast<Rule>(i)) == name) {
+            return static_cast<Rule>(i);
+        }
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,100 @@
+#ifndef DIAGNOSTIC_HPP
+#define DIAGNOSTIC_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+struct Node;
+struct Type;
+
+// Every way a program can fail to type check, one per error message
+enum class Rule : uint8_t {
+    /* Expressions */
+    SELECT_GUARD_NOT_INT,
+    SELECT_BRANCHES_INCOMPATIBLE,
+    UNARY_OPERAND_NOT_INT,
+    BINARY_OPERANDS_INCOMPATIBLE,
+    BINARY_OPERAND_INVALID,
+    BINARY_LEFT_NOT_INT,
+    BINARY_RIGHT_NOT_INT,
+    NEW_SINGLE_INVALID_TYPE,
+    NEW_ARRAY_SIZE_NOT_INT,
+    NEW_ARRAY_INVALID_TYPE,
+
+    /* Places */
+    UNKNOWN_ID,
+    DEREFERENCE_NOT_POINTER,
+    ARRAY_INDEX_NOT_INT,
+    ARRAY_ACCESS_NOT_ARRAY,
+    FIELD_ACCESS_NOT_STRUCT_POINTER,
+    FIELD_ACCESS_UNKNOWN_STRUCT,
+    FIELD_ACCESS_UNKNOWN_FIELD,
+
+    /* Function call */
+    CALL_TO_MAIN,
+    CALL_NOT_FUNCTION,
+    CALL_ARGUMENT_COUNT,
+    CALL_ARGUMENT_TYPE,
+
+    /* Statements */
+    ASSIGN_INVALID_LHS,
+    ASSIGN_INCOMPATIBLE,
+    IF_GUARD_NOT_INT,
+    WHILE_GUARD_NOT_INT,
+    BREAK_OUTSIDE_LOOP,
+    CONTINUE_OUTSIDE_LOOP,
+    RETURN_TYPE_MISMATCH,
+    RETURN_MISSING_EXPRESSION,
+    RETURN_WITHOUT_EXPRESSION,
+
+    /* Structs and functions */
+    EMPTY_STRUCT,
+    FIELD_INVALID_TYPE,
+    DUPLICATE_FIELD,
+    VARIABLE_INVALID_TYPE,
+    DUPLICATE_VARIABLE,
+    EMPTY_BODY,
+    BODY_NOT_STATEMENTS,
+    MISSING_RETURN,
+
+    /* Program */
+    DUPLICATE_NAME,
+    NO_MAIN,
+
+    // A check abandoned because an earlier item already failed (cancel.hpp).
+    // The earlier failure is the one reported, so this never reaches the output.
+    CANCELLED,
+};
+
+// A failed premise, recorded where it failed and passed back up by value. It
+// only refers to the nodes and types involved; the message is rendered from
+// them once, by render(), when someone needs the text. Nodes and names borrow
+// from the Program, so render before the Program goes away.
+struct Diagnostic {
+    Rule rule;
+    // The node the rule is about: the expression's or statement's own node, or
+    // the StructDefinition or FunctionDefinition for the rules on those
+    const Node *node = nullptr;
+    // A second node the message quotes: an argument, a field, a variable
+    const Node *detail = nullptr;
+    const Type *types[2] = {};
+    // The top-level name in DUPLICATE_NAME
+    std::string_view name = {};
+    // For a verdict replayed from the cache, which keeps the failed rule and
+    // its message but not the nodes: the message, rendered as is
+    std::optional<std::string> cachedMessage = std::nullopt;
+};
+
+// The exact text of the std::runtime_error the throwing checks raise for it,
+// either appended to out or in a fresh string
+extern void render(const Diagnostic &diagnostic, std::string &out);
+extern std::string render(const Diagnostic &diagnostic);
+
+// A stable name for the rule, such as "unknown-id", for tools to match on
+extern std::string_view ruleName(Rule rule);
+// The rule with that name, if there is one
+extern std::optional<Rule> ruleFromName(std::string_view name);
+
+#endif
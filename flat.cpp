@@ -0,0 +1,564 @@
+#include "flat.hpp"
+#include "checker.hpp"
+#include "traversal.hpp"
+
+namespace {
+
+// Emits a function body's ops by walking its tree once, in the same order of
+// ENTER, CHILD and LEAVE events the Checker sees. slots mirrors the Checker's
+// type stack, holding the op whose result stands for each walked child.
+class Flattener : public Walker {
+public:
+    explicit Flattener(FlatFunction &out) : out(out) {}
+
+    /* Expressions */
+
+    void visit(Number &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(emit(FlatOp::NUMBER, node, 0, 0));
+        }
+    }
+
+    void visit(Nil &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(emit(FlatOp::NIL, node, 0, 0));
+        }
+    }
+
+    void visit(Select &node) override {
+        if (phase() == WalkPhase::CHILD && childIndex() == 0) {
+            emit(FlatOp::SELECT_GUARD, node, 0, 1);
+        } else if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::SELECT, node, 0, 2, 3);
+        }
+    }
+
+    void visit(UnaryOperation &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::UNARY_OPERATION, node, 0, 1, 1);
+        }
+    }
+
+    void visit(BinaryOperation &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::BINARY_OPERATION, node, static_cast<uint32_t>(node.operand), 2, 2);
+        }
+    }
+
+    void visit(NewSingleton &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            uint32_t pair = allocation(node.type, TypeContext::global().pointerType(node.type));
+            push(emit(FlatOp::NEW_SINGLETON, node, pair, 0));
+        }
+    }
+
+    void visit(NewArray &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            uint32_t pair = allocation(node.type, TypeContext::global().arrayType(node.type));
+            leave(FlatOp::NEW_ARRAY, node, pair, 1, 1);
+        }
+    }
+
+    /* Places */
+
+    void visit(Identifier &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(emit(FlatOp::IDENTIFIER, node, node.symbol, 0));
+        }
+    }
+
+    void visit(Dereference &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::DEREFERENCE, node, 0, 1, 1);
+        }
+    }
+
+    void visit(ArrayAccess &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::ARRAY_ACCESS, node, 0, 2, 2);
+        }
+    }
+
+    void visit(FieldAccess &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::FIELD_ACCESS, node, node.fieldSymbol, 1, 1);
+        }
+    }
+
+    /* Function call */
+
+    // The callee's slot is replaced by its CALL_CALLEE op, which holds the
+    // function type that every CALL_ARGUMENT and the CALL itself read
+    void visit(FunctionCall &node) override {
+        if (phase() == WalkPhase::ENTER) {
+            if (node.callee->kind == NodeKind::VALUE) {
+                const Place *place = static_cast<const Value*>(node.callee.get())->place.get();
+
+                if (place->kind == NodeKind::IDENTIFIER && static_cast<const Identifier*>(place)->name == "main") {
+                    emit(FlatOp::CALL_TO_MAIN, node, 0, 0);
+                }
+            }
+        } else if (phase() == WalkPhase::CHILD && childIndex() == 0) {
+            slots.back() = emit(FlatOp::CALL_CALLEE, node, static_cast<uint32_t>(node.args.size()), 1);
+        } else if (phase() == WalkPhase::CHILD) {
+            uint32_t argIndex = static_cast<uint32_t>(childIndex() - 1);
+            uint32_t operands[] = {slots[slots.size() - 2 - argIndex], slots.back()};
+            emit(FlatOp::CALL_ARGUMENT, node, argIndex, operands, 2);
+        } else {
+            uint32_t callee = slots[slots.size() - 1 - node.args.size()];
+            slots.resize(slots.size() - 1 - node.args.size());
+            push(emit(FlatOp::CALL, node, 0, &callee, 1));
+        }
+    }
+
+    /* Statements */
+
+    void visit(Statements &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::STATEMENTS, node, 0, node.statements.size(), node.statements.size());
+        }
+    }
+
+    void visit(Assignment &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::ASSIGNMENT, node, 0, 2, 2);
+        }
+    }
+
+    void visit(CallStatement &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::CALL_STATEMENT, node, 0, 1, 1);
+        }
+    }
+
+    void visit(If &node) override {
+        if (phase() == WalkPhase::CHILD && childIndex() == 0) {
+            emit(FlatOp::IF_GUARD, node, 0, 1);
+        } else if (phase() == WalkPhase::LEAVE) {
+            size_t paths = node.unhappyPath ? 2 : 1;
+            leave(FlatOp::IF, node, 0, paths, paths + 1);
+        }
+    }
+
+    void visit(While &node) override {
+        if (phase() == WalkPhase::CHILD && childIndex() == 0) {
+            emit(FlatOp::WHILE_GUARD, node, 0, 1);
+        } else if (phase() == WalkPhase::LEAVE) {
+            leave(FlatOp::WHILE, node, 0, 1, 2);
+        }
+    }
+
+    void visit(Break &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(emit(FlatOp::BREAK, node, 0, 0));
+        }
+    }
+
+    void visit(Continue &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(emit(FlatOp::CONTINUE, node, 0, 0));
+        }
+    }
+
+    void visit(Return &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            size_t operands = node.expression ? 1 : 0;
+            leave(FlatOp::RETURN, node, 0, operands, operands);
+        }
+    }
+
+private:
+    void push(uint32_t slot) {
+        slots.push_back(slot);
+    }
+
+    uint32_t emit(FlatOp op, const Node &source, uint32_t payload, const uint32_t *operands, size_t count) {
+        uint32_t index = static_cast<uint32_t>(out.ops.size());
+        out.ops.push_back(op);
+        out.payloads.push_back(payload);
+        out.sources.push_back(&source);
+        out.children.insert(out.children.end(), operands, operands + count);
+        out.childStart.push_back(static_cast<uint32_t>(out.children.size()));
+        return index;
+    }
+
+    // Operands are the last count slots
+    uint32_t emit(FlatOp op, const Node &source, uint32_t payload, size_t count) {
+        return emit(op, source, payload, slots.data() + slots.size() - count, count);
+    }
+
+    // The LEAVE of a node with walked children: its operands are the last
+    // count of them, and all of them are popped before its own slot is pushed
+    void leave(FlatOp op, const Node &source, uint32_t payload, size_t count, size_t walked) {
+        uint32_t index = emit(op, source, payload, count);
+        slots.resize(slots.size() - walked);
+        push(index);
+    }
+
+    uint32_t allocation(const std::shared_ptr<Type> &declared, const std::shared_ptr<Type> &allocated) {
+        uint32_t pair = static_cast<uint32_t>(out.allocationTypes.size());
+        out.allocationTypes.push_back(declared.get());
+        out.allocationTypes.push_back(allocated.get());
+        return pair;
+    }
+
+    FlatFunction &out;
+    std::vector<uint32_t> slots;
+};
+
+} // namespace
+
+FlatFunction flattenFunction(const FunctionDefinition &function) {
+    FlatFunction flat;
+    flat.childStart.push_back(0);
+
+    // The walk only reads the tree; Visitor takes nodes by non-const reference
+    Flattener(flat).walk(const_cast<Statement &>(*function.body));
+    return flat;
+}
+
+/* FlatChecker */
+
+FlatChecker::FlatChecker(const Scope &gamma, const Delta &delta, CancelToken cancel) : gamma(gamma), delta(delta), cancel(cancel) {}
+
+const std::optional<Diagnostic> &FlatChecker::failure() const {
+    return diagnostic;
+}
+
+bool FlatChecker::fail(Diagnostic diagnostic) {
+    this->diagnostic = std::move(diagnostic);
+    return false;
+}
+
+// Mirrors Checker's visit() overloads rule for rule; see checker.cpp
+bool FlatChecker::checkBody(const FlatFunction &function, const Type *returnType) {
+    const size_t count = function.ops.size();
+    unsigned loopDepth = 0;
+
+    diagnostic.reset();
+    types.resize(count);
+    returns.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t *operands = function.children.data() + function.childStart[i];
+        const size_t operandCount = function.childStart[i + 1] - function.childStart[i];
+        const uint32_t payload = function.payloads[i];
+        const Node *node = function.sources[i];
+
+        if (i % CANCEL_POLL_INTERVAL == CANCEL_POLL_INTERVAL - 1 && cancel.cancelled()) {
+            return fail({.rule = Rule::CANCELLED});
+        }
+
+        switch (function.ops[i]) {
+            /* Expressions */
+            case FlatOp::NUMBER:
+                types[i] = INT_TYPE.get();
+                break;
+            case FlatOp::NIL:
+                types[i] = NIL_TYPE.get();
+                break;
+            case FlatOp::SELECT_GUARD: {
+                const Type *guardType = types[operands[0]];
+
+                if (guardType->getTypeKind() != TypeKind::INT) {
+                    return fail({.rule = Rule::SELECT_GUARD_NOT_INT, .node = node, .types = {guardType}});
+                }
+
+                break;
+            }
+            case FlatOp::SELECT: {
+                const Type *ttCaseType = types[operands[0]];
+                const Type *ffCaseType = types[operands[1]];
+
+                if (!typesEqual(ttCaseType, ffCaseType)) {
+                    return fail({.rule = Rule::SELECT_BRANCHES_INCOMPATIBLE, .node = node, .types = {ttCaseType, ffCaseType}});
+                }
+
+                types[i] = ttCaseType->getTypeKind() == TypeKind::NIL ? ffCaseType : ttCaseType;
+                break;
+            }
+            case FlatOp::UNARY_OPERATION: {
+                const Type *operandType = types[operands[0]];
+
+                if (operandType->getTypeKind() != TypeKind::INT) {
+                    return fail({.rule = Rule::UNARY_OPERAND_NOT_INT, .node = node, .types = {operandType}});
+                }
+
+                types[i] = INT_TYPE.get();
+                break;
+            }
+            case FlatOp::BINARY_OPERATION: {
+                const Type *lhsType = types[operands[0]];
+                const Type *rhsType = types[operands[1]];
+                BinaryOperand operand = static_cast<BinaryOperand>(payload);
+
+                if (operand == BinaryOperand::EQ || operand == BinaryOperand::NOT_EQ) {
+                    if (!typesEqual(lhsType, rhsType)) {
+                        return fail({.rule = Rule::BINARY_OPERANDS_INCOMPATIBLE, .node = node, .types = {lhsType, rhsType}});
+                    }
+
+                    if (lhsType->getTypeKind() == TypeKind::STRUCT || lhsType->getTypeKind() == TypeKind::FUNCTION) {
+                        return fail({.rule = Rule::BINARY_OPERAND_INVALID, .node = node, .types = {lhsType}});
+                    }
+
+                    if (rhsType->getTypeKind() == TypeKind::STRUCT || rhsType->getTypeKind() == TypeKind::FUNCTION) {
+                        return fail({.rule = Rule::BINARY_OPERAND_INVALID, .node = node, .types = {rhsType}});
+                    }
+                } else {
+                    if (!typesEqual(lhsType, INT_TYPE.get())) {
+                        return fail({.rule = Rule::BINARY_LEFT_NOT_INT, .node = node, .types = {lhsType}});
+                    }
+
+                    if (!typesEqual(rhsType, INT_TYPE.get())) {
+                        return fail({.rule = Rule::BINARY_RIGHT_NOT_INT, .node = node, .types = {rhsType}});
+                    }
+                }
+
+                types[i] = INT_TYPE.get();
+                break;
+            }
+            case FlatOp::NEW_SINGLETON: {
+                TypeKind kind = function.allocationTypes[payload]->getTypeKind();
+
+                if (kind == TypeKind::NIL || kind == TypeKind::FUNCTION) {
+                    return fail({.rule = Rule::NEW_SINGLE_INVALID_TYPE, .node = node});
+                }
+
+                types[i] = function.allocationTypes[payload + 1];
+                break;
+            }
+            case FlatOp::NEW_ARRAY: {
+                const Type *sizeType = types[operands[0]];
+
+                if (!typesEqual(sizeType, INT_TYPE.get())) {
+                    return fail({.rule = Rule::NEW_ARRAY_SIZE_NOT_INT, .node = node, .types = {sizeType}});
+                }
+
+                TypeKind kind = function.allocationTypes[payload]->getTypeKind();
+
+                if (kind == TypeKind::NIL || kind == TypeKind::FUNCTION || kind == TypeKind::STRUCT) {
+                    return fail({.rule = Rule::NEW_ARRAY_INVALID_TYPE, .node = node});
+                }
+
+                types[i] = function.allocationTypes[payload + 1];
+                break;
+            }
+
+            /* Places */
+            case FlatOp::IDENTIFIER: {
+                const std::shared_ptr<Type> *type = gamma.lookup(payload);
+
+                if (!type) {
+                    return fail({.rule = Rule::UNKNOWN_ID, .node = node});
+                }
+
+                types[i] = type->get();
+                break;
+            }
+            case FlatOp::DEREFERENCE: {
+                const Type *pointeeType = types[operands[0]];
+
+                if (pointeeType->getTypeKind() != TypeKind::POINTER) {
+                    return fail({.rule = Rule::DEREFERENCE_NOT_POINTER, .node = node, .types = {pointeeType}});
+                }
+
+                types[i] = static_cast<const PointerType*>(pointeeType)->pointeeType.get();
+                break;
+            }
+            case FlatOp::ARRAY_ACCESS: {
+                const Type *arrayType = types[operands[0]];
+                const Type *indexType = types[operands[1]];
+
+                if (!typesEqual(indexType, INT_TYPE.get())) {
+                    return fail({.rule = Rule::ARRAY_INDEX_NOT_INT, .node = node, .types = {indexType}});
+                }
+
+                if (arrayType->getTypeKind() != TypeKind::ARRAY) {
+                    return fail({.rule = Rule::ARRAY_ACCESS_NOT_ARRAY, .node = node, .types = {arrayType}});
+                }
+
+                types[i] = static_cast<const ArrayType*>(arrayType)->elementType.get();
+                break;
+            }
+            case FlatOp::FIELD_ACCESS: {
+                const Type *baseType = types[operands[0]];
+                const StructType *structPtrType = nullptr;
+
+                if (baseType->getTypeKind() == TypeKind::POINTER) {
+                    const Type *pointeeType = static_cast<const PointerType*>(baseType)->pointeeType.get();
+
+                    if (pointeeType->getTypeKind() == TypeKind::STRUCT) {
+                        structPtrType = static_cast<const StructType*>(pointeeType);
+                    }
+                }
+
+                if (!structPtrType) {
+                    return fail({.rule = Rule::FIELD_ACCESS_NOT_STRUCT_POINTER, .node = node, .types = {baseType}});
+                }
+
+                const StructTable::Layout *layout = delta.find(structPtrType->symbol);
+
+                if (!layout) {
+                    return fail({.rule = Rule::FIELD_ACCESS_UNKNOWN_STRUCT, .node = node, .types = {structPtrType}});
+                }
+
+                ptrdiff_t fieldIndex = delta.fieldIndex(*layout, payload);
+
+                if (fieldIndex < 0) {
+                    return fail({.rule = Rule::FIELD_ACCESS_UNKNOWN_FIELD, .node = node, .types = {structPtrType}});
+                }
+
+                types[i] = delta.fieldType(*layout, fieldIndex).get();
+                break;
+            }
+
+            /* Function call */
+            case FlatOp::CALL_TO_MAIN:
+                return fail({.rule = Rule::CALL_TO_MAIN, .node = node});
+            case FlatOp::CALL_CALLEE: {
+                const Type *calleeType = types[operands[0]];
+                const FunctionType *functionType = calleeFunctionType(calleeType);
+
+                if (!functionType) {
+                    return fail({.rule = Rule::CALL_NOT_FUNCTION, .node = node, .types = {calleeType}});
+                }
+
+                if (payload != functionType->paramTypes.size()) {
+                    return fail({.rule = Rule::CALL_ARGUMENT_COUNT, .node = node, .types = {functionType}});
+                }
+
+                types[i] = functionType;
+                break;
+            }
+            case FlatOp::CALL_ARGUMENT: {
+                const FunctionType *functionType = static_cast<const FunctionType*>(types[operands[0]]);
+                const Type *argType = types[operands[1]];
+                const Type *paramType = functionType->paramTypes[payload].get();
+
+                if (!typesEqual(argType, paramType)) {
+                    const Node *arg = static_cast<const FunctionCall*>(node)->args[payload].get();
+                    return fail({.rule = Rule::CALL_ARGUMENT_TYPE, .node = node, .detail = arg, .types = {argType, paramType}});
+                }
+
+                break;
+            }
+            case FlatOp::CALL:
+                types[i] = static_cast<const FunctionType*>(types[operands[0]])->returnType.get();
+                break;
+
+            /* Statements */
+            case FlatOp::STATEMENTS: {
+                bool doesReturn = false;
+
+                for (size_t k = 0; k < operandCount; k++) {
+                    doesReturn = returns[operands[k]] || doesReturn;
+                }
+
+                returns[i] = doesReturn;
+                break;
+            }
+            case FlatOp::ASSIGNMENT: {
+                const Type *lhsType = types[operands[0]];
+                const Type *rhsType = types[operands[1]];
+
+                if (!isStorableKind(lhsType->getTypeKind())) {
+                    return fail({.rule = Rule::ASSIGN_INVALID_LHS, .node = node, .types = {lhsType}});
+                }
+
+                if (!typesEqual(lhsType, rhsType)) {
+                    return fail({.rule = Rule::ASSIGN_INCOMPATIBLE, .node = node, .types = {lhsType, rhsType}});
+                }
+
+                returns[i] = false;
+                break;
+            }
+            case FlatOp::CALL_STATEMENT:
+                returns[i] = false;
+                break;
+            case FlatOp::IF_GUARD: {
+                const Type *guardType = types[operands[0]];
+
+                if (!typesEqual(guardType, INT_TYPE.get())) {
+                    return fail({.rule = Rule::IF_GUARD_NOT_INT, .node = node, .types = {guardType}});
+                }
+
+                break;
+            }
+            case FlatOp::IF: {
+                bool happyPathReturns = returns[operands[0]];
+                bool unhappyPathReturns = operandCount == 2 ? returns[operands[1]] : false;
+                returns[i] = happyPathReturns && unhappyPathReturns;
+                break;
+            }
+            case FlatOp::WHILE_GUARD: {
+                const Type *guardType = types[operands[0]];
+
+                if (!typesEqual(guardType, INT_TYPE.get())) {
+                    return fail({.rule = Rule::WHILE_GUARD_NOT_INT, .node = node, .types = {guardType}});
+                }
+
+                loopDepth++;
+                break;
+            }
+            case FlatOp::WHILE:
+                loopDepth--;
+                returns[i] = false;
+                break;
+            case FlatOp::BREAK:
+                if (loopDepth == 0) {
+                    return fail({.rule = Rule::BREAK_OUTSIDE_LOOP, .node = node});
+                }
+
+                returns[i] = false;
+                break;
+            case FlatOp::CONTINUE:
+                if (loopDepth == 0) {
+                    return fail({.rule = Rule::CONTINUE_OUTSIDE_LOOP, .node = node});
+                }
+
+                returns[i] = false;
+                break;
+            case FlatOp::RETURN:
+                if (operandCount == 1) {
+                    const Type *expressionType = types[operands[0]];
+
+                    if (!typesEqual(expressionType, returnType)) {
+                        return fail({.rule = Rule::RETURN_TYPE_MISMATCH, .node = node, .types = {expressionType, returnType}});
+                    }
+                } else {
+                    if (!typesEqual(returnType, INT_TYPE.get())) {
+                        return fail({.rule = Rule::RETURN_MISSING_EXPRESSION, .node = node, .types = {returnType}});
+                    }
+
+                    return fail({.rule = Rule::RETURN_WITHOUT_EXPRESSION, .node = node});
+                }
+
+                returns[i] = true;
+                break;
+        }
+    }
+
+    // The body's own op comes last
+    return count > 0 && returns[count - 1];
+}
+
+std::optional<Diagnostic> diagnoseFlat(const FunctionDefinition &function, const Gamma &gamma, const Delta &delta, CancelToken cancel) {
+    Scope localGamma(gamma);
+
+    if (std::optional<Diagnostic> failure = function.diagnoseDeclarations(localGamma)) {
+        return failure;
+    }
+
+    FlatChecker checker(localGamma, delta, cancel);
+    bool doesReturn = checker.checkBody(flattenFunction(function), function.returnType.get());
+
+    if (checker.failure()) {
+        return checker.failure();
+    }
+
+    if (!doesReturn) {
+        return Diagnostic{.rule = Rule::MISSING_RETURN, .node = &function};
+    }
+
+    return std::nullopt;
+}
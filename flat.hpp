@@ -0,0 +1,105 @@
+#ifndef FLAT_HPP
+#define FLAT_HPP
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "ast.hpp"
+#include "cancel.hpp"
+#include "diagnostic.hpp"
+
+// One step of a flattened function body. Most ops are the LEAVE of one node;
+// the *_GUARD, CALL_CALLEE, CALL_ARGUMENT and CALL_TO_MAIN ops are the premises
+// the tree checker tests partway through a node, placed at the same point, so
+// a linear sweep fails on the same premise, in the same order, as a walk of the
+// tree does. Value and CallExpression have no op of their own: their type is
+// their child's, so they share its slot.
+enum class FlatOp : uint8_t {
+    /* Expressions */
+    NUMBER,
+    NIL,
+    SELECT_GUARD,
+    SELECT,
+    UNARY_OPERATION,
+    BINARY_OPERATION,
+    NEW_SINGLETON,
+    NEW_ARRAY,
+
+    /* Places */
+    IDENTIFIER,
+    DEREFERENCE,
+    ARRAY_ACCESS,
+    FIELD_ACCESS,
+
+    /* Function call */
+    CALL_TO_MAIN,
+    CALL_CALLEE,
+    CALL_ARGUMENT,
+    CALL,
+
+    /* Statements */
+    STATEMENTS,
+    ASSIGNMENT,
+    CALL_STATEMENT,
+    IF_GUARD,
+    IF,
+    WHILE_GUARD,
+    WHILE,
+    BREAK,
+    CONTINUE,
+    RETURN,
+};
+
+// A function body as parallel arrays in evaluation order, one entry per op.
+// An op's operands are the slots (earlier op indices) listed in
+// children[childStart[i], childStart[i + 1]); each op's result lands in its own
+// slot, so checking is one forward pass with no stack and no pointer chasing
+// through the tree. sources only serves to render diagnostics, and borrows
+// from the Program the function belongs to.
+struct FlatFunction {
+    std::vector<FlatOp> ops;
+    std::vector<uint32_t> childStart;
+    std::vector<uint32_t> children;
+
+    // Per op: the operator, Symbol, argument index or argument count it needs,
+    // or for an allocation the index of its (declared, allocated) type pair
+    std::vector<uint32_t> payloads;
+    std::vector<const Type *> allocationTypes;
+
+    std::vector<const Node *> sources;
+};
+
+extern FlatFunction flattenFunction(const FunctionDefinition &function);
+
+// Runs the typing rules of checker.hpp over a FlatFunction in a single sweep,
+// stopping with Rule::CANCELLED once its token is cancelled
+class FlatChecker {
+public:
+    FlatChecker(const Scope &gamma, const Delta &delta, CancelToken cancel = {});
+
+    // Whether the body is guaranteed to execute a return; false once a rule has failed
+    bool checkBody(const FlatFunction &function, const Type *returnType);
+
+    // The rule that failed in the last check, if any
+    const std::optional<Diagnostic> &failure() const;
+
+private:
+    bool fail(Diagnostic diagnostic);
+
+    const Scope &gamma;
+    const Delta &delta;
+    CancelToken cancel;
+
+    // Result slots, reused from one function to the next: the type of an
+    // expression op, and whether a statement op is guaranteed to return
+    std::vector<const Type *> types;
+    std::vector<uint8_t> returns;
+
+    std::optional<Diagnostic> diagnostic;
+};
+
+// FunctionDefinition::diagnose, with the body flattened and checked by a FlatChecker
+extern std::optional<Diagnostic> diagnoseFlat(const FunctionDefinition &function, const Gamma &gamma, const Delta &delta, CancelToken cancel = {});
+
+#endif
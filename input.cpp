@@ -0,0 +1,61 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "input.hpp"
+#include "memory.hpp"
+
+InputBuffer::InputBuffer(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        return;
+    }
+
+    opened = true;
+    struct stat info;
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void *address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (address != MAP_FAILED) {
+            // The parser reads front to back exactly once
+            madvise(address, info.st_size, MADV_SEQUENTIAL);
+            this->mapping = address;
+            this->mappingSize = info.st_size;
+            memory::charge(mappingSize);
+            close(fd);
+            return;
+        }
+    }
+
+    // Fallback: read the whole file into one buffer
+    char chunk[64 * 1024];
+    ssize_t count;
+
+    while ((count = read(fd, chunk, sizeof(chunk))) > 0) {
+        fallback.append(chunk, count);
+    }
+
+    close(fd);
+}
+
+InputBuffer::~InputBuffer() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        memory::release(mappingSize);
+    }
+}
+
+bool InputBuffer::isOpen() const {
+    return opened;
+}
+
+std::string_view InputBuffer::contents() const {
+    if (mapping) {
+        return std::string_view(static_cast<const char *>(mapping), mappingSize);
+    }
+
+    return fallback;
+}
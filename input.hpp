@@ -0,0 +1,30 @@
+#ifndef INPUT_HPP
+#define INPUT_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// The whole contents of an input file in one contiguous buffer. Regular files
+// are mapped read-only; anything that cannot be mapped (pipes, empty files) is
+// read into memory in one go instead. A mapping counts as held memory
+// (memory.hpp) for as long as the buffer lives.
+class InputBuffer {
+public:
+    explicit InputBuffer(const std::string &path);
+    ~InputBuffer();
+
+    InputBuffer(const InputBuffer &) = delete;
+    InputBuffer &operator=(const InputBuffer &) = delete;
+
+    bool isOpen() const;
+    std::string_view contents() const;
+
+private:
+    bool opened = false;
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+    std::string fallback;
+};
+
+#endif
@@ -1,41 +1,209 @@
 #include <iostream>
 #include <fstream>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
 
-#include "ast.hpp"
-#include "json.hpp"
-#include "builder.hpp"
+#include "cflatcheck.hpp"
+
+using cflatcheck::Status;
+
+// Prints one "<file>: <result>" line per input, in input order
+static int printBatch(const std::vector<std::string> &inputPaths, const std::vector<cflatcheck::Result> &results) {
+    int status = 0;
+
+    for (size_t i = 0; i < inputPaths.size(); i++) {
+        const cflatcheck::Result &result = results[i];
+
+        if (result.status() == Status::VALID || result.status() == Status::INVALID) {
+            std::cout << inputPaths[i] << ": " << result.message() << "\n";
+        } else {
+            std::cout << inputPaths[i] << ": error: " << result.message() << "\n";
+            status = 1;
+        }
+    }
+
+    std::cout.flush();
+    return status;
+}
+
+// A byte count, optionally with a K, M or G suffix (powers of 1024), or 0 if
+// text is not one or does not fit in a size_t
+static size_t parseSize(const char *text) {
+    // strtoull would take a sign or leading spaces
+    if (!std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return 0;
+    }
+
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long size = std::strtoull(text, &end, 10);
+    unsigned shift = 0;
+
+    switch (*end) {
+        case 'K': shift = 10; end++; break;
+        case 'M': shift = 20; end++; break;
+        case 'G': shift = 30; end++; break;
+        default: break;
+    }
+
+    if (errno == ERANGE || *end != '\0' || size > (SIZE_MAX >> shift)) {
+        return 0;
+    }
+
+    return static_cast<size_t>(size) << shift;
+}
+
+static int usage(const char *program) {
+    std::cerr << "Usage: " << program << " [--dom] [--flat] [--jobs N] [--cache FILE] [--stats] [--max-memory SIZE] [--annotate OUTPUT.astj] <input.astj>." << std::endl;
+    std::cerr << "       " << program << " --batch [--dom] [--flat] [--jobs N] [--cache FILE] [--stats] [--max-memory SIZE] [<input.astj>... | -]." << std::endl;
+    std::cerr << "       " << program << " --serve SOCKET [--dom] [--flat] [--jobs N] [--cache FILE] [--stats] [--max-memory SIZE]." << std::endl;
+    std::cerr << "       " << program << " --convert OUTPUT.astb [--dom] [--stats] [--max-memory SIZE] <input.astj>." << std::endl;
+    return 1;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.astj>." << std::endl;
-        return 1;
+    cflatcheck::Options options;
+    bool batch = false;
+    const char *socketPath = nullptr;
+    const char *convertPath = nullptr;
+    const char *annotatePath = nullptr;
+    std::vector<std::string> inputPaths;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--dom") == 0) {
+            // Parse into an nlohmann::json tree before building the AST
+            options.useDom = true;
+        } else if (std::strcmp(argv[i], "--flat") == 0) {
+            // Check function bodies through their flattened form (flat.hpp)
+            options.useFlat = true;
+        } else if (std::strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            cflatcheck::enableStats();
+        } else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--convert") == 0 && i + 1 < argc) {
+            convertPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--annotate") == 0 && i + 1 < argc) {
+            annotatePath = argv[++i];
+            options.recordTypes = true;
+        } else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            // Keep per-function verdicts on disk between runs
+            options.cachePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--max-memory") == 0 && i + 1 < argc) {
+            // Fail an input rather than grow past SIZE, e.g. 512M
+            size_t limit = parseSize(argv[++i]);
+
+            if (limit == 0) {
+                return usage(argv[0]);
+            }
+
+            cflatcheck::setMemoryLimit(limit);
+        } else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            char *end = nullptr;
+            // --jobs 0 uses one thread per core
+            options.jobs = static_cast<unsigned>(std::strtoul(argv[++i], &end, 10));
+
+            if (*end != '\0') {
+                return usage(argv[0]);
+            }
+        } else {
+            inputPaths.push_back(argv[i]);
+        }
+    }
+
+    // --stats reports on stderr however main returns, after the pool and cache are gone
+    struct StatsReport {
+        ~StatsReport() {
+            if (cflatcheck::statsEnabled()) {
+                cflatcheck::writeStats(std::cerr);
+            }
+        }
+    } statsReport;
+
+    // --annotate writes one program's types, so it only applies to a single input
+    if (annotatePath && (batch || socketPath || convertPath)) {
+        return usage(argv[0]);
+    }
+
+    if (convertPath) {
+        if (batch || socketPath || inputPaths.size() != 1) {
+            return usage(argv[0]);
+        }
+
+        std::string error;
+
+        if (!cflatcheck::convertFile(inputPaths[0], convertPath, options.useDom, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+
+        return 0;
     }
 
-    std::ifstream inputFile(argv[1]);
-    
-    if (!inputFile.is_open()) {
-        std::cerr << "Could not open file " << argv[1] << "." << std::endl;
-        return 1;
+    cflatcheck::Checker checker(options);
+
+    if (socketPath) {
+        if (batch || !inputPaths.empty()) {
+            return usage(argv[0]);
+        }
+
+        int status = checker.serve(socketPath);
+        checker.saveCache();
+        return status;
+    }
+
+    if (batch) {
+        // Without file arguments (or with "-") the list of inputs is read from stdin, one per line
+        if (inputPaths.empty() || (inputPaths.size() == 1 && inputPaths[0] == "-")) {
+            inputPaths.clear();
+
+            for (std::string line; std::getline(std::cin, line);) {
+                if (!line.empty()) {
+                    inputPaths.push_back(line);
+                }
+            }
+        }
+
+        int status = printBatch(inputPaths, checker.checkFiles(inputPaths));
+        checker.saveCache();
+        return status;
+    }
+
+    if (inputPaths.size() != 1) {
+        return usage(argv[0]);
     }
 
-    nlohmann::json json;
+    cflatcheck::Result result = checker.checkFile(inputPaths[0]);
+    checker.saveCache();
 
-    try {
-       inputFile >> json; 
-    } catch (const nlohmann::json::parse_error &e) {
-        std::cerr << "JSON parsing error " << e.what() << std::endl;
-        return 1;
+    // Typed as far as checking got, whether or not the program is valid
+    if (annotatePath && result.nodeCount() > 0) {
+        std::ofstream output(annotatePath, std::ios::trunc);
+
+        if (!result.writeAnnotated(output) || !output.flush()) {
+            std::cerr << "Could not write file " << annotatePath << "." << std::endl;
+            return 1;
+        }
     }
 
-    try {
-        std::unique_ptr<Program> program = buildProgram(json);
-        program->check();
-        std::cout << "valid" << std::endl;
-    } catch (const std::runtime_error &e) {
-        std::cout << "invalid: " << e.what() << std::endl;  
-    } catch (const std::exception &e) {
-        std::cerr << "Error: " << e.what() << std::endl;
-    } 
+    switch (result.status()) {
+        case Status::VALID:
+        case Status::INVALID:
+            std::cout << result.message() << std::endl;
+            return 0;
+        case Status::UNREADABLE:
+        case Status::MEMORY_LIMIT:
+            std::cerr << result.message() << std::endl;
+            return 1;
+        case Status::ERROR:
+            std::cerr << result.message() << std::endl;
+            return 0;
+    }
 
     return 0;
 }
@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "memory.hpp"
+
+namespace memory {
+
+bool trackingFlag = false;
+alignas(64) std::atomic<int64_t> liveBytes{0};
+size_t limitBytes = 0;
+
+alignas(64) static std::atomic<int64_t> peakBytes{0};
+
+// What this thread has allocated less what it has freed, which goes negative
+// on a thread that frees what another allocated, and its high water
+static thread_local int64_t threadBytes = 0;
+static thread_local int64_t threadPeak = 0;
+
+LimitExceeded::LimitExceeded(size_t limit) {
+    std::snprintf(message, sizeof(message), "memory limit of %zu bytes exceeded", limit);
+}
+
+const char *LimitExceeded::what() const noexcept {
+    return message;
+}
+
+void track() {
+    trackingFlag = true;
+}
+
+void setLimit(size_t bytes) {
+    limitBytes = bytes;
+    track();
+}
+
+size_t limit() {
+    return limitBytes;
+}
+
+size_t held() {
+    return std::max<int64_t>(liveBytes.load(std::memory_order_relaxed), 0);
+}
+
+size_t peak() {
+    return peakBytes.load(std::memory_order_relaxed);
+}
+
+void add(int64_t bytes) {
+    int64_t now = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t highest = peakBytes.load(std::memory_order_relaxed);
+
+    while (now > highest && !peakBytes.compare_exchange_weak(highest, now, std::memory_order_relaxed)) {
+    }
+
+    threadBytes += bytes;
+    threadPeak = std::max(threadPeak, threadBytes);
+}
+
+void charge(size_t bytes) {
+    if (tracking()) {
+        add(bytes);
+    }
+}
+
+void release(size_t bytes) {
+    if (tracking()) {
+        add(-static_cast<int64_t>(bytes));
+    }
+}
+
+void throwLimitExceeded() {
+    throw LimitExceeded(limitBytes);
+}
+
+PeakScope::PeakScope() : base(threadBytes), outerPeak(threadPeak) {
+    threadPeak = threadBytes;
+}
+
+size_t PeakScope::finish() {
+    int64_t peak = threadPeak - base;
+    threadPeak = std::max(threadPeak, outerPeak);
+    return std::max<int64_t>(peak, 0);
+}
+
+} // namespace memory
@@ -0,0 +1,94 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Heap accounting behind --max-memory and the peak bytes of --stats. The
+// count is what the process holds on the heap plus any mapped inputs. Heap
+// bytes are only seen by a program that links the allocator hook in
+// allocator.cpp, which replaces the global operator new and delete: ./type
+// does, the library does not, so a program embedding it keeps its own
+// allocator and only its mapped inputs are counted unless it opts in too.
+// The hook only counts once tracking is on (one branch on a flag otherwise).
+//
+// A limit never makes an allocation fail: code that may fail cleanly polls
+// checkLimit as it goes, as the checkers poll their CancelToken, so a failure
+// never starts inside a destructor or another place that cannot throw.
+namespace memory {
+
+// Thrown by checkLimit. A bad_alloc rather than a runtime_error, which
+// checkContents would report as an invalid program.
+class LimitExceeded : public std::bad_alloc {
+public:
+    explicit LimitExceeded(size_t limit);
+
+    const char *what() const noexcept override;
+
+private:
+    char message[64];
+};
+
+// Set once by track, before any input is read
+extern bool trackingFlag;
+extern std::atomic<int64_t> liveBytes;
+extern size_t limitBytes;
+
+inline bool tracking() {
+    return trackingFlag;
+}
+
+// Starts counting. Memory allocated before this is not counted, so it is
+// turned on while the command line is parsed, by --stats and --max-memory.
+void track();
+
+// Fails every later checkLimit while more than bytes are held; 0 means no
+// limit. Turns on tracking, and applies to the whole process: with --jobs, to
+// every input being checked at once.
+void setLimit(size_t bytes);
+size_t limit();
+
+// Bytes held now, and the most held at once since tracking started
+size_t held();
+size_t peak();
+
+// Counts bytes allocated on this thread, or freed when negative; called by
+// the allocator hook while tracking is on
+void add(int64_t bytes);
+
+// Counts memory that is not allocated through operator new, such as a mapped
+// input, as held until the matching release
+void charge(size_t bytes);
+void release(size_t bytes);
+
+[[noreturn]] void throwLimitExceeded();
+
+// Throws LimitExceeded if more than the limit is held
+inline void checkLimit() {
+    if (limitBytes && liveBytes.load(std::memory_order_relaxed) > static_cast<int64_t>(limitBytes)) {
+        throwLimitExceeded();
+    }
+}
+
+// The most a scope holds at once on its own thread, above what the thread
+// held when it began. Scopes nest; the outer one still sees the inner's peak.
+class PeakScope {
+public:
+    PeakScope();
+
+    PeakScope(const PeakScope &) = delete;
+    PeakScope &operator=(const PeakScope &) = delete;
+
+    // Ends the scope; call once
+    size_t finish();
+
+private:
+    int64_t base;
+    int64_t outerPeak;
+};
+
+} // namespace memory
+
+#endif
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <format>
+#include <iterator>
+
+#include "render.hpp"
+#include "ast.hpp"
+#include "types.hpp"
+
+Renderer::Renderer(std::string &out) : out(out) {}
+
+void Renderer::text(std::string_view text) {
+    if (deferring) {
+        queue({PartKind::TEXT, text});
+    } else {
+        out += text;
+    }
+}
+
+void Renderer::number(long long value) {
+    if (deferring) {
+        queue({PartKind::NUMBER, {}, value});
+    } else {
+        std::format_to(std::back_inserter(out), "{}", value);
+    }
+}
+
+void Renderer::node(const Node &node) {
+    queue({PartKind::NODE, {}, 0, &node});
+}
+
+void Renderer::type(const Type &type) {
+    queue({PartKind::TYPE, {}, 0, &type});
+}
+
+void Renderer::prettyType(const Type &type) {
+    queue({PartKind::PRETTY_TYPE, {}, 0, &type});
+}
+
+void Renderer::queue(Part part) {
+    pending.push_back(part);
+    deferring = true;
+}
+
+// Lets the item list its parts, then puts them in the order they are popped
+void Renderer::expand(const Part &part) {
+    expanding = pending.size();
+    deferring = false;
+
+    switch (part.kind) {
+        case PartKind::NODE:
+            static_cast<const Node*>(part.item)->renderParts(*this);
+            break;
+        case PartKind::TYPE:
+            static_cast<const Type*>(part.item)->renderParts(*this);
+            break;
+        case PartKind::PRETTY_TYPE:
+            static_cast<const Type*>(part.item)->renderPrettyParts(*this);
+            break;
+        case PartKind::TEXT:
+        case PartKind::NUMBER:
+            break;
+    }
+
+    std::reverse(pending.begin() + expanding, pending.end());
+}
+
+void Renderer::run() {
+    std::reverse(pending.begin() + expanding, pending.end());
+
+    while (!pending.empty()) {
+        Part part = pending.back();
+        pending.pop_back();
+
+        if (part.kind == PartKind::TEXT) {
+            out += part.text;
+        } else if (part.kind == PartKind::NUMBER) {
+            std::format_to(std::back_inserter(out), "{}", part.value);
+        } else {
+            expand(part);
+        }
+    }
+
+    expanding = 0;
+    deferring = false;
+}
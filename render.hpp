@@ -0,0 +1,65 @@
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Node;
+struct Type;
+
+// Renders nodes and types into one buffer from an explicit stack on the heap,
+// so rendering never recurses no matter how deeply a tree or type is nested.
+// Each node's renderParts() (and each type's renderParts() and
+// renderPrettyParts()) lists its parts in order through the calls below.
+// Text up to the first child goes straight into the buffer; the children and
+// the text after them are queued and rendered in turn. Queued text is only
+// viewed, not copied, so it must outlive the render: literals and interned
+// or node-owned names are fine.
+class Renderer {
+public:
+    explicit Renderer(std::string &out);
+
+    Renderer(const Renderer &) = delete;
+    Renderer &operator=(const Renderer &) = delete;
+
+    void text(std::string_view text);
+    void number(long long value);
+    void node(const Node &node);
+    // The debug form of a type, as nodes spell it; prettyType is the form in messages
+    void type(const Type &type);
+    void prettyType(const Type &type);
+
+    // Renders everything queued so far, then returns
+    void run();
+
+private:
+    enum class PartKind {
+        TEXT,
+        NUMBER,
+        NODE,
+        TYPE,
+        PRETTY_TYPE,
+    };
+
+    struct Part {
+        PartKind kind;
+        std::string_view text;
+        long long value = 0;
+        const void *item = nullptr;
+    };
+
+    void queue(Part part);
+    void expand(const Part &part);
+
+    std::string &out;
+    // Parts still to render, the next one last
+    std::vector<Part> pending;
+    // Where the parts of the item being expanded start in pending, and
+    // whether one of them has been queued yet
+    size_t expanding = 0;
+    bool deferring = false;
+};
+
+#endif
@@ -0,0 +1,892 @@
+#include <stdexcept>
+#include <utility>
+#include <variant>
+
+#include "json.hpp"
+#include "builder.hpp"
+#include "memory.hpp"
+#include "saxbuilder.hpp"
+#include "tags.hpp"
+
+namespace {
+
+// What a JSON value is expected to hold, decided by where it appears in its parent
+enum class Role {
+    PROGRAM,
+    STRUCT_LIST,
+    STRUCT,
+    EXTERN_LIST,
+    EXTERN,
+    FUNCTION_LIST,
+    FUNCTION,
+    DECLARATION_LIST,
+    DECLARATION,
+    TYPE,
+    TYPE_LIST,
+    FUNCTION_SIGNATURE,
+    EXPRESSION,
+    EXPRESSION_LIST,
+    PLACE,
+    SELECT,
+    UNARY_OPERATION,
+    BINARY_OPERATION,
+    NEW_ARRAY,
+    FUNCTION_CALL,
+    ARRAY_ACCESS,
+    FIELD_ACCESS,
+    STATEMENT,
+    STATEMENT_LIST,
+    ASSIGNMENT,
+    IF,
+    WHILE,
+    NAME,
+    NUMBER,
+    IGNORED,
+};
+
+struct BuiltList;
+
+// A finished value, handed from a closed container (or a scalar) to its parent
+using Built = std::variant<
+    std::monostate,
+    std::string,
+    long long,
+    std::shared_ptr<Type>,
+    NodePtr<Expression>,
+    NodePtr<Place>,
+    NodePtr<Statement>,
+    NodePtr<FunctionCall>,
+    NodePtr<StructDefinition>,
+    NodePtr<FunctionDefinition>,
+    Extern,
+    Declaration,
+    std::unique_ptr<BuiltList>>;
+
+struct BuiltList {
+    std::vector<Built> elements;
+};
+
+// One open JSON object or array. Only the already-built children of the
+// containers currently being parsed are held, never a whole subtree.
+struct Frame {
+    Role role;
+    bool isObject;
+    std::string key;
+    std::vector<std::pair<std::string, Built>> members;
+    std::vector<Built> elements;
+};
+
+// What the DOM builder (builder.cpp) says about a malformed value in this role
+static const char *invalidMessage(Role role) {
+    switch (role) {
+        case Role::PROGRAM:            return "Invalid JSON for Program root object";
+        case Role::STRUCT_LIST:        return "Invalid JSON for Program structs";
+        case Role::STRUCT:             return "Invalid JSON for Struct definition";
+        case Role::EXTERN_LIST:        return "Invalid JSON for Program externs";
+        case Role::EXTERN:             return "Invalid JSON for Extern definition: missing 'name' or 'typ'";
+        case Role::FUNCTION_LIST:      return "Invalid JSON for Program functions";
+        case Role::FUNCTION:           return "Invalid JSON for Function definition";
+        case Role::DECLARATION_LIST:   return "Invalid JSON for Decl";
+        case Role::DECLARATION:        return "Invalid JSON for Decl";
+        case Role::TYPE:               return "Invalid JSON for Type";
+        case Role::TYPE_LIST:          return "Invalid JSON for Function type signature.";
+        case Role::FUNCTION_SIGNATURE: return "Invalid JSON for Function type signature.";
+        case Role::EXPRESSION:         return "Invalid JSON for Exp: Must be non-empty object or known literal";
+        case Role::EXPRESSION_LIST:    return "Invalid JSON for FunctionCall";
+        case Role::PLACE:              return "Invalid JSON for Place: Must be non-empty object";
+        case Role::SELECT:             return "Invalid JSON for Select content";
+        case Role::UNARY_OPERATION:    return "Invalid JSON for UnOp content: Expected 2-element array [op, exp]";
+        case Role::BINARY_OPERATION:   return "Invalid JSON for BinaryOperation content";
+        case Role::NEW_ARRAY:          return "Invalid JSON for NewArray content: Expected 2-element array [Type, Exp]";
+        case Role::FUNCTION_CALL:      return "Invalid JSON for FunctionCall";
+        case Role::ARRAY_ACCESS:       return "Invalid JSON for ArrayAccess content";
+        case Role::FIELD_ACCESS:       return "Invalid JSON for FieldAccess content";
+        case Role::STATEMENT:          return "Invalid JSON for Statement: Expected non-empty object, array, or specific string (Break/Continue)";
+        case Role::STATEMENT_LIST:     return "Invalid JSON for nested Stmts content";
+        case Role::ASSIGNMENT:         return "Invalid JSON for Assign content: Expected [Place, Exp]";
+        case Role::IF:                 return "Invalid JSON for If content: Missing guard or tt";
+        case Role::WHILE:              return "Invalid JSON for While content: Expected [GuardExp, BodyStmtArray]";
+        case Role::NAME:               return "Invalid JSON for name";
+        case Role::NUMBER:             return "Invalid JSON for Num";
+        case Role::IGNORED:            return "Invalid JSON for ignored value";
+    }
+
+    return "";
+}
+
+[[noreturn]] static void invalid(Role role) {
+    throw std::runtime_error(invalidMessage(role));
+}
+
+static bool isArrayRole(Role role) {
+    switch (role) {
+        case Role::STRUCT_LIST:
+        case Role::EXTERN_LIST:
+        case Role::FUNCTION_LIST:
+        case Role::DECLARATION_LIST:
+        case Role::TYPE_LIST:
+        case Role::FUNCTION_SIGNATURE:
+        case Role::EXPRESSION_LIST:
+        case Role::UNARY_OPERATION:
+        case Role::NEW_ARRAY:
+        case Role::STATEMENT_LIST:
+        case Role::ASSIGNMENT:
+        case Role::WHILE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static Role placeMemberRole(Tag tag) {
+    switch (tag) {
+        case Tag::ID:           return Role::NAME;
+        case Tag::DEREF:        return Role::EXPRESSION;
+        case Tag::ARRAY_ACCESS: return Role::ARRAY_ACCESS;
+        case Tag::FIELD_ACCESS: return Role::FIELD_ACCESS;
+        default:                return Role::IGNORED;
+    }
+}
+
+static Role memberRole(Role parent, const std::string &key) {
+    Tag tag = lookupTag(key);
+
+    switch (parent) {
+        case Role::PROGRAM:
+            switch (tag) {
+                case Tag::KEY_STRUCTS:   return Role::STRUCT_LIST;
+                case Tag::KEY_EXTERNS:   return Role::EXTERN_LIST;
+                case Tag::KEY_FUNCTIONS: return Role::FUNCTION_LIST;
+                default:                 break;
+            }
+            break;
+        case Role::STRUCT:
+            switch (tag) {
+                case Tag::KEY_NAME:   return Role::NAME;
+                case Tag::KEY_FIELDS: return Role::DECLARATION_LIST;
+                default:              break;
+            }
+            break;
+        case Role::EXTERN:
+        case Role::DECLARATION:
+            switch (tag) {
+                case Tag::KEY_NAME: return Role::NAME;
+                case Tag::KEY_TYP:  return Role::TYPE;
+                default:            break;
+            }
+            break;
+        case Role::FUNCTION:
+            switch (tag) {
+                case Tag::KEY_NAME:   return Role::NAME;
+                case Tag::KEY_PRMS:
+                case Tag::KEY_LOCALS: return Role::DECLARATION_LIST;
+                case Tag::KEY_RETTYP: return Role::TYPE;
+                case Tag::KEY_STMTS:  return Role::STATEMENT_LIST;
+                default:              break;
+            }
+            break;
+        case Role::TYPE:
+            switch (tag) {
+                case Tag::STRUCT:
+                case Tag::KEY_KIND: return Role::NAME;
+                case Tag::PTR:
+                case Tag::ARRAY:    return Role::TYPE;
+                case Tag::FN:       return Role::FUNCTION_SIGNATURE;
+                default:            break;
+            }
+            break;
+        case Role::EXPRESSION:
+            switch (tag) {
+                case Tag::NUM:        return Role::NUMBER;
+                case Tag::SELECT:     return Role::SELECT;
+                case Tag::UN_OP:      return Role::UNARY_OPERATION;
+                case Tag::BIN_OP:     return Role::BINARY_OPERATION;
+                case Tag::NEW_SINGLE: return Role::TYPE;
+                case Tag::NEW_ARRAY:  return Role::NEW_ARRAY;
+                case Tag::CALL:       return Role::FUNCTION_CALL;
+                case Tag::VAL:        return Role::PLACE;
+                default:              return placeMemberRole(tag);
+            }
+        case Role::PLACE:
+            return placeMemberRole(tag);
+        case Role::SELECT:
+            switch (tag) {
+                case Tag::KEY_GUARD:
+                case Tag::KEY_TT:
+                case Tag::KEY_FF: return Role::EXPRESSION;
+                default:          break;
+            }
+            break;
+        case Role::BINARY_OPERATION:
+            switch (tag) {
+                case Tag::KEY_OP:    return Role::NAME;
+                case Tag::KEY_LEFT:
+                case Tag::KEY_RIGHT: return Role::EXPRESSION;
+                default:             break;
+            }
+            break;
+        case Role::FUNCTION_CALL:
+            switch (tag) {
+                case Tag::KEY_CALLEE: return Role::EXPRESSION;
+                case Tag::KEY_ARGS:   return Role::EXPRESSION_LIST;
+                default:              break;
+            }
+            break;
+        case Role::ARRAY_ACCESS:
+            switch (tag) {
+                case Tag::KEY_ARRAY:
+                case Tag::KEY_IDX: return Role::EXPRESSION;
+                default:           break;
+            }
+            break;
+        case Role::FIELD_ACCESS:
+            switch (tag) {
+                case Tag::KEY_PTR:   return Role::EXPRESSION;
+                case Tag::KEY_FIELD: return Role::NAME;
+                default:             break;
+            }
+            break;
+        case Role::STATEMENT:
+            switch (tag) {
+                case Tag::ASSIGN: return Role::ASSIGNMENT;
+                case Tag::CALL:   return Role::FUNCTION_CALL;
+                case Tag::IF:     return Role::IF;
+                case Tag::WHILE:  return Role::WHILE;
+                case Tag::RETURN: return Role::EXPRESSION;
+                case Tag::STMTS:  return Role::STATEMENT_LIST;
+                default:          break;
+            }
+            break;
+        case Role::IF:
+            switch (tag) {
+                case Tag::KEY_GUARD: return Role::EXPRESSION;
+                case Tag::KEY_TT:
+                case Tag::KEY_FF:    return Role::STATEMENT;
+                default:             break;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return Role::IGNORED;
+}
+
+static Role elementRole(Role parent, size_t index) {
+    switch (parent) {
+        case Role::STRUCT_LIST:      return Role::STRUCT;
+        case Role::EXTERN_LIST:      return Role::EXTERN;
+        case Role::FUNCTION_LIST:    return Role::FUNCTION;
+        case Role::DECLARATION_LIST: return Role::DECLARATION;
+        case Role::TYPE_LIST:        return Role::TYPE;
+        case Role::EXPRESSION_LIST:  return Role::EXPRESSION;
+        case Role::STATEMENT_LIST:   return Role::STATEMENT;
+        case Role::FUNCTION_SIGNATURE:
+            return index == 0 ? Role::TYPE_LIST : Role::TYPE;
+        case Role::UNARY_OPERATION:
+            return index == 0 ? Role::NAME : Role::EXPRESSION;
+        case Role::NEW_ARRAY:
+            return index == 0 ? Role::TYPE : Role::EXPRESSION;
+        case Role::ASSIGNMENT:
+            return index == 0 ? Role::PLACE : Role::EXPRESSION;
+        case Role::WHILE:
+            return index == 0 ? Role::EXPRESSION : Role::STATEMENT;
+        default:
+            return Role::IGNORED;
+    }
+}
+
+/* Helpers for pulling built children out of a closed frame */
+
+template <typename T>
+static T takeBuilt(Built &built, Role role) {
+    if (auto *value = std::get_if<T>(&built)) {
+        return std::move(*value);
+    }
+
+    invalid(role);
+}
+
+template <typename T>
+static T takeMember(Frame &frame, const char *key) {
+    for (auto &[name, built] : frame.members) {
+        if (name == key) {
+            return takeBuilt<T>(built, frame.role);
+        }
+    }
+
+    invalid(frame.role);
+}
+
+static bool hasMember(const Frame &frame, const char *key) {
+    for (const auto &member : frame.members) {
+        if (member.first == key) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename T, typename List = std::vector<T>>
+static List takeList(Frame &frame, const char *key) {
+    auto list = takeMember<std::unique_ptr<BuiltList>>(frame, key);
+    List values;
+    values.reserve(list->elements.size());
+
+    for (auto &element : list->elements) {
+        values.push_back(takeBuilt<T>(element, frame.role));
+    }
+
+    return values;
+}
+
+template <typename T>
+static T takeElement(Frame &frame, size_t index) {
+    if (frame.elements.size() != 2) {
+        invalid(frame.role);
+    }
+
+    return takeBuilt<T>(frame.elements[index], frame.role);
+}
+
+// Single-key objects such as {"BinOp": {...}} are tagged by their first key
+static std::pair<std::string, Built> &tagOf(Frame &frame) {
+    if (frame.members.empty()) {
+        invalid(frame.role);
+    }
+
+    return frame.members.front();
+}
+
+/* Assembling AST nodes from closed frames */
+
+static NodePtr<Place> assemblePlace(const std::string &tag, Built &value, Role role) {
+    switch (lookupTag(tag)) {
+        case Tag::ID:
+            return makeNode<Identifier>(takeBuilt<std::string>(value, role));
+        case Tag::DEREF:
+            return makeNode<Dereference>(takeBuilt<NodePtr<Expression>>(value, role));
+        case Tag::ARRAY_ACCESS:
+        case Tag::FIELD_ACCESS:
+            return takeBuilt<NodePtr<Place>>(value, role);
+        default:
+            throw std::runtime_error("JSON node is not a valid Place kind: " + tag);
+    }
+}
+
+static Built assembleType(Frame &frame) {
+    auto &[tag, value] = tagOf(frame);
+
+    switch (lookupTag(tag)) {
+        case Tag::STRUCT:
+            return TypeContext::global().structType(takeBuilt<std::string>(value, frame.role));
+        case Tag::PTR:
+            return TypeContext::global().pointerType(takeBuilt<std::shared_ptr<Type>>(value, frame.role));
+        case Tag::ARRAY:
+            return TypeContext::global().arrayType(takeBuilt<std::shared_ptr<Type>>(value, frame.role));
+        case Tag::FN:
+            return takeBuilt<std::shared_ptr<Type>>(value, frame.role);
+        case Tag::KEY_KIND:
+            switch (lookupTag(takeBuilt<std::string>(value, frame.role))) {
+                case Tag::INT:
+                    return TypeContext::global().intType();
+                case Tag::NIL:
+                    return TypeContext::global().nilType();
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+
+    invalid(frame.role);
+}
+
+static Built assembleExpression(Frame &frame) {
+    auto &[tag, value] = tagOf(frame);
+
+    switch (lookupTag(tag)) {
+        case Tag::NUM:
+            return makeNode<Number>(takeBuilt<long long>(value, frame.role));
+        case Tag::NIL:
+            return makeNode<Nil>();
+        case Tag::SELECT:
+        case Tag::UN_OP:
+        case Tag::BIN_OP:
+        case Tag::NEW_ARRAY:
+            return takeBuilt<NodePtr<Expression>>(value, frame.role);
+        case Tag::NEW_SINGLE:
+            return makeNode<NewSingleton>(takeBuilt<std::shared_ptr<Type>>(value, frame.role));
+        case Tag::CALL:
+            return makeNode<CallExpression>(takeBuilt<NodePtr<FunctionCall>>(value, frame.role));
+        case Tag::VAL:
+            return makeNode<Value>(takeBuilt<NodePtr<Place>>(value, frame.role));
+        case Tag::ID:
+        case Tag::DEREF:
+        case Tag::ARRAY_ACCESS:
+        case Tag::FIELD_ACCESS:
+            return makeNode<Value>(assemblePlace(tag, value, frame.role));
+        default:
+            throw std::runtime_error("Unknown/Unhandled expression kind: " + tag);
+    }
+}
+
+static Built assembleStatement(Frame &frame) {
+    auto &[tag, value] = tagOf(frame);
+
+    switch (lookupTag(tag)) {
+        case Tag::ASSIGN:
+        case Tag::IF:
+        case Tag::WHILE:
+        case Tag::STMTS:
+            return takeBuilt<NodePtr<Statement>>(value, frame.role);
+        case Tag::CALL:
+            return makeNode<CallStatement>(takeBuilt<NodePtr<FunctionCall>>(value, frame.role));
+        case Tag::RETURN: {
+            std::optional<NodePtr<Expression>> expression = std::nullopt;
+
+            if (!std::holds_alternative<std::monostate>(value)) {
+                expression = takeBuilt<NodePtr<Expression>>(value, frame.role);
+            }
+
+            return makeNode<Return>(std::move(expression));
+        }
+        default:
+            throw std::runtime_error("Unknown statement kind object: " + tag);
+    }
+}
+
+static Built assembleIf(Frame &frame) {
+    std::optional<NodePtr<Statement>> ff = std::nullopt;
+
+    for (auto &[name, built] : frame.members) {
+        if (name != "ff" || std::holds_alternative<std::monostate>(built)) {
+            continue;
+        }
+
+        auto statement = takeBuilt<NodePtr<Statement>>(built, frame.role);
+        bool emptyStatements = statement->kind == NodeKind::STATEMENTS && static_cast<const Statements*>(statement.get())->statements.empty();
+
+        if (!emptyStatements) {
+            ff = std::move(statement);
+        }
+    }
+
+    auto guard = takeMember<NodePtr<Expression>>(frame, "guard");
+    auto tt = takeMember<NodePtr<Statement>>(frame, "tt");
+    return makeNode<If>(std::move(guard), std::move(tt), std::move(ff));
+}
+
+static Built assembleFunction(Frame &frame) {
+    auto function = makeNode<FunctionDefinition>();
+    function->name = takeMember<std::string>(frame, "name");
+    function->params = takeList<Declaration, Variables>(frame, "prms");
+    function->returnType = takeMember<std::shared_ptr<Type>>(frame, "rettyp");
+    function->locals = takeList<Declaration, Variables>(frame, "locals");
+    function->body = takeMember<NodePtr<Statement>>(frame, "stmts");
+    return function;
+}
+
+static Built assembleExtern(Frame &frame) {
+    Extern e;
+    e.name = takeMember<std::string>(frame, "name");
+
+    auto builtType = takeMember<std::shared_ptr<Type>>(frame, "typ");
+
+    if (builtType->getTypeKind() == TypeKind::FUNCTION) {
+        const auto *funcType = static_cast<const FunctionType*>(builtType.get());
+        e.returnType = funcType->returnType;
+        e.paramTypes = funcType->paramTypes;
+    } else {
+        throw std::runtime_error("Invalid JSON for Extern definition: 'typ' field is not a function type (Fn)");
+    }
+
+    return e;
+}
+
+static Built assemble(Frame &frame) {
+    switch (frame.role) {
+        case Role::STRUCT_LIST:
+        case Role::EXTERN_LIST:
+        case Role::FUNCTION_LIST:
+        case Role::DECLARATION_LIST:
+        case Role::TYPE_LIST:
+        case Role::EXPRESSION_LIST:
+            return std::make_unique<BuiltList>(BuiltList{std::move(frame.elements)});
+
+        case Role::STATEMENT_LIST: {
+            auto statementsNode = makeNode<Statements>();
+
+            for (auto &element : frame.elements) {
+                statementsNode->statements.push_back(takeBuilt<NodePtr<Statement>>(element, frame.role));
+            }
+
+            return NodePtr<Statement>(std::move(statementsNode));
+        }
+
+        case Role::STRUCT: {
+            auto struc = makeNode<StructDefinition>();
+            struc->name = takeMember<std::string>(frame, "name");
+            struc->fields = takeList<Declaration, Fields>(frame, "fields");
+            return struc;
+        }
+
+        case Role::EXTERN:
+            return assembleExtern(frame);
+
+        case Role::FUNCTION:
+            return assembleFunction(frame);
+
+        case Role::DECLARATION: {
+            std::string name = takeMember<std::string>(frame, "name");
+            return Declaration(std::move(name), takeMember<std::shared_ptr<Type>>(frame, "typ"));
+        }
+
+        case Role::TYPE:
+            return assembleType(frame);
+
+        case Role::FUNCTION_SIGNATURE: {
+            auto params = takeElement<std::unique_ptr<BuiltList>>(frame, 0);
+            TypeList paramTypes;
+
+            for (auto &param : params->elements) {
+                paramTypes.push_back(takeBuilt<std::shared_ptr<Type>>(param, frame.role));
+            }
+
+            auto returnType = takeElement<std::shared_ptr<Type>>(frame, 1);
+            return TypeContext::global().functionType(paramTypes, returnType);
+        }
+
+        case Role::EXPRESSION:
+            return assembleExpression(frame);
+
+        case Role::PLACE: {
+            auto &[tag, value] = tagOf(frame);
+            return assemblePlace(tag, value, frame.role);
+        }
+
+        case Role::SELECT: {
+            auto guard = takeMember<NodePtr<Expression>>(frame, "guard");
+            auto tt = takeMember<NodePtr<Expression>>(frame, "tt");
+            auto ff = takeMember<NodePtr<Expression>>(frame, "ff");
+            return makeNode<Select>(std::move(guard), std::move(tt), std::move(ff));
+        }
+
+        case Role::UNARY_OPERATION: {
+            UnaryOperand operand = buildUnaryOperand(takeElement<std::string>(frame, 0));
+            return makeNode<UnaryOperation>(operand, takeElement<NodePtr<Expression>>(frame, 1));
+        }
+
+        case Role::BINARY_OPERATION: {
+            BinaryOperand operand = buildBinaryOperand(takeMember<std::string>(frame, "op"));
+            auto lhs = takeMember<NodePtr<Expression>>(frame, "left");
+            auto rhs = takeMember<NodePtr<Expression>>(frame, "right");
+            return makeNode<BinaryOperation>(operand, std::move(lhs), std::move(rhs));
+        }
+
+        case Role::NEW_ARRAY: {
+            auto type = takeElement<std::shared_ptr<Type>>(frame, 0);
+            auto sizeExp = takeElement<NodePtr<Expression>>(frame, 1);
+            return makeNode<NewArray>(std::move(type), std::move(sizeExp));
+        }
+
+        case Role::FUNCTION_CALL: {
+            auto callee = takeMember<NodePtr<Expression>>(frame, "callee");
+            auto args = takeList<NodePtr<Expression>, Arguments>(frame, "args");
+            return makeNode<FunctionCall>(std::move(callee), std::move(args));
+        }
+
+        case Role::ARRAY_ACCESS: {
+            auto array = takeMember<NodePtr<Expression>>(frame, "array");
+            auto index = takeMember<NodePtr<Expression>>(frame, "idx");
+            return NodePtr<Place>(makeNode<ArrayAccess>(std::move(array), std::move(index)));
+        }
+
+        case Role::FIELD_ACCESS: {
+            auto pointer = takeMember<NodePtr<Expression>>(frame, "ptr");
+            auto field = takeMember<std::string>(frame, "field");
+            return NodePtr<Place>(makeNode<FieldAccess>(std::move(pointer), std::move(field)));
+        }
+
+        case Role::STATEMENT:
+            return assembleStatement(frame);
+
+        case Role::ASSIGNMENT: {
+            auto place = takeElement<NodePtr<Place>>(frame, 0);
+            auto expression = takeElement<NodePtr<Expression>>(frame, 1);
+            return NodePtr<Statement>(makeNode<Assignment>(std::move(place), std::move(expression)));
+        }
+
+        case Role::IF:
+            return assembleIf(frame);
+
+        case Role::WHILE: {
+            auto guard = takeElement<NodePtr<Expression>>(frame, 0);
+            auto body = takeElement<NodePtr<Statement>>(frame, 1);
+            return NodePtr<Statement>(makeNode<While>(std::move(guard), std::move(body)));
+        }
+
+        case Role::IGNORED:
+            return std::monostate();
+
+        case Role::PROGRAM:
+        case Role::NAME:
+        case Role::NUMBER:
+            break;
+    }
+
+    invalid(frame.role);
+}
+
+static std::unique_ptr<Program> assembleProgram(Frame &frame) {
+    if (!hasMember(frame, "structs") || !hasMember(frame, "externs") || !hasMember(frame, "functions")) {
+        invalid(frame.role);
+    }
+
+    auto program = std::make_unique<Program>();
+    program->structs = takeList<NodePtr<StructDefinition>>(frame, "structs");
+    program->externs = takeList<Extern>(frame, "externs");
+    program->functions = takeList<NodePtr<FunctionDefinition>>(frame, "functions");
+    return program;
+}
+
+// SAX consumer for nlohmann::json::sax_parse that assembles the AST bottom-up
+class ProgramSaxHandler {
+public:
+    using json = nlohmann::json;
+
+    bool null() {
+        Role role = nextRole();
+
+        if (role != Role::EXPRESSION && role != Role::STATEMENT && role != Role::IGNORED) {
+            invalid(role);
+        }
+
+        deliver(std::monostate());
+        return true;
+    }
+
+    bool boolean(bool) {
+        return ignoredScalar();
+    }
+
+    bool number_integer(json::number_integer_t value) {
+        return number(static_cast<long long>(value));
+    }
+
+    bool number_unsigned(json::number_unsigned_t value) {
+        return number(static_cast<long long>(value));
+    }
+
+    bool number_float(json::number_float_t value, const json::string_t &) {
+        return number(static_cast<long long>(value));
+    }
+
+    bool string(json::string_t &value) {
+        Role role = nextRole();
+
+        switch (role) {
+            case Role::NAME:
+                deliver(std::move(value));
+                return true;
+
+            case Role::TYPE:
+                switch (lookupTag(value)) {
+                    case Tag::INT:
+                        deliver(TypeContext::global().intType());
+                        return true;
+                    case Tag::NIL:
+                        deliver(TypeContext::global().nilType());
+                        return true;
+                    default:
+                        throw std::runtime_error("Unknown simple type string: " + value);
+                }
+
+            case Role::EXPRESSION:
+                if (lookupTag(value) == Tag::NIL) {
+                    deliver(NodePtr<Expression>(makeNode<Nil>()));
+                    return true;
+                }
+
+                throw std::runtime_error("Invalid JSON for Exp: Must be non-empty object or known literal");
+
+            case Role::STATEMENT:
+                switch (lookupTag(value)) {
+                    case Tag::BREAK:
+                        deliver(NodePtr<Statement>(makeNode<Break>()));
+                        return true;
+                    case Tag::CONTINUE:
+                        deliver(NodePtr<Statement>(makeNode<Continue>()));
+                        return true;
+                    default:
+                        break;
+                }
+
+                throw std::runtime_error("Unknown simple string statement: " + value);
+
+            case Role::IGNORED:
+                deliver(std::monostate());
+                return true;
+
+            default:
+                invalid(role);
+        }
+    }
+
+    bool binary(json::binary_t &) {
+        return ignoredScalar();
+    }
+
+    bool start_object(std::size_t) {
+        open(true);
+        return true;
+    }
+
+    bool key(json::string_t &value) {
+        stack.back().key = std::move(value);
+        return true;
+    }
+
+    bool end_object() {
+        close();
+        return true;
+    }
+
+    bool start_array(std::size_t) {
+        open(false);
+        return true;
+    }
+
+    bool end_array() {
+        close();
+        return true;
+    }
+
+    template <class Exception>
+    bool parse_error(std::size_t, const std::string &, const Exception &ex) {
+        throw ex;
+    }
+
+    std::unique_ptr<Program> takeProgram() {
+        if (!program) {
+            invalid(Role::PROGRAM);
+        }
+
+        return std::move(program);
+    }
+
+private:
+    std::vector<Frame> stack;
+    std::unique_ptr<Program> program;
+
+    Role nextRole() const {
+        if (stack.empty()) {
+            return Role::PROGRAM;
+        }
+
+        const Frame &top = stack.back();
+
+        if (top.isObject) {
+            return memberRole(top.role, top.key);
+        }
+
+        return elementRole(top.role, top.elements.size());
+    }
+
+    bool number(long long value) {
+        Role role = nextRole();
+
+        if (role == Role::NUMBER) {
+            deliver(value);
+        } else if (role == Role::IGNORED) {
+            deliver(std::monostate());
+        } else {
+            invalid(role);
+        }
+
+        return true;
+    }
+
+    bool ignoredScalar() {
+        Role role = nextRole();
+
+        if (role != Role::IGNORED) {
+            invalid(role);
+        }
+
+        deliver(std::monostate());
+        return true;
+    }
+
+    void open(bool isObject) {
+        Role role = nextRole();
+
+        // A bare array in statement position is a statement block
+        if (role == Role::STATEMENT && !isObject) {
+            role = Role::STATEMENT_LIST;
+        }
+
+        if (role != Role::IGNORED && isArrayRole(role) == isObject) {
+            invalid(role);
+        }
+
+        stack.push_back(Frame{role, isObject, {}, {}, {}});
+    }
+
+    void close() {
+        Frame frame = std::move(stack.back());
+        stack.pop_back();
+
+        if (stack.empty()) {
+            program = assembleProgram(frame);
+            return;
+        }
+
+        deliver(assemble(frame));
+    }
+
+    // Every value passes through here, so this is where the memory limit is polled
+    void deliver(Built built) {
+        memory::checkLimit();
+
+        if (stack.empty()) {
+            invalid(Role::PROGRAM);
+        }
+
+        Frame &top = stack.back();
+
+        if (top.isObject) {
+            top.members.emplace_back(std::move(top.key), std::move(built));
+        } else {
+            top.elements.push_back(std::move(built));
+        }
+    }
+};
+
+} // namespace
+
+// Runs the SAX parse of input (a stream or an iterator range) into a Program
+template <typename... Input>
+static std::unique_ptr<Program> buildFromSax(Input &&...input) {
+    // Nodes are placed in the program's arena as they are assembled
+    auto arena = std::make_unique<Arena>();
+    Arena::Scope arenaScope(*arena);
+
+    ProgramSaxHandler handler;
+    // Non-strict, like operator>>, so trailing input after the root value is ignored
+    nlohmann::json::sax_parse(std::forward<Input>(input)..., &handler, nlohmann::json::input_format_t::json, false);
+
+    auto program = handler.takeProgram();
+    program->arena = std::move(arena);
+    return program;
+}
+
+std::unique_ptr<Program> buildProgramStreaming(std::istream &input) {
+    return buildFromSax(input);
+}
+
+std::unique_ptr<Program> buildProgramStreaming(std::string_view input) {
+    return buildFromSax(input.data(), input.data() + input.size());
+}
@@ -0,0 +1,16 @@
+#ifndef SAX_BUILDER_HPP
+#define SAX_BUILDER_HPP
+
+#include <istream>
+#include <string_view>
+
+#include "ast.hpp"
+
+// Builds a Program straight from the JSON byte stream using SAX events, so the
+// nlohmann::json DOM is never materialised. The buildX(const nlohmann::json&)
+// functions in builder.hpp remain available as the DOM-based fallback.
+extern std::unique_ptr<Program> buildProgramStreaming(std::istream &input);
+// Same, parsing directly from a contiguous buffer such as a mapped InputBuffer
+extern std::unique_ptr<Program> buildProgramStreaming(std::string_view input);
+
+#endif
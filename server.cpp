@@ -0,0 +1,465 @@
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.hpp"
+#include "check.hpp"
+#include "threadpool.hpp"
+
+static volatile std::sig_atomic_t stopRequested = 0;
+// The write end of a pipe that the loop polls. A signal that lands between
+// the loop's check of stopRequested and its call to poll, or on another
+// thread, would not interrupt poll; a byte in the pipe wakes it either way.
+static volatile std::sig_atomic_t stopPipe = -1;
+
+static void requestStop(int) {
+    int savedErrno = errno;
+    stopRequested = 1;
+
+    if (stopPipe >= 0 && write(stopPipe, "", 1) < 0) {
+        // Full already, so the loop is woken anyway
+    }
+
+    errno = savedErrno;
+}
+
+static CheckResult checkRequest(const std::string &line, const CheckOptions &options) {
+    if (line[line.find_first_not_of(" \t")] == '{') {
+        return checkContents(line, options);
+    }
+
+    return checkFile(line, options);
+}
+
+// ERROR messages already read "Error: ...", which the "error: " prefix replaces
+static std::string response(const CheckResult &result) {
+    if (result.kind == CheckResult::Kind::VALID || result.kind == CheckResult::Kind::INVALID) {
+        return result.message + "\n";
+    }
+
+    std::string_view message = result.message;
+
+    if (message.starts_with("Error: ")) {
+        message.remove_prefix(7);
+    }
+
+    return "error: " + std::string(message) + "\n";
+}
+
+// A line longer than this without a newline drops the client, so one that
+// never sends one cannot grow its buffer without bound
+static constexpr size_t MAX_REQUEST_BYTES = 256 * 1024 * 1024;
+
+namespace {
+
+struct Client {
+    uint64_t id;
+    int fd;
+    std::string input;
+    std::string output;
+    bool readClosed = false;
+    bool failed = false;
+
+    // Requests are numbered as they arrive; responses are sent in that order,
+    // holding back any that finish before the ones ahead of them
+    uint64_t requestsReceived = 0;
+    uint64_t responsesSent = 0;
+    std::map<uint64_t, std::string> finished;
+};
+
+// A complete request line, waiting to be checked
+struct Request {
+    uint64_t client;
+    uint64_t sequence;
+    std::string line;
+};
+
+// A response, on its way back to the client that sent the request
+struct Response {
+    uint64_t client;
+    uint64_t sequence;
+    std::string text;
+};
+
+// Checks requests off the poll thread, so one large program never holds up
+// reading, writing or the other clients' checks. Each request is checked on
+// one worker; finished responses are queued and the loop is woken through
+// an eventfd to pick them up.
+class CheckWorkers {
+public:
+    CheckWorkers(unsigned threads, const CheckOptions &options) : options(options) {
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back(&CheckWorkers::workerLoop, this);
+        }
+    }
+
+    // Requests still queued are dropped; those being checked are finished first
+    ~CheckWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wakeWorkers.notify_all();
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        close(wakeFd);
+    }
+
+    CheckWorkers(const CheckWorkers &) = delete;
+    CheckWorkers &operator=(const CheckWorkers &) = delete;
+
+    // Readable whenever responses are waiting in takeResponses
+    int fd() const {
+        return wakeFd;
+    }
+
+    void submit(Request request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(std::move(request));
+        }
+
+        wakeWorkers.notify_one();
+    }
+
+    void takeResponses(std::vector<Response> &out) {
+        uint64_t count;
+
+        while (read(wakeFd, &count, sizeof(count)) < 0 && errno == EINTR) {}
+
+        std::lock_guard<std::mutex> lock(mutex);
+        out.swap(responses);
+        responses.clear();
+    }
+
+private:
+    void workerLoop() {
+        while (true) {
+            Request request;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeWorkers.wait(lock, [this] { return stopping || !requests.empty(); });
+
+                if (stopping) {
+                    return;
+                }
+
+                request = std::move(requests.front());
+                requests.pop_front();
+            }
+
+            std::string text = response(checkRequest(request.line, options));
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                responses.push_back({request.client, request.sequence, std::move(text)});
+            }
+
+            uint64_t one = 1;
+
+            while (write(wakeFd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+        }
+    }
+
+    CheckOptions options;
+    int wakeFd;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::deque<Request> requests;
+    std::vector<Response> responses;
+    bool stopping = false;
+};
+
+}
+
+// Reads whatever the client has sent and queues its complete lines
+static void readRequests(Client &client, CheckWorkers &workers) {
+    char buffer[64 * 1024];
+
+    while (client.input.size() <= MAX_REQUEST_BYTES) {
+        ssize_t count = read(client.fd, buffer, sizeof(buffer));
+
+        if (count > 0) {
+            client.input.append(buffer, count);
+        } else if (count == 0) {
+            client.readClosed = true;
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                client.failed = true;
+            }
+
+            break;
+        }
+    }
+
+    size_t start = 0;
+
+    for (size_t newline; (newline = client.input.find('\n', start)) != std::string::npos; start = newline + 1) {
+        std::string line = client.input.substr(start, newline - start);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (line.find_first_not_of(" \t") != std::string::npos) {
+            workers.submit({client.id, client.requestsReceived++, std::move(line)});
+        }
+    }
+
+    client.input.erase(0, start);
+
+    // What is left is the start of a line, and one this long is not a request
+    if (client.input.size() > MAX_REQUEST_BYTES) {
+        std::cerr << "Dropping a client whose request is over " << MAX_REQUEST_BYTES << " bytes." << std::endl;
+        client.failed = true;
+        return;
+    }
+
+    // A last request without a trailing newline still counts once the client stops sending
+    if (client.readClosed && client.input.find_first_not_of(" \t\r") != std::string::npos) {
+        workers.submit({client.id, client.requestsReceived++, std::move(client.input)});
+        client.input.clear();
+    }
+}
+
+// Queues a finished response, then every response it was holding back
+static void deliverResponse(Client &client, Response &response) {
+    client.finished.emplace(response.sequence, std::move(response.text));
+
+    while (!client.finished.empty() && client.finished.begin()->first == client.responsesSent) {
+        client.output += client.finished.begin()->second;
+        client.finished.erase(client.finished.begin());
+        client.responsesSent++;
+    }
+}
+
+// Sends as much of the pending output as the socket takes without blocking
+static void writeResponses(Client &client) {
+    while (!client.output.empty()) {
+        ssize_t count = send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL);
+
+        if (count >= 0) {
+            client.output.erase(0, count);
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                client.failed = true;
+            }
+
+            break;
+        }
+    }
+}
+
+static int openListener(const std::string &socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path " << socketPath << " is too long." << std::endl;
+        return -1;
+    }
+
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        std::cerr << "Could not create socket: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+
+    // A socket file left behind by an earlier server would make bind fail.
+    // Only a socket is removed; anything else at the path is left alone.
+    struct stat info;
+
+    if (lstat(socketPath.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            std::cerr << "Could not listen on " << socketPath << ": it exists and is not a socket." << std::endl;
+            close(fd);
+            return -1;
+        }
+
+        unlink(socketPath.c_str());
+    } else if (errno != ENOENT) {
+        std::cerr << "Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        std::cerr << "Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int runServer(const std::string &socketPath, const CheckOptions &options) {
+    int listener = openListener(socketPath);
+
+    if (listener < 0) {
+        return 1;
+    }
+
+    int stopFds[2];
+
+    if (pipe2(stopFds, O_NONBLOCK | O_CLOEXEC) < 0) {
+        std::cerr << "Could not create pipe: " << std::strerror(errno) << std::endl;
+        close(listener);
+        return 1;
+    }
+
+    stopPipe = stopFds[1];
+
+    struct sigaction action{};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    // --jobs N checks up to N requests at once, each on a single thread, so
+    // a large program only ever occupies one of them
+    CheckOptions serialOptions = options;
+    serialOptions.pool = nullptr;
+    CheckWorkers workers(options.pool ? options.pool->size() : 1, serialOptions);
+
+    if (workers.fd() < 0) {
+        std::cerr << "Could not create eventfd: " << std::strerror(errno) << std::endl;
+        stopPipe = -1;
+        close(stopFds[0]);
+        close(stopFds[1]);
+        close(listener);
+        return 1;
+    }
+
+    std::vector<Client> clients;
+    std::vector<pollfd> pollFds;
+    std::vector<Response> responses;
+    uint64_t nextClientId = 0;
+
+    while (!stopRequested) {
+        pollFds.clear();
+        pollFds.push_back({listener, POLLIN, 0});
+        pollFds.push_back({workers.fd(), POLLIN, 0});
+        pollFds.push_back({stopFds[0], POLLIN, 0});
+
+        for (const Client &client : clients) {
+            short events = client.readClosed ? 0 : POLLIN;
+
+            if (!client.output.empty()) {
+                events |= POLLOUT;
+            }
+
+            pollFds.push_back({client.fd, events, 0});
+        }
+
+        if (poll(pollFds.data(), pollFds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            std::cerr << "poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        for (size_t i = 0; i < clients.size(); i++) {
+            short revents = pollFds[i + 3].revents;
+
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                readRequests(clients[i], workers);
+            }
+        }
+
+        // Clients are few, so each response finds its own with a scan; one
+        // that has gone since sending the request is simply not answered
+        if (pollFds[1].revents & POLLIN) {
+            workers.takeResponses(responses);
+
+            for (Response &response : responses) {
+                for (Client &client : clients) {
+                    if (client.id == response.client) {
+                        deliverResponse(client, response);
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Drop clients that are gone, or have hung up and been sent every response
+        size_t kept = 0;
+
+        for (Client &client : clients) {
+            writeResponses(client);
+
+            bool answered = client.responsesSent == client.requestsReceived && client.output.empty();
+
+            if (client.failed || (client.readClosed && answered)) {
+                close(client.fd);
+            } else {
+                if (&clients[kept] != &client) {
+                    clients[kept] = std::move(client);
+                }
+
+                kept++;
+            }
+        }
+
+        clients.erase(clients.begin() + kept, clients.end());
+
+        if (pollFds[0].revents & POLLIN) {
+            while (true) {
+                int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+                if (fd < 0) {
+                    break;
+                }
+
+                Client &client = clients.emplace_back();
+                client.id = nextClientId++;
+                client.fd = fd;
+            }
+        }
+    }
+
+    for (const Client &client : clients) {
+        close(client.fd);
+    }
+
+    stopPipe = -1;
+    close(stopFds[0]);
+    close(stopFds[1]);
+    close(listener);
+    unlink(socketPath.c_str());
+    return 0;
+}
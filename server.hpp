@@ -0,0 +1,18 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <string>
+
+#include "check.hpp"
+
+// Serves check requests on a Unix socket until SIGINT or SIGTERM (--serve).
+// Clients send one request per line: either the path of an .astj file or a
+// whole program as single-line JSON (a line starting with '{'). Each request
+// gets one response line, in request order: "valid", "invalid: <message>"
+// or "error: <message>". Checks run on --jobs worker threads, one request
+// per thread, while the loop keeps reading and writing, so a large program
+// delays no other client's response. The process keeps its interned types,
+// symbols and threads between requests. Returns the exit status.
+int runServer(const std::string &socketPath, const CheckOptions &options);
+
+#endif
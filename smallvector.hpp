@@ -0,0 +1,230 @@
+#ifndef SMALLVECTOR_HPP
+#define SMALLVECTOR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+
+// A vector whose first N elements live inside the object itself, so short
+// lists (most call arguments, parameters, fields and blocks) cost no heap
+// allocation of their own; a node in an arena carries them in the arena too.
+// Past N it moves everything to the heap and grows like std::vector. Offers
+// the subset of std::vector the AST uses, with pointers as iterators.
+template <typename T, size_t N>
+class SmallVector {
+    static_assert(N > 0, "use std::vector for lists with no inline storage");
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    SmallVector() = default;
+
+    explicit SmallVector(size_t count) {
+        resize(count);
+    }
+
+    SmallVector(std::initializer_list<T> items) : SmallVector(items.begin(), items.end()) {}
+
+    template <std::input_iterator Iterator>
+    SmallVector(Iterator first, Iterator last) {
+        if constexpr (std::forward_iterator<Iterator>) {
+            reserve(std::distance(first, last));
+        }
+
+        for (; first != last; ++first) {
+            emplace_back(*first);
+        }
+    }
+
+    SmallVector(const SmallVector &other) : SmallVector(other.begin(), other.end()) {}
+
+    SmallVector(SmallVector &&other) noexcept {
+        take(other);
+    }
+
+    SmallVector &operator=(const SmallVector &other) {
+        if (this != &other) {
+            clear();
+            reserve(other.count);
+
+            for (const T &item : other) {
+                emplace_back(item);
+            }
+        }
+
+        return *this;
+    }
+
+    SmallVector &operator=(SmallVector &&other) noexcept {
+        if (this != &other) {
+            clear();
+            release();
+            take(other);
+        }
+
+        return *this;
+    }
+
+    ~SmallVector() {
+        clear();
+        release();
+    }
+
+    /* Access */
+
+    size_t size() const { return count; }
+    size_t capacity() const { return limit; }
+    bool empty() const { return count == 0; }
+
+    T *data() { return items; }
+    const T *data() const { return items; }
+
+    iterator begin() { return items; }
+    iterator end() { return items + count; }
+    const_iterator begin() const { return items; }
+    const_iterator end() const { return items + count; }
+
+    std::reverse_iterator<iterator> rbegin() { return std::reverse_iterator<iterator>(end()); }
+    std::reverse_iterator<iterator> rend() { return std::reverse_iterator<iterator>(begin()); }
+    std::reverse_iterator<const_iterator> rbegin() const { return std::reverse_iterator<const_iterator>(end()); }
+    std::reverse_iterator<const_iterator> rend() const { return std::reverse_iterator<const_iterator>(begin()); }
+
+    T &operator[](size_t index) { return items[index]; }
+    const T &operator[](size_t index) const { return items[index]; }
+
+    T &front() { return items[0]; }
+    const T &front() const { return items[0]; }
+    T &back() { return items[count - 1]; }
+    const T &back() const { return items[count - 1]; }
+
+    /* Modifiers */
+
+    void reserve(size_t capacity) {
+        if (capacity > limit) {
+            reallocate(capacity);
+        }
+    }
+
+    template <typename... Args>
+    T &emplace_back(Args &&...args) {
+        if (count == limit) {
+            // Built first, since args may refer to an element about to move
+            T item(std::forward<Args>(args)...);
+            reallocate(std::max<size_t>(limit * 2, count + 1));
+            return *new (items + count++) T(std::move(item));
+        }
+
+        return *new (items + count++) T(std::forward<Args>(args)...);
+    }
+
+    void push_back(const T &item) {
+        emplace_back(item);
+    }
+
+    void push_back(T &&item) {
+        emplace_back(std::move(item));
+    }
+
+    void pop_back() {
+        items[--count].~T();
+    }
+
+    iterator insert(const_iterator position, T item) {
+        size_t index = position - items;
+        emplace_back(std::move(item));
+        std::rotate(items + index, items + count - 1, items + count);
+        return items + index;
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        T *from = items + (first - items);
+        T *tail = std::move(items + (last - items), end(), from);
+        std::destroy(tail, end());
+        count = tail - items;
+        return from;
+    }
+
+    iterator erase(const_iterator position) {
+        return erase(position, position + 1);
+    }
+
+    void resize(size_t size) {
+        if (size < count) {
+            std::destroy(items + size, end());
+        } else {
+            reserve(size);
+            std::uninitialized_value_construct(items + count, items + size);
+        }
+
+        count = size;
+    }
+
+    void clear() {
+        std::destroy(begin(), end());
+        count = 0;
+    }
+
+    friend bool operator==(const SmallVector &lhs, const SmallVector &rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+private:
+    T *inlineItems() {
+        return reinterpret_cast<T *>(storage);
+    }
+
+    bool onHeap() const {
+        return items != reinterpret_cast<const T *>(storage);
+    }
+
+    void reallocate(size_t capacity) {
+        T *moved = static_cast<T *>(::operator new(capacity * sizeof(T)));
+        std::uninitialized_move(begin(), end(), moved);
+        std::destroy(begin(), end());
+        release();
+        items = moved;
+        limit = capacity;
+    }
+
+    // Frees the heap block, if any, leaving the (already empty) inline storage in use
+    void release() {
+        if (onHeap()) {
+            ::operator delete(items);
+            items = inlineItems();
+            limit = N;
+        }
+    }
+
+    // Takes other's elements, stealing its heap block or moving its inline
+    // items one by one, and leaves it empty
+    void take(SmallVector &other) {
+        if (other.onHeap()) {
+            items = other.items;
+            limit = other.limit;
+            other.items = other.inlineItems();
+            other.limit = N;
+        } else {
+            std::uninitialized_move(other.begin(), other.end(), items);
+            std::destroy(other.begin(), other.end());
+        }
+
+        count = other.count;
+        other.count = 0;
+    }
+
+    alignas(T) std::byte storage[N * sizeof(T)];
+    T *items = inlineItems();
+    uint32_t count = 0;
+    uint32_t limit = N;
+};
+
+#endif
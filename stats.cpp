@@ -0,0 +1,160 @@
+#include "stats.hpp"
+
+#include <vector>
+#include <sys/resource.h>
+
+#include "ast.hpp"
+#include "memory.hpp"
+#include "symbols.hpp"
+#include "traversal.hpp"
+#include "types.hpp"
+
+namespace stats {
+
+bool enabledFlag = false;
+
+static constexpr size_t PHASE_COUNT = static_cast<size_t>(Phase::COUNT);
+static constexpr size_t KIND_COUNT = static_cast<size_t>(NodeKind::PROGRAM) + 1;
+
+static std::atomic<uint64_t> phaseNanoseconds[PHASE_COUNT];
+static std::atomic<uint64_t> phasePeakBytes[PHASE_COUNT];
+static std::atomic<uint64_t> nodeCounts[KIND_COUNT];
+
+#ifdef CFLAT_STATS
+CounterSlot counters[static_cast<size_t>(Counter::COUNT)];
+#endif
+
+static const char *phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::READ: return "read";
+        case Phase::PARSE: return "parse";
+        case Phase::BUILD: return "build";
+        case Phase::GAMMA: return "gamma";
+        case Phase::DELTA: return "delta";
+        case Phase::STRUCTS: return "structs";
+        case Phase::SIGNATURES: return "signatures";
+        case Phase::FUNCTIONS: return "functions";
+        case Phase::COUNT: break;
+    }
+
+    return "unknown";
+}
+
+static const char *nodeKindName(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::DECLARATION: return "Declaration";
+        case NodeKind::VALUE: return "Value";
+        case NodeKind::NUMBER: return "Number";
+        case NodeKind::NIL: return "Nil";
+        case NodeKind::SELECT: return "Select";
+        case NodeKind::UNARY_OPERATION: return "UnaryOperation";
+        case NodeKind::BINARY_OPERATION: return "BinaryOperation";
+        case NodeKind::NEW_SINGLETON: return "NewSingleton";
+        case NodeKind::NEW_ARRAY: return "NewArray";
+        case NodeKind::CALL_EXPRESSION: return "CallExpression";
+        case NodeKind::IDENTIFIER: return "Identifier";
+        case NodeKind::DEREFERENCE: return "Dereference";
+        case NodeKind::ARRAY_ACCESS: return "ArrayAccess";
+        case NodeKind::FIELD_ACCESS: return "FieldAccess";
+        case NodeKind::FUNCTION_CALL: return "FunctionCall";
+        case NodeKind::STATEMENTS: return "Statements";
+        case NodeKind::ASSIGNMENT: return "Assignment";
+        case NodeKind::CALL_STATEMENT: return "CallStatement";
+        case NodeKind::IF: return "If";
+        case NodeKind::WHILE: return "While";
+        case NodeKind::BREAK: return "Break";
+        case NodeKind::CONTINUE: return "Continue";
+        case NodeKind::RETURN: return "Return";
+        case NodeKind::STRUCT_DEFINITION: return "StructDefinition";
+        case NodeKind::EXTERN: return "Extern";
+        case NodeKind::FUNCTION_DEFINITION: return "FunctionDefinition";
+        case NodeKind::PROGRAM: return "Program";
+    }
+
+    return "unknown";
+}
+
+#ifdef CFLAT_STATS
+static const char *counterName(Counter counter) {
+    switch (counter) {
+        case Counter::TYPES_EQUAL: return "typesEqual";
+        case Counter::SYMBOL_LOOKUPS: return "symbolLookups";
+        case Counter::ALLOCATIONS: return "allocations";
+        case Counter::ALLOCATED_BYTES: return "allocatedBytes";
+        case Counter::MAX_WALK_DEPTH: return "maxWalkDepth";
+        case Counter::COUNT: break;
+    }
+
+    return "unknown";
+}
+#endif
+
+void enable() {
+    enabledFlag = true;
+    memory::track();
+}
+
+void addPhaseTime(Phase phase, std::chrono::nanoseconds elapsed) {
+    phaseNanoseconds[static_cast<size_t>(phase)].fetch_add(elapsed.count(), std::memory_order_relaxed);
+}
+
+void addPhasePeak(Phase phase, size_t bytes) {
+    std::atomic<uint64_t> &slot = phasePeakBytes[static_cast<size_t>(phase)];
+    uint64_t current = slot.load(std::memory_order_relaxed);
+
+    while (bytes > current && !slot.compare_exchange_weak(current, bytes, std::memory_order_relaxed)) {
+    }
+}
+
+void countNodes(Node &root) {
+    uint64_t counts[KIND_COUNT] = {};
+    std::vector<Node *> pending{&root};
+
+    while (!pending.empty()) {
+        Node *node = pending.back();
+        pending.pop_back();
+        counts[static_cast<size_t>(node->kind)]++;
+        collectChildren(*node, pending);
+    }
+
+    for (size_t i = 0; i < KIND_COUNT; i++) {
+        if (counts[i]) {
+            nodeCounts[i].fetch_add(counts[i], std::memory_order_relaxed);
+        }
+    }
+}
+
+void report(std::ostream &out) {
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        uint64_t nanoseconds = phaseNanoseconds[i].load(std::memory_order_relaxed);
+        uint64_t peakBytes = phasePeakBytes[i].load(std::memory_order_relaxed);
+        out << "{\"phase\": \"" << phaseName(static_cast<Phase>(i)) << "\", \"ms\": " << nanoseconds / 1e6
+            << ", \"peakBytes\": " << peakBytes << "}\n";
+    }
+
+    // The heap (with mapped inputs) as counted since --stats, and the whole process as the kernel saw it
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    out << "{\"memory\": \"heapPeak\", \"bytes\": " << memory::peak() << "}\n";
+    out << "{\"memory\": \"rssPeak\", \"bytes\": " << static_cast<uint64_t>(usage.ru_maxrss) * 1024 << "}\n";
+
+    // What the process has interned, which it keeps until it exits
+    out << "{\"interned\": \"symbols\", \"count\": " << SymbolTable::global().size() << "}\n";
+    out << "{\"interned\": \"types\", \"count\": " << TypeContext::global().size() << "}\n";
+
+    for (size_t i = 0; i < KIND_COUNT; i++) {
+        uint64_t count = nodeCounts[i].load(std::memory_order_relaxed);
+        out << "{\"nodes\": \"" << nodeKindName(static_cast<NodeKind>(i)) << "\", \"count\": " << count << "}\n";
+    }
+
+#ifdef CFLAT_STATS
+    for (size_t i = 0; i < static_cast<size_t>(Counter::COUNT); i++) {
+        uint64_t value = counters[i].value.load(std::memory_order_relaxed);
+        out << "{\"counter\": \"" << counterName(static_cast<Counter>(i)) << "\", \"value\": " << value << "}\n";
+    }
+#endif
+
+    out.flush();
+}
+
+} // namespace stats
@@ -0,0 +1,124 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+
+#include "memory.hpp"
+
+struct Node;
+
+// Instrumentation behind --stats, reported as JSON lines once the run is over.
+// Phase timers, peak bytes per phase and node counts cost one branch on a flag
+// unless --stats is given. Counters on hot paths (typesEqual, symbol lookups, allocations, walk
+// depth) are only compiled in with -DCFLAT_STATS (make STATS=1); otherwise
+// they expand to nothing and are left out of the report.
+namespace stats {
+
+enum class Phase {
+    READ,
+    PARSE,
+    BUILD,
+    GAMMA,
+    DELTA,
+    STRUCTS,
+    SIGNATURES,
+    FUNCTIONS,
+    COUNT,
+};
+
+enum class Counter {
+    TYPES_EQUAL,
+    SYMBOL_LOOKUPS,
+    ALLOCATIONS,
+    ALLOCATED_BYTES,
+    MAX_WALK_DEPTH,
+    COUNT,
+};
+
+#ifdef CFLAT_STATS
+inline constexpr bool COUNTERS = true;
+#else
+inline constexpr bool COUNTERS = false;
+#endif
+
+// Set once by --stats, before any input is read
+extern bool enabledFlag;
+
+inline bool enabled() {
+    return enabledFlag;
+}
+
+void enable();
+
+// Adds to a phase's total; phases are summed over every input and thread
+void addPhaseTime(Phase phase, std::chrono::nanoseconds elapsed);
+
+// Keeps the largest peak seen for a phase: the most any one timed run of it
+// held at once on its thread, above what that thread already held
+void addPhasePeak(Phase phase, size_t bytes);
+
+// Tallies every node of the tree under root by kind
+void countNodes(Node &root);
+
+// Writes one JSON object per line: phases, peak memory, node kinds, then counters
+void report(std::ostream &out);
+
+// Times a scope into phase, and measures its peak bytes, when --stats is on
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase phase) : phase(phase), running(enabled()) {
+        if (running) {
+            peak.emplace();
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~PhaseTimer() {
+        if (running) {
+            addPhaseTime(phase, std::chrono::steady_clock::now() - start);
+            addPhasePeak(phase, peak->finish());
+        }
+    }
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+    Phase phase;
+    bool running;
+    std::optional<memory::PeakScope> peak;
+    std::chrono::steady_clock::time_point start;
+};
+
+#ifdef CFLAT_STATS
+// Each counter on its own cache line, since --jobs threads bump them all at once
+struct alignas(64) CounterSlot {
+    std::atomic<uint64_t> value{0};
+};
+
+extern CounterSlot counters[static_cast<size_t>(Counter::COUNT)];
+
+inline void count(Counter counter, uint64_t amount = 1) {
+    counters[static_cast<size_t>(counter)].value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+inline void countMax(Counter counter, uint64_t value) {
+    std::atomic<uint64_t> &slot = counters[static_cast<size_t>(counter)].value;
+    uint64_t current = slot.load(std::memory_order_relaxed);
+
+    while (value > current && !slot.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+#else
+inline void count(Counter, uint64_t = 1) {}
+inline void countMax(Counter, uint64_t) {}
+#endif
+
+} // namespace stats
+
+#endif
@@ -0,0 +1,65 @@
+#include "structtable.hpp"
+#include "types.hpp"
+
+void StructTable::addStruct(Symbol name) {
+    pendingNames.emplace_back(name, static_cast<uint32_t>(layouts.size()));
+    layouts.push_back({static_cast<uint32_t>(fieldNames.size()), 0});
+}
+
+void StructTable::addField(Symbol name, std::shared_ptr<Type> type) {
+    fieldNames.push_back(name);
+    fieldTypes.push_back(std::move(type));
+    layouts.back().count++;
+}
+
+void StructTable::finish() {
+    layoutsByName = SymbolMap<uint32_t>(std::move(pendingNames));
+    pendingNames.clear();
+
+    for (size_t i = 0; i < layouts.size(); i++) {
+        const Layout &layout = layouts[i];
+
+        if (layout.count <= LINEAR_SEARCH_LIMIT) {
+            continue;
+        }
+
+        // Assigned front to back, so a repeated name keeps its last position
+        for (uint32_t j = 0; j < layout.count; j++) {
+            wideFields[wideKey(i, fieldNames[layout.offset + j])] = j;
+        }
+    }
+}
+
+const StructTable::Layout *StructTable::find(Symbol structName) const {
+    const uint32_t *index = layoutsByName.find(structName);
+    return index ? &layouts[*index] : nullptr;
+}
+
+ptrdiff_t StructTable::fieldIndex(const Layout &layout, Symbol fieldName) const {
+    if (layout.count <= LINEAR_SEARCH_LIMIT) {
+        const Symbol *names = fieldNames.data() + layout.offset;
+
+        for (size_t j = layout.count; j-- > 0;) {
+            if (names[j] == fieldName) {
+                return static_cast<ptrdiff_t>(j);
+            }
+        }
+
+        return -1;
+    }
+
+    auto it = wideFields.find(wideKey(&layout - layouts.data(), fieldName));
+    return it != wideFields.end() ? static_cast<ptrdiff_t>(it->second) : -1;
+}
+
+Symbol StructTable::fieldName(const Layout &layout, size_t index) const {
+    return fieldNames[layout.offset + index];
+}
+
+const std::shared_ptr<Type> &StructTable::fieldType(const Layout &layout, size_t index) const {
+    return fieldTypes[layout.offset + index];
+}
+
+uint64_t StructTable::wideKey(uint32_t layoutIndex, Symbol fieldName) {
+    return static_cast<uint64_t>(layoutIndex) << 32 | fieldName;
+}
@@ -0,0 +1,58 @@
+#ifndef STRUCT_TABLE_HPP
+#define STRUCT_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "symbols.hpp"
+
+struct Type;
+
+// Every struct's fields, laid out back to back in one contiguous array: each
+// struct owns the run [offset, offset + count). Field names and types are kept
+// in parallel arrays so a struct's names can be scanned without touching the
+// types. Narrow structs are searched linearly; structs wider than
+// LINEAR_SEARCH_LIMIT also get an entry in one shared hash index.
+class StructTable {
+public:
+    static constexpr size_t LINEAR_SEARCH_LIMIT = 16;
+
+    struct Layout {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // Starts a struct; its fields are then appended in order with addField
+    void addStruct(Symbol name);
+    void addField(Symbol name, std::shared_ptr<Type> type);
+
+    // Builds the lookup indexes, after the last struct has been added
+    void finish();
+
+    // A later struct with the same name replaces an earlier one for lookups
+    const Layout *find(Symbol structName) const;
+
+    // Position of the field within its struct's run, or -1 if it has none by
+    // that name. A repeated field name resolves to its last occurrence.
+    ptrdiff_t fieldIndex(const Layout &layout, Symbol fieldName) const;
+    Symbol fieldName(const Layout &layout, size_t index) const;
+    const std::shared_ptr<Type> &fieldType(const Layout &layout, size_t index) const;
+
+private:
+    static uint64_t wideKey(uint32_t layoutIndex, Symbol fieldName);
+
+    std::vector<Layout> layouts;
+    std::vector<SymbolMap<uint32_t>::Entry> pendingNames;
+    SymbolMap<uint32_t> layoutsByName;
+
+    std::vector<Symbol> fieldNames;
+    std::vector<std::shared_ptr<Type>> fieldTypes;
+
+    // (layout index, field name) -> field position, for wide structs only
+    std::unordered_map<uint64_t, uint32_t> wideFields;
+};
+
+#endif
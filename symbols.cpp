@@ -0,0 +1,53 @@
+#include "symbols.hpp"
+
+SymbolTable &SymbolTable::global() {
+    static SymbolTable table;
+    return table;
+}
+
+namespace {
+
+// The names one thread has interned, keyed by views of the table's own copies
+struct ThreadSymbols {
+    const SymbolTable *table = nullptr;
+    std::unordered_map<std::string_view, Symbol> symbols;
+};
+
+}
+
+static thread_local ThreadSymbols threadSymbols;
+
+Symbol SymbolTable::intern(std::string_view text) {
+    ThreadSymbols &local = threadSymbols;
+
+    if (local.table != this) {
+        local.table = this;
+        local.symbols.clear();
+    }
+
+    if (auto it = local.symbols.find(text); it != local.symbols.end()) {
+        return it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = symbols.find(text);
+
+    if (it == symbols.end()) {
+        // Keyed by a view of the stored copy, which stays put as the deque grows
+        const std::string &stored = names.emplace_back(text);
+        it = symbols.emplace(stored, static_cast<Symbol>(names.size() - 1)).first;
+    }
+
+    local.symbols.emplace(it->first, it->second);
+    return it->second;
+}
+
+std::string_view SymbolTable::name(Symbol symbol) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return names[symbol];
+}
+
+size_t SymbolTable::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return names.size();
+}
@@ -0,0 +1,110 @@
+#ifndef SYMBOLS_HPP
+#define SYMBOLS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "stats.hpp"
+
+// Dense ID of an interned identifier, struct or field name
+using Symbol = uint32_t;
+
+// Interns names into dense Symbols at load time. The table keeps one copy of
+// every name that is never moved, so nodes can hold std::string_views into it
+// instead of owning a std::string each.
+//
+// Each thread also remembers the names it has interned, so a name it has seen
+// before takes no lock; only the first sight of a name on a thread does. Names
+// are never freed: a process that checks many programs (--batch, --serve, a
+// reused cflatcheck::Checker) grows by every distinct name it ever sees, a few
+// dozen bytes each, plus the same again per thread that saw it. --stats
+// reports the count.
+class SymbolTable {
+public:
+    static SymbolTable &global();
+
+    Symbol intern(std::string_view text);
+    std::string_view name(Symbol symbol) const;
+    size_t size() const;
+
+private:
+    mutable std::mutex mutex;
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, Symbol> symbols;
+};
+
+// Map keyed by Symbol, stored as an array sorted by key, so a lookup is a
+// binary search over contiguous memory rather than hashing a string
+template <typename T>
+class SymbolMap {
+public:
+    using Entry = std::pair<Symbol, T>;
+
+    SymbolMap() = default;
+
+    // Bulk construction: when a key repeats, the last entry wins, as with repeated assignment
+    explicit SymbolMap(std::vector<Entry> entries) {
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs) {
+            return lhs.first < rhs.first;
+        });
+
+        for (auto &entry : entries) {
+            if (!this->entries.empty() && this->entries.back().first == entry.first) {
+                this->entries.back().second = std::move(entry.second);
+            } else {
+                this->entries.push_back(std::move(entry));
+            }
+        }
+    }
+
+    T &operator[](Symbol key) {
+        auto it = lowerBound(entries.begin(), entries.end(), key);
+
+        if (it == entries.end() || it->first != key) {
+            it = entries.insert(it, Entry(key, T()));
+        }
+
+        return it->second;
+    }
+
+    const T *find(Symbol key) const {
+        stats::count(stats::Counter::SYMBOL_LOOKUPS);
+        auto it = lowerBound(entries.begin(), entries.end(), key);
+        return it != entries.end() && it->first == key ? &it->second : nullptr;
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    bool empty() const {
+        return entries.empty();
+    }
+
+    typename std::vector<Entry>::const_iterator begin() const {
+        return entries.begin();
+    }
+
+    typename std::vector<Entry>::const_iterator end() const {
+        return entries.end();
+    }
+
+private:
+    template <typename Iterator>
+    static Iterator lowerBound(Iterator first, Iterator last, Symbol key) {
+        return std::lower_bound(first, last, key, [](const Entry &entry, Symbol key) {
+            return entry.first < key;
+        });
+    }
+
+    std::vector<Entry> entries;
+};
+
+#endif
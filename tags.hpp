@@ -0,0 +1,236 @@
+#ifndef TAGS_HPP
+#define TAGS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Every fixed string of the .astj format (node tags, operator names and
+// object keys), so builders can switch on a Tag instead of comparing a key
+// against string literals one after another. Keys spelled in lower case get a
+// KEY_ prefix, which keeps "Stmts" and "stmts" apart.
+enum class Tag : uint8_t {
+    UNKNOWN,
+
+    // Types
+    INT,
+    NIL,
+    STRUCT,
+    PTR,
+    ARRAY,
+    FN,
+
+    // Expressions
+    NUM,
+    SELECT,
+    UN_OP,
+    BIN_OP,
+    NEW_SINGLE,
+    NEW_ARRAY,
+    CALL,
+    VAL,
+
+    // Places
+    ID,
+    DEREF,
+    ARRAY_ACCESS,
+    FIELD_ACCESS,
+
+    // Statements
+    ASSIGN,
+    IF,
+    WHILE,
+    RETURN,
+    STMTS,
+    BREAK,
+    CONTINUE,
+
+    // Operators
+    NEG,
+    NOT,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    AND,
+    OR,
+    EQ,
+    NOT_EQ,
+    LT,
+    LTE,
+    GT,
+    GTE,
+
+    // Object keys
+    KEY_STRUCTS,
+    KEY_EXTERNS,
+    KEY_FUNCTIONS,
+    KEY_NAME,
+    KEY_FIELDS,
+    KEY_TYP,
+    KEY_PRMS,
+    KEY_LOCALS,
+    KEY_RETTYP,
+    KEY_STMTS,
+    KEY_KIND,
+    KEY_GUARD,
+    KEY_TT,
+    KEY_FF,
+    KEY_OP,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_CALLEE,
+    KEY_ARGS,
+    KEY_ARRAY,
+    KEY_IDX,
+    KEY_PTR,
+    KEY_FIELD,
+};
+
+namespace tags {
+
+struct Entry {
+    std::string_view text;
+    Tag tag;
+};
+
+inline constexpr Entry ENTRIES[] = {
+    {"Int", Tag::INT},
+    {"Nil", Tag::NIL},
+    {"Struct", Tag::STRUCT},
+    {"Ptr", Tag::PTR},
+    {"Array", Tag::ARRAY},
+    {"Fn", Tag::FN},
+    {"Num", Tag::NUM},
+    {"Select", Tag::SELECT},
+    {"UnOp", Tag::UN_OP},
+    {"BinOp", Tag::BIN_OP},
+    {"NewSingle", Tag::NEW_SINGLE},
+    {"NewArray", Tag::NEW_ARRAY},
+    {"Call", Tag::CALL},
+    {"Val", Tag::VAL},
+    {"Id", Tag::ID},
+    {"Deref", Tag::DEREF},
+    {"ArrayAccess", Tag::ARRAY_ACCESS},
+    {"FieldAccess", Tag::FIELD_ACCESS},
+    {"Assign", Tag::ASSIGN},
+    {"If", Tag::IF},
+    {"While", Tag::WHILE},
+    {"Return", Tag::RETURN},
+    {"Stmts", Tag::STMTS},
+    {"Break", Tag::BREAK},
+    {"Continue", Tag::CONTINUE},
+    {"Neg", Tag::NEG},
+    {"Not", Tag::NOT},
+    {"Add", Tag::ADD},
+    {"Sub", Tag::SUB},
+    {"Mul", Tag::MUL},
+    {"Div", Tag::DIV},
+    {"And", Tag::AND},
+    {"Or", Tag::OR},
+    {"Eq", Tag::EQ},
+    {"NotEq", Tag::NOT_EQ},
+    {"Lt", Tag::LT},
+    {"Lte", Tag::LTE},
+    {"Gt", Tag::GT},
+    {"Gte", Tag::GTE},
+    {"structs", Tag::KEY_STRUCTS},
+    {"externs", Tag::KEY_EXTERNS},
+    {"functions", Tag::KEY_FUNCTIONS},
+    {"name", Tag::KEY_NAME},
+    {"fields", Tag::KEY_FIELDS},
+    {"typ", Tag::KEY_TYP},
+    {"prms", Tag::KEY_PRMS},
+    {"locals", Tag::KEY_LOCALS},
+    {"rettyp", Tag::KEY_RETTYP},
+    {"stmts", Tag::KEY_STMTS},
+    {"kind", Tag::KEY_KIND},
+    {"guard", Tag::KEY_GUARD},
+    {"tt", Tag::KEY_TT},
+    {"ff", Tag::KEY_FF},
+    {"op", Tag::KEY_OP},
+    {"left", Tag::KEY_LEFT},
+    {"right", Tag::KEY_RIGHT},
+    {"callee", Tag::KEY_CALLEE},
+    {"args", Tag::KEY_ARGS},
+    {"array", Tag::KEY_ARRAY},
+    {"idx", Tag::KEY_IDX},
+    {"ptr", Tag::KEY_PTR},
+    {"field", Tag::KEY_FIELD},
+};
+
+inline constexpr size_t ENTRY_COUNT = sizeof(ENTRIES) / sizeof(ENTRIES[0]);
+inline constexpr size_t TABLE_BITS = 9;
+inline constexpr size_t TABLE_SIZE = size_t(1) << TABLE_BITS;
+
+static_assert(ENTRY_COUNT < TABLE_SIZE, "tag table is too small");
+
+// Seeded 32-bit FNV-1a, folded down to a table slot
+constexpr size_t slot(std::string_view text, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+
+    for (char c : text) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+
+    return (hash ^ (hash >> 15)) & (TABLE_SIZE - 1);
+}
+
+constexpr bool isPerfect(uint32_t seed) {
+    std::array<bool, TABLE_SIZE> used{};
+
+    for (const Entry &entry : ENTRIES) {
+        size_t index = slot(entry.text, seed);
+
+        if (used[index]) {
+            return false;
+        }
+
+        used[index] = true;
+    }
+
+    return true;
+}
+
+// The first seed for which no two entries share a slot, found at compile time
+constexpr uint32_t findSeed() {
+    for (uint32_t seed = 0;; seed++) {
+        if (isPerfect(seed)) {
+            return seed;
+        }
+    }
+}
+
+inline constexpr uint32_t SEED = findSeed();
+
+// Slot to 1 + index into ENTRIES, or 0 where no entry hashes
+constexpr std::array<uint8_t, TABLE_SIZE> buildTable() {
+    std::array<uint8_t, TABLE_SIZE> table{};
+
+    for (size_t i = 0; i < ENTRY_COUNT; i++) {
+        table[slot(ENTRIES[i].text, SEED)] = static_cast<uint8_t>(i + 1);
+    }
+
+    return table;
+}
+
+inline constexpr std::array<uint8_t, TABLE_SIZE> TABLE = buildTable();
+
+} // namespace tags
+
+// One hash and one string compare; anything outside the format is UNKNOWN
+constexpr Tag lookupTag(std::string_view text) {
+    uint8_t entry = tags::TABLE[tags::slot(text, tags::SEED)];
+
+    if (entry == 0 || tags::ENTRIES[entry - 1].text != text) {
+        return Tag::UNKNOWN;
+    }
+
+    return tags::ENTRIES[entry - 1].tag;
+}
+
+static_assert(lookupTag("BinOp") == Tag::BIN_OP && lookupTag("stmts") == Tag::KEY_STMTS);
+static_assert(lookupTag("Stmts") == Tag::STMTS && lookupTag("Bin") == Tag::UNKNOWN);
+
+#endif
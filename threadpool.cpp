@@ -0,0 +1,87 @@
+#include <algorithm>
+
+#include "threadpool.hpp"
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    wakeWorkers.notify_all();
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::size() const {
+    return static_cast<unsigned>(workers.size() + 1);
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &task) {
+    std::lock_guard<std::mutex> submit(submitMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        taskCount = count;
+        nextIndex = 0;
+        activeWorkers = workers.size();
+        generation++;
+    }
+
+    wakeWorkers.notify_all();
+    runTasks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this] { return activeWorkers == 0; });
+    this->task = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+    size_t seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+
+            if (stopping) {
+                return;
+            }
+
+            seenGeneration = generation;
+        }
+
+        runTasks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (--activeWorkers == 0) {
+            jobDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runTasks() {
+    while (true) {
+        size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+
+        if (index >= taskCount) {
+            return;
+        }
+
+        (*task)(index);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run index-parallel loops. Indices are
+// handed out one at a time from a shared counter, so a few expensive items
+// never hold up the cheap ones queued behind them.
+class ThreadPool {
+public:
+    // threads counts the calling thread, which also runs tasks; 0 means one per core
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const;
+
+    // Runs task(i) for every i in [0, count) and returns once all have finished.
+    // The task must not throw; callers capture failures per index instead.
+    void parallelFor(size_t count, const std::function<void(size_t)> &task);
+
+private:
+    void workerLoop();
+    void runTasks();
+
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable jobDone;
+
+    const std::function<void(size_t)> *task = nullptr;
+    size_t taskCount = 0;
+    std::atomic<size_t> nextIndex{0};
+    size_t generation = 0;
+    size_t activeWorkers = 0;
+    bool stopping = false;
+};
+
+#endif
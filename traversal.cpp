@@ -0,0 +1,622 @@
+#include "traversal.hpp"
+#include "stats.hpp"
+
+namespace {
+
+// Lists the children of whichever node accepts it
+struct ChildCollector : public Visitor {
+    std::vector<Node *> &out;
+
+    explicit ChildCollector(std::vector<Node *> &out) : out(out) {}
+
+    /* Expressions */
+
+    void visit(Value &node) override {
+        out.push_back(node.place.get());
+    }
+
+    void visit(Select &node) override {
+        out.push_back(node.guard.get());
+        out.push_back(node.ttCase.get());
+        out.push_back(node.ffCase.get());
+    }
+
+    void visit(UnaryOperation &node) override {
+        out.push_back(node.expression.get());
+    }
+
+    void visit(BinaryOperation &node) override {
+        out.push_back(node.lhs.get());
+        out.push_back(node.rhs.get());
+    }
+
+    void visit(NewArray &node) override {
+        out.push_back(node.size.get());
+    }
+
+    void visit(CallExpression &node) override {
+        out.push_back(node.functionCall.get());
+    }
+
+    /* Places */
+
+    void visit(Dereference &node) override {
+        out.push_back(node.expression.get());
+    }
+
+    void visit(ArrayAccess &node) override {
+        out.push_back(node.array.get());
+        out.push_back(node.index.get());
+    }
+
+    void visit(FieldAccess &node) override {
+        out.push_back(node.pointer.get());
+    }
+
+    /* Function call */
+
+    void visit(FunctionCall &node) override {
+        out.push_back(node.callee.get());
+
+        for (auto &arg : node.args) {
+            out.push_back(arg.get());
+        }
+    }
+
+    /* Statements */
+
+    void visit(Statements &node) override {
+        for (auto &statement : node.statements) {
+            out.push_back(statement.get());
+        }
+    }
+
+    void visit(Assignment &node) override {
+        out.push_back(node.place.get());
+        out.push_back(node.expression.get());
+    }
+
+    void visit(CallStatement &node) override {
+        out.push_back(node.functionCall.get());
+    }
+
+    void visit(If &node) override {
+        out.push_back(node.guard.get());
+        out.push_back(node.happyPath.get());
+
+        if (node.unhappyPath) {
+            out.push_back(node.unhappyPath->get());
+        }
+    }
+
+    void visit(While &node) override {
+        out.push_back(node.guard.get());
+        out.push_back(node.body.get());
+    }
+
+    void visit(Return &node) override {
+        if (node.expression) {
+            out.push_back(node.expression->get());
+        }
+    }
+
+    /* High level nodes */
+
+    void visit(StructDefinition &node) override {
+        for (auto &field : node.fields) {
+            out.push_back(&field);
+        }
+    }
+
+    void visit(FunctionDefinition &node) override {
+        for (auto &param : node.params) {
+            out.push_back(&param);
+        }
+
+        for (auto &local : node.locals) {
+            out.push_back(&local);
+        }
+
+        if (node.body) {
+            out.push_back(node.body.get());
+        }
+    }
+
+    void visit(Program &node) override {
+        for (auto &structDefinition : node.structs) {
+            out.push_back(structDefinition.get());
+        }
+
+        for (auto &externDefinition : node.externs) {
+            out.push_back(&externDefinition);
+        }
+
+        for (auto &function : node.functions) {
+            out.push_back(function.get());
+        }
+    }
+};
+
+// Moves the owned children out of whichever node accepts it
+struct ChildReleaser : public Visitor {
+    std::vector<NodePtr<Node>> &out;
+
+    explicit ChildReleaser(std::vector<NodePtr<Node>> &out) : out(out) {}
+
+    template <typename T>
+    void release(NodePtr<T> &child) {
+        if (child) {
+            out.push_back(std::move(child));
+        }
+    }
+
+    template <typename T>
+    void release(std::optional<NodePtr<T>> &child) {
+        if (child) {
+            release(*child);
+            child.reset();
+        }
+    }
+
+    template <typename T, size_t N>
+    void release(SmallVector<NodePtr<T>, N> &children) {
+        for (auto &child : children) {
+            release(child);
+        }
+
+        children.clear();
+    }
+
+    void visit(Value &node) override {
+        release(node.place);
+    }
+
+    void visit(Select &node) override {
+        release(node.guard);
+        release(node.ttCase);
+        release(node.ffCase);
+    }
+
+    void visit(UnaryOperation &node) override {
+        release(node.expression);
+    }
+
+    void visit(BinaryOperation &node) override {
+        release(node.lhs);
+        release(node.rhs);
+    }
+
+    void visit(NewArray &node) override {
+        release(node.size);
+    }
+
+    void visit(CallExpression &node) override {
+        release(node.functionCall);
+    }
+
+    void visit(Dereference &node) override {
+        release(node.expression);
+    }
+
+    void visit(ArrayAccess &node) override {
+        release(node.array);
+        release(node.index);
+    }
+
+    void visit(FieldAccess &node) override {
+        release(node.pointer);
+    }
+
+    void visit(FunctionCall &node) override {
+        release(node.callee);
+        release(node.args);
+    }
+
+    void visit(Statements &node) override {
+        release(node.statements);
+    }
+
+    void visit(Assignment &node) override {
+        release(node.place);
+        release(node.expression);
+    }
+
+    void visit(CallStatement &node) override {
+        release(node.functionCall);
+    }
+
+    void visit(If &node) override {
+        release(node.guard);
+        release(node.happyPath);
+        release(node.unhappyPath);
+    }
+
+    void visit(While &node) override {
+        release(node.guard);
+        release(node.body);
+    }
+
+    void visit(Return &node) override {
+        release(node.expression);
+    }
+
+    void visit(FunctionDefinition &node) override {
+        release(node.body);
+    }
+};
+
+} // namespace
+
+void collectChildren(Node &node, std::vector<Node *> &out) {
+    ChildCollector collector(out);
+    node.accept(collector);
+}
+
+void destroyTree(std::vector<NodePtr<Node>> roots) {
+    ChildReleaser releaser(roots);
+
+    while (!roots.empty()) {
+        NodePtr<Node> node = std::move(roots.back());
+        roots.pop_back();
+        node->accept(releaser);
+    }
+}
+
+uint32_t assignNodeIds(Node &root) {
+    uint32_t nextId = 0;
+    std::vector<Node *> pending{&root};
+    std::vector<Node *> nodeChildren;
+
+    while (!pending.empty()) {
+        Node *node = pending.back();
+        pending.pop_back();
+        node->id = nextId++;
+
+        // Pushed in reverse so the first child is numbered next
+        nodeChildren.clear();
+        collectChildren(*node, nodeChildren);
+        pending.insert(pending.end(), nodeChildren.rbegin(), nodeChildren.rend());
+    }
+
+    return nextId;
+}
+
+/* Walker */
+
+void Walker::walk(Node &root) {
+    frames.clear();
+    children.clear();
+    stopped = false;
+    enter(root);
+
+    while (!frames.empty() && !stopped) {
+        Frame &top = frames.back();
+
+        if (top.nextChild < top.childCount) {
+            Node *child = children[top.firstChild + top.nextChild++];
+            enter(*child);
+            continue;
+        }
+
+        Node *node = top.node;
+        children.resize(top.firstChild);
+        frames.pop_back();
+
+        currentPhase = WalkPhase::LEAVE;
+        node->accept(*this);
+
+        if (!frames.empty() && !stopped) {
+            Frame &parent = frames.back();
+            currentPhase = WalkPhase::CHILD;
+            currentChild = parent.nextChild - 1;
+            parent.node->accept(*this);
+        }
+    }
+
+    frames.clear();
+    children.clear();
+}
+
+void Walker::enter(Node &node) {
+    currentPhase = WalkPhase::ENTER;
+    skipping = false;
+    node.accept(*this);
+
+    if (stopped) {
+        return;
+    }
+
+    size_t firstChild = children.size();
+
+    if (!skipping) {
+        collectChildren(node, children);
+    }
+
+    frames.push_back({&node, firstChild, children.size() - firstChild, 0});
+    stats::countMax(stats::Counter::MAX_WALK_DEPTH, frames.size());
+}
+
+WalkPhase Walker::phase() const {
+    return currentPhase;
+}
+
+size_t Walker::childIndex() const {
+    return currentChild;
+}
+
+void Walker::skipChildren() {
+    skipping = true;
+}
+
+void Walker::stop() {
+    stopped = true;
+}
+
+/* Cloning */
+
+namespace {
+
+// Copies the tree bottom up: as each node is left, its children's copies are
+// popped off a stack of finished nodes and its own copy is pushed
+class Cloner : public Walker {
+public:
+    // A partly copied tree is torn down iteratively, as Program does for a whole one
+    ~Cloner() {
+        destroyTree(std::move(nodes));
+    }
+
+    std::unique_ptr<Program> clone(const Program &program) {
+        Arena::Scope arenaScope(*arena);
+        walk(const_cast<Program&>(program));
+        return std::move(copy);
+    }
+
+private:
+    template <typename T>
+    NodePtr<T> pop() {
+        NodePtr<Node> node = std::move(nodes.back());
+        nodes.pop_back();
+        NodeDeleter deleter = node.get_deleter();
+        return NodePtr<T>(static_cast<T*>(node.release()), deleter);
+    }
+
+    // The last count nodes, in order, as a List of NodePtr<T>
+    template <typename T, typename List>
+    List pop(size_t count) {
+        List popped(count);
+
+        for (size_t i = count; i-- > 0;) {
+            popped[i] = pop<T>();
+        }
+
+        return popped;
+    }
+
+    template <typename T>
+    void push(const Node &original, NodePtr<T> node) {
+        node->id = original.id;
+        NodeDeleter deleter = node.get_deleter();
+        nodes.emplace_back(node.release(), deleter);
+    }
+
+    /* Expressions */
+
+    void visit(Value &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<Value>(pop<Place>()));
+        }
+    }
+
+    void visit(Number &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<Number>(node.value));
+        }
+    }
+
+    void visit(Nil &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<Nil>());
+        }
+    }
+
+    void visit(Select &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            auto ffCase = pop<Expression>();
+            auto ttCase = pop<Expression>();
+            auto guard = pop<Expression>();
+            push(node, makeNode<Select>(std::move(guard), std::move(ttCase), std::move(ffCase)));
+        }
+    }
+
+    void visit(UnaryOperation &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<UnaryOperation>(node.operand, pop<Expression>()));
+        }
+    }
+
+    void visit(BinaryOperation &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            auto rhs = pop<Expression>();
+            auto lhs = pop<Expression>();
+            push(node, makeNode<BinaryOperation>(node.operand, std::move(lhs), std::move(rhs)));
+        }
+    }
+
+    void visit(NewSingleton &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<NewSingleton>(node.type));
+        }
+    }
+
+    void visit(NewArray &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<NewArray>(node.type, pop<Expression>()));
+        }
+    }
+
+    void visit(CallExpression &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<CallExpression>(pop<FunctionCall>()));
+        }
+    }
+
+    /* Places */
+
+    void visit(Identifier &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<Identifier>(node.symbol));
+        }
+    }
+
+    void visit(Dereference &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<Dereference>(pop<Expression>()));
+        }
+    }
+
+    void visit(ArrayAccess &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            auto index = pop<Expression>();
+            auto array = pop<Expression>();
+            push(node, makeNode<ArrayAccess>(std::move(array), std::move(index)));
+        }
+    }
+
+    void visit(FieldAccess &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<FieldAccess>(pop<Expression>(), node.fieldSymbol));
+        }
+    }
+
+    /* Function call */
+
+    void visit(FunctionCall &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            auto args = pop<Expression, Arguments>(node.args.size());
+            auto callee = pop<Expression>();
+            push(node, makeNode<FunctionCall>(std::move(callee), std::move(args)));
+        }
+    }
+
+    /* Statements */
+
+    void visit(Statements &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            auto statements = makeNode<Statements>();
+            statements->statements = pop<Statement, StatementList>(node.statements.size());
+            push(node, std::move(statements));
+        }
+    }
+
+    void visit(Assignment &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            auto expression = pop<Expression>();
+            auto place = pop<Place>();
+            push(node, makeNode<Assignment>(std::move(place), std::move(expression)));
+        }
+    }
+
+    void visit(CallStatement &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<CallStatement>(pop<FunctionCall>()));
+        }
+    }
+
+    void visit(If &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            std::optional<NodePtr<Statement>> unhappyPath;
+
+            if (node.unhappyPath) {
+                unhappyPath = pop<Statement>();
+            }
+
+            auto happyPath = pop<Statement>();
+            auto guard = pop<Expression>();
+            push(node, makeNode<If>(std::move(guard), std::move(happyPath), std::move(unhappyPath)));
+        }
+    }
+
+    void visit(While &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            auto body = pop<Statement>();
+            auto guard = pop<Expression>();
+            push(node, makeNode<While>(std::move(guard), std::move(body)));
+        }
+    }
+
+    void visit(Break &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<Break>());
+        }
+    }
+
+    void visit(Continue &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            push(node, makeNode<Continue>());
+        }
+    }
+
+    void visit(Return &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            std::optional<NodePtr<Expression>> expression;
+
+            if (node.expression) {
+                expression = pop<Expression>();
+            }
+
+            push(node, makeNode<Return>(std::move(expression)));
+        }
+    }
+
+    /* High level nodes */
+
+    // Fields, params, locals and externs are held by value and copied with
+    // their owner, so the walk over them pushes nothing
+
+    void visit(StructDefinition &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            auto structDefinition = makeNode<StructDefinition>();
+            structDefinition->name = node.name;
+            structDefinition->fields = node.fields;
+            push(node, std::move(structDefinition));
+        }
+    }
+
+    void visit(FunctionDefinition &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            auto function = makeNode<FunctionDefinition>();
+            function->name = node.name;
+            function->params = node.params;
+            function->returnType = node.returnType;
+            function->locals = node.locals;
+
+            if (node.body) {
+                function->body = pop<Statement>();
+            }
+
+            push(node, std::move(function));
+        }
+    }
+
+    void visit(Program &node) override {
+        if (phase() == WalkPhase::LEAVE) {
+            copy = std::make_unique<Program>();
+            copy->id = node.id;
+            copy->functions = pop<FunctionDefinition, std::vector<NodePtr<FunctionDefinition>>>(node.functions.size());
+            copy->structs = pop<StructDefinition, std::vector<NodePtr<StructDefinition>>>(node.structs.size());
+            copy->externs = node.externs;
+            copy->arena = std::move(arena);
+        }
+    }
+
+    // Declared first so the nodes it backs are all gone before it is
+    std::unique_ptr<Arena> arena = std::make_unique<Arena>();
+    std::vector<NodePtr<Node>> nodes;
+    std::unique_ptr<Program> copy;
+};
+
+} // namespace
+
+std::unique_ptr<Program> cloneProgram(const Program &program) {
+    return Cloner().clone(program);
+}
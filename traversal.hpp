@@ -0,0 +1,73 @@
+#ifndef TRAVERSAL_HPP
+#define TRAVERSAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ast.hpp"
+
+// Appends the direct children of node to out, in evaluation order
+extern void collectChildren(Node &node, std::vector<Node *> &out);
+
+// Destroys the trees under roots one node at a time. Each node's children are
+// detached before the node itself is released, so nesting depth never turns
+// into destructor recursion.
+extern void destroyTree(std::vector<NodePtr<Node>> roots);
+
+// Numbers root and every node under it 0, 1, 2, ... in pre-order, evaluation
+// order among siblings, and returns how many ids were handed out
+extern uint32_t assignNodeIds(Node &root);
+
+// A deep copy of program in an arena of its own, built without recursion.
+// Types are interned and so shared with the original; node ids are copied,
+// so a TypeTable for one tree answers for the other.
+extern std::unique_ptr<Program> cloneProgram(const Program &program);
+
+// Where in a node's traversal a Walker is when it calls visit() for that node
+enum class WalkPhase {
+    ENTER, // before any child
+    CHILD, // right after the child at childIndex() has been walked
+    LEAVE, // after all children
+};
+
+// Depth-first traversal driven by an explicit stack on the heap, so walking a
+// tree never recurses no matter how deeply it is nested. Each node is handed
+// to the matching visit() overload once per phase; overrides read phase() to
+// tell the calls apart.
+class Walker : public Visitor {
+public:
+    void walk(Node &root);
+
+protected:
+    WalkPhase phase() const;
+    size_t childIndex() const;
+
+    // Called during ENTER to walk none of the node's children (LEAVE still follows)
+    void skipChildren();
+
+    // Ends the walk as soon as the current visit() returns; nothing else is visited
+    void stop();
+
+private:
+    void enter(Node &node);
+
+    struct Frame {
+        Node *node;
+        size_t firstChild;
+        size_t childCount;
+        size_t nextChild;
+    };
+
+    std::vector<Frame> frames;
+    // Children of every open frame, each frame owning a contiguous run
+    std::vector<Node *> children;
+
+    WalkPhase currentPhase = WalkPhase::ENTER;
+    size_t currentChild = 0;
+    bool skipping = false;
+    bool stopped = false;
+};
+
+#endif
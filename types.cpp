@@ -1,27 +1,287 @@
 #include "types.hpp"
 
-#include <sstream>
+#include "render.hpp"
+#include "stats.hpp"
+
+const std::shared_ptr<IntType> INT_TYPE = std::make_shared<IntType>();
+const std::shared_ptr<NilType> NIL_TYPE = std::make_shared<NilType>();
 
 /* Helper functions */
 bool typesEqual(const std::shared_ptr<Type> &lhs, const std::shared_ptr<Type> &rhs) {
-    if (!lhs && !rhs) return true;
+    return typesEqual(lhs.get(), rhs.get());
+}
+
+// Compares two types component by component, from a stack of the pairs still
+// to compare, so a deeply nested type never turns into recursion
+static bool structurallyEqual(const Type *lhs, const Type *rhs) {
+    SmallVector<std::pair<const Type*, const Type*>, 8> pending;
+    pending.emplace_back(lhs, rhs);
+
+    while (!pending.empty()) {
+        auto [left, right] = pending.back();
+        pending.pop_back();
+
+        if (left == right) continue;
+        if (!left || !right) return false;
+        if (!left->containsNil && !right->containsNil) return false;
+
+        // nil is compatible with every array and pointer type
+        const TypeKind leftTypeKind = left->getTypeKind();
+        const TypeKind rightTypeKind = right->getTypeKind();
+
+        if (leftTypeKind == TypeKind::NIL || rightTypeKind == TypeKind::NIL) {
+            const TypeKind otherTypeKind = leftTypeKind == TypeKind::NIL ? rightTypeKind : leftTypeKind;
+
+            if (otherTypeKind != TypeKind::NIL && otherTypeKind != TypeKind::ARRAY && otherTypeKind != TypeKind::POINTER) {
+                return false;
+            }
+
+            continue;
+        }
+
+        if (leftTypeKind != rightTypeKind) return false;
+
+        switch (leftTypeKind) {
+            case TypeKind::ARRAY:
+                pending.emplace_back(static_cast<const ArrayType*>(left)->elementType.get(),
+                                     static_cast<const ArrayType*>(right)->elementType.get());
+                break;
+            case TypeKind::POINTER:
+                pending.emplace_back(static_cast<const PointerType*>(left)->pointeeType.get(),
+                                     static_cast<const PointerType*>(right)->pointeeType.get());
+                break;
+            case TypeKind::FUNCTION: {
+                const FunctionType *leftFunction = static_cast<const FunctionType*>(left);
+                const FunctionType *rightFunction = static_cast<const FunctionType*>(right);
+
+                if (leftFunction->paramTypes.size() != rightFunction->paramTypes.size()) return false;
+
+                for (size_t i = 0; i < leftFunction->paramTypes.size(); i++) {
+                    pending.emplace_back(leftFunction->paramTypes[i].get(), rightFunction->paramTypes[i].get());
+                }
+
+                pending.emplace_back(leftFunction->returnType.get(), rightFunction->returnType.get());
+                break;
+            }
+            default:
+                // Ints and structs with no nil in them are interned, so distinct ones differ
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool typesEqual(const Type *lhs, const Type *rhs) {
+    stats::count(stats::Counter::TYPES_EQUAL);
+
+    if (lhs == rhs) return true;
     if (!lhs || !rhs) return false;
-    return lhs->equals(*rhs);
+
+    // Interned types without nil inside are equal only if they are the same instance
+    if (!lhs->containsNil && !rhs->containsNil) return false;
+
+    return structurallyEqual(lhs, rhs);
+}
+
+bool isStorableKind(TypeKind kind) {
+    return kind != TypeKind::NIL && kind != TypeKind::STRUCT && kind != TypeKind::FUNCTION;
+}
+
+/* Scope */
+Scope::Scope(const Gamma &globals) : globals(globals) {}
+
+void Scope::declare(Symbol name, std::shared_ptr<Type> type) {
+    locals[name] = std::move(type);
+}
+
+const std::shared_ptr<Type> *Scope::lookup(Symbol name) const {
+    if (const std::shared_ptr<Type> *type = locals.find(name)) {
+        return type;
+    }
+
+    return globals.find(name);
+}
+
+/* TypeContext */
+TypeContext &TypeContext::global() {
+    static TypeContext context;
+    return context;
+}
+
+std::shared_ptr<Type> TypeContext::intType() const {
+    return INT_TYPE;
+}
+
+std::shared_ptr<Type> TypeContext::nilType() const {
+    return NIL_TYPE;
+}
+
+struct TypeContext::ThreadCache {
+    const TypeContext *context = nullptr;
+    std::vector<std::shared_ptr<Type>> structTypes;
+    std::unordered_map<const Type*, std::shared_ptr<Type>> pointerTypes;
+    std::unordered_map<const Type*, std::shared_ptr<Type>> arrayTypes;
+    std::unordered_map<Signature, std::shared_ptr<Type>, SignatureHash> functionTypes;
+};
+
+TypeContext::ThreadCache &TypeContext::threadCache() {
+    static thread_local ThreadCache cache;
+
+    if (cache.context != this) {
+        cache = ThreadCache();
+        cache.context = this;
+    }
+
+    return cache;
+}
+
+std::shared_ptr<Type> TypeContext::structType(const std::string &name) {
+    Symbol symbol = SymbolTable::global().intern(name);
+    ThreadCache &cache = threadCache();
+
+    if (symbol < cache.structTypes.size() && cache.structTypes[symbol]) {
+        return cache.structTypes[symbol];
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (symbol >= structTypes.size()) {
+        structTypes.resize(symbol + 1);
+    }
+
+    auto &type = structTypes[symbol];
+
+    if (!type) {
+        type = std::make_shared<StructType>(symbol, name);
+    }
+
+    if (symbol >= cache.structTypes.size()) {
+        cache.structTypes.resize(symbol + 1);
+    }
+
+    cache.structTypes[symbol] = type;
+    return type;
+}
+
+std::shared_ptr<Type> TypeContext::pointerType(const std::shared_ptr<Type> &pointeeType) {
+    auto &cached = threadCache().pointerTypes[pointeeType.get()];
+
+    if (cached) {
+        return cached;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &type = pointerTypes[pointeeType.get()];
+
+    if (!type) {
+        type = std::make_shared<PointerType>(pointeeType);
+    }
+
+    cached = type;
+    return type;
+}
+
+std::shared_ptr<Type> TypeContext::arrayType(const std::shared_ptr<Type> &elementType) {
+    auto &cached = threadCache().arrayTypes[elementType.get()];
+
+    if (cached) {
+        return cached;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &type = arrayTypes[elementType.get()];
+
+    if (!type) {
+        type = std::make_shared<ArrayType>(elementType);
+    }
+
+    cached = type;
+    return type;
+}
+
+std::shared_ptr<Type> TypeContext::functionType(std::span<const std::shared_ptr<Type>> paramTypes, const std::shared_ptr<Type> &returnType) {
+    Signature signature;
+    signature.reserve(paramTypes.size() + 1);
+    signature.push_back(returnType.get());
+
+    for (const auto &paramType : paramTypes) {
+        signature.push_back(paramType.get());
+    }
+
+    ThreadCache &cache = threadCache();
+
+    if (auto cached = cache.functionTypes.find(signature); cached != cache.functionTypes.end()) {
+        return cached->second;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = functionTypes.find(signature);
+
+    if (found == functionTypes.end()) {
+        auto type = std::make_shared<FunctionType>(TypeList(paramTypes.begin(), paramTypes.end()), returnType);
+        found = functionTypes.emplace(signature, std::move(type)).first;
+    }
+
+    cache.functionTypes.emplace(std::move(signature), found->second);
+    return found->second;
+}
+
+size_t TypeContext::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t structs = 0;
+
+    for (const auto &type : structTypes) {
+        structs += type != nullptr;
+    }
+
+    return structs + pointerTypes.size() + arrayTypes.size() + functionTypes.size();
+}
+
+size_t TypeContext::SignatureHash::operator()(const Signature &signature) const {
+    size_t hash = signature.size();
+
+    for (const Type *type : signature) {
+        hash ^= std::hash<const Type*>()(type) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+
+    return hash;
 }
 
 /* Type definitions */
 
-// IntType
-std::string IntType::toString() const {
-    return "Int";
+// Type
+void Type::render(std::string &out) const {
+    Renderer renderer(out);
+    renderer.type(*this);
+    renderer.run();
+}
+
+void Type::renderPretty(std::string &out) const {
+    Renderer renderer(out);
+    renderer.prettyType(*this);
+    renderer.run();
+}
+
+std::string Type::toString() const {
+    std::string out;
+    render(out);
+    return out;
 }
 
-std::string IntType::toStringPretty() const {
-    return "int";
+std::string Type::toStringPretty() const {
+    std::string out;
+    renderPretty(out);
+    return out;
 }
 
-bool IntType::equals(const Type &other) const {
-    return other.getTypeKind() == TypeKind::INT;
+// IntType
+void IntType::renderParts(Renderer &renderer) const {
+    renderer.text("Int");
+}
+
+void IntType::renderPrettyParts(Renderer &renderer) const {
+    renderer.text("int");
 }
 
 TypeKind IntType::getTypeKind() const {
@@ -29,19 +289,16 @@ TypeKind IntType::getTypeKind() const {
 }
 
 // NilType
-std::string NilType::toString() const {
-    return "Nil";
+NilType::NilType() {
+    this->containsNil = true;
 }
 
-std::string NilType::toStringPretty() const {
-    return "nil";
+void NilType::renderParts(Renderer &renderer) const {
+    renderer.text("Nil");
 }
 
-bool NilType::equals(const Type &other) const {
-    const TypeKind otherTypeKind = other.getTypeKind();
-    return otherTypeKind == TypeKind::NIL || 
-           otherTypeKind == TypeKind::ARRAY || 
-           otherTypeKind == TypeKind::POINTER;
+void NilType::renderPrettyParts(Renderer &renderer) const {
+    renderer.text("nil");
 }
 
 TypeKind NilType::getTypeKind() const {
@@ -49,21 +306,19 @@ TypeKind NilType::getTypeKind() const {
 }
 
 // StructType
-StructType::StructType(std::string name) {
+StructType::StructType(Symbol symbol, std::string name) {
+    this->symbol = symbol;
     this->name = std::move(name);
 }
 
-std::string StructType::toString() const {
-    return "Struct(\"" + name + "\")";
-}
-
-std::string StructType::toStringPretty() const {
-    return name;
+void StructType::renderParts(Renderer &renderer) const {
+    renderer.text("Struct(\"");
+    renderer.text(name);
+    renderer.text("\")");
 }
 
-bool StructType::equals(const Type &other) const {
-    if (other.getTypeKind() != TypeKind::STRUCT) return false; 
-    return name == dynamic_cast<const StructType*>(&other)->name;
+void StructType::renderPrettyParts(Renderer &renderer) const {
+    renderer.text(name);
 }
 
 TypeKind StructType::getTypeKind() const {
@@ -73,20 +328,25 @@ TypeKind StructType::getTypeKind() const {
 // ArrayType
 ArrayType::ArrayType(std::shared_ptr<Type> elementType) {
     this->elementType = std::move(elementType);
+    this->containsNil = this->elementType && this->elementType->containsNil;
 }
 
-std::string ArrayType::toString() const {
-    return "Array(" + elementType->toString() + ")";
+void ArrayType::renderParts(Renderer &renderer) const {
+    renderer.text("Array(");
+    renderer.type(*elementType);
+    renderer.text(")");
 }
 
-std::string ArrayType::toStringPretty() const {
-    return elementType ? "[" + elementType->toStringPretty() + "]" : "[<null>]";
-}
+void ArrayType::renderPrettyParts(Renderer &renderer) const {
+    renderer.text("[");
+
+    if (elementType) {
+        renderer.prettyType(*elementType);
+    } else {
+        renderer.text("<null>");
+    }
 
-bool ArrayType::equals(const Type &other) const {
-    if (other.getTypeKind() == TypeKind::NIL) return true;
-    if (other.getTypeKind() != TypeKind::ARRAY) return false;
-    return typesEqual(elementType, dynamic_cast<const ArrayType*>(&other)->elementType);  
+    renderer.text("]");
 }
 
 TypeKind ArrayType::getTypeKind() const {
@@ -96,20 +356,29 @@ TypeKind ArrayType::getTypeKind() const {
 // PointerType
 PointerType::PointerType(std::shared_ptr<Type> pointeeType) {
     this->pointeeType = std::move(pointeeType);
+    this->containsNil = this->pointeeType && this->pointeeType->containsNil;
 }
     
-std::string PointerType::toString() const { 
-    return "Ptr(" + (pointeeType ? pointeeType->toString() : "<null>") + ")";
-};
+void PointerType::renderParts(Renderer &renderer) const {
+    renderer.text("Ptr(");
 
-std::string PointerType::toStringPretty() const { 
-    return "&" + (pointeeType ? pointeeType->toStringPretty() : "<null>");
-};
+    if (pointeeType) {
+        renderer.type(*pointeeType);
+    } else {
+        renderer.text("<null>");
+    }
 
-bool PointerType::equals(const Type &other) const {
-    if (other.getTypeKind() == TypeKind::NIL) return true;
-    if (other.getTypeKind() != TypeKind::POINTER) return false; 
-    return typesEqual(pointeeType, dynamic_cast<const PointerType*>(&other)->pointeeType);
+    renderer.text(")");
+}
+
+void PointerType::renderPrettyParts(Renderer &renderer) const {
+    renderer.text("&");
+
+    if (pointeeType) {
+        renderer.prettyType(*pointeeType);
+    } else {
+        renderer.text("<null>");
+    }
 }
 
 TypeKind PointerType::getTypeKind() const {
@@ -117,53 +386,39 @@ TypeKind PointerType::getTypeKind() const {
 }
 
 // FunctionType
-FunctionType::FunctionType(std::vector<std::shared_ptr<Type>> paramTypes, std::shared_ptr<Type> returnType) {
+FunctionType::FunctionType(TypeList paramTypes, std::shared_ptr<Type> returnType) {
     this->paramTypes = std::move(paramTypes);
     this->returnType = std::move(returnType);
-}
-    
-std::string FunctionType::toString() const {
-    std::stringstream ss;
-    ss << "Fn(";
-    ss << "[";
+    this->containsNil = this->returnType && this->returnType->containsNil;
 
-    for (size_t i = 0; i < paramTypes.size(); i++) {
-        ss << paramTypes[i]->toString();
-        ss << (i == paramTypes.size() - 1 ? "" : ", ");
+    for (const auto &paramType : this->paramTypes) {
+        this->containsNil = this->containsNil || (paramType && paramType->containsNil);
     }
-
-    ss << "]";
-    ss << ", " << returnType->toString();
-    ss << ")";
-    return ss.str();
 }
-
-std::string FunctionType::toStringPretty() const {
-    std::stringstream ss;
-    ss << "(";
+    
+void FunctionType::renderParts(Renderer &renderer) const {
+    renderer.text("Fn([");
 
     for (size_t i = 0; i < paramTypes.size(); i++) {
-        ss << paramTypes[i]->toStringPretty();
-        ss << (i == paramTypes.size() - 1 ? "" : ", ");
+        renderer.type(*paramTypes[i]);
+        if (i < paramTypes.size() - 1) renderer.text(", ");
     }
 
-    ss << ")";
-    ss << " -> " << returnType->toStringPretty();
-    return ss.str();
+    renderer.text("], ");
+    renderer.type(*returnType);
+    renderer.text(")");
 }
 
-bool FunctionType::equals(const Type &other) const {
-    if (other.getTypeKind() != TypeKind::FUNCTION) return false;
-    
-    const FunctionType *otherFunction = dynamic_cast<const FunctionType*>(&other);
-    
-    if (paramTypes.size() != otherFunction->paramTypes.size()) return false;
-    
+void FunctionType::renderPrettyParts(Renderer &renderer) const {
+    renderer.text("(");
+
     for (size_t i = 0; i < paramTypes.size(); i++) {
-        if (!typesEqual(paramTypes[i], otherFunction->paramTypes[i])) return false;
+        renderer.prettyType(*paramTypes[i]);
+        if (i < paramTypes.size() - 1) renderer.text(", ");
     }
 
-    return typesEqual(returnType, otherFunction->returnType);
+    renderer.text(") -> ");
+    renderer.prettyType(*returnType);
 }
 
 TypeKind FunctionType::getTypeKind() const { 
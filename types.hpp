@@ -4,8 +4,16 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <unordered_map>
 
+#include "smallvector.hpp"
+#include "symbols.hpp"
+#include "structtable.hpp"
+
+class Renderer;
+
 struct Type;
 struct IntType;
 struct NilType;
@@ -23,47 +31,80 @@ enum class TypeKind {
     FUNCTION,
 };
 
+// Equality as the typing rules define it: structural, with nil equal to every
+// array and pointer type, at the top or nested anywhere inside. Interned types
+// with no nil in them are equal only if they are the same instance.
+bool typesEqual(const Type *lhs, const Type *rhs);
 bool typesEqual(const std::shared_ptr<Type> &lhs, const std::shared_ptr<Type> &rhs);
+// Whether variables and struct fields may have this kind of type: anything but nil, structs and functions
+bool isStorableKind(TypeKind kind);
 std::shared_ptr<Type> pickNonNil(const std::shared_ptr<Type> &lhs, const std::shared_ptr<Type> &rhs);
 
-using Gamma = std::unordered_map<std::string, std::shared_ptr<Type>>;
-using Delta = std::unordered_map<std::string, std::unordered_map<std::string, std::shared_ptr<Type>>>;
+// Keyed by the interned names of functions and externs
+using Gamma = SymbolMap<std::shared_ptr<Type>>;
+using Delta = StructTable;
+
+// The variables visible inside a function: its params and locals shadow a
+// shared, read-only global layer that is never copied
+class Scope {
+public:
+    explicit Scope(const Gamma &globals);
+
+    void declare(Symbol name, std::shared_ptr<Type> type);
+    const std::shared_ptr<Type> *lookup(Symbol name) const;
+
+private:
+    const Gamma &globals;
+    Gamma locals;
+};
 
 // You really one need to keep around a single instance of IntType and NilType
-const std::shared_ptr<IntType> INT_TYPE = std::make_shared<IntType>();
-const std::shared_ptr<NilType> NIL_TYPE = std::make_shared<NilType>();
+extern const std::shared_ptr<IntType> INT_TYPE;
+extern const std::shared_ptr<NilType> NIL_TYPE;
 
 struct Type {
     virtual ~Type() = default;
     
-    virtual std::string toString() const = 0;
-    virtual std::string toStringPretty() const = 0;
-    virtual bool equals(const Type& other) const = 0;
+    // Append the type to out: render() in the form Node::render uses,
+    // renderPretty() as it is spelled in error messages, both without
+    // recursing (see render.hpp). toString() and toStringPretty() are the
+    // same in a fresh string.
+    void render(std::string &out) const;
+    void renderPretty(std::string &out) const;
+    // List the type's parts to a Renderer for each form
+    virtual void renderParts(Renderer &renderer) const = 0;
+    virtual void renderPrettyParts(Renderer &renderer) const = 0;
+    std::string toString() const;
+    std::string toStringPretty() const;
     virtual TypeKind getTypeKind() const = 0;
+
+    // Whether nil occurs anywhere in the type, itself included; only then can
+    // it equal a type other than itself
+    bool containsNil = false;
 };
 
 struct IntType : Type {
-    std::string toString() const override; 
-    std::string toStringPretty() const override;
-    bool equals(const Type &other) const override; 
+    void renderParts(Renderer &renderer) const override;
+    void renderPrettyParts(Renderer &renderer) const override;
     TypeKind getTypeKind() const override;
 };
 
 struct NilType : Type {
-    std::string toString() const override;
-    std::string toStringPretty() const override;
-    bool equals(const Type &other) const override;
+    NilType();
+
+    void renderParts(Renderer &renderer) const override;
+    void renderPrettyParts(Renderer &renderer) const override;
     TypeKind getTypeKind() const override;
 };
 
 struct StructType : Type {
+    Symbol symbol;
     std::string name;
     
-    StructType(std::string name); 
+    StructType(Symbol symbol, std::string name); 
     
-    std::string toString() const override;
-    std::string toStringPretty() const override;
-    bool equals(const Type &other) const override;
+    void renderParts(Renderer &renderer) const override;
+    void renderPrettyParts(Renderer &renderer) const override;
     TypeKind getTypeKind() const override;
 };
 
@@ -72,9 +113,8 @@ struct ArrayType : Type {
     
     ArrayType(std::shared_ptr<Type> elementType);
     
-    std::string toString() const override; 
-    std::string toStringPretty() const override;
-    bool equals(const Type &other) const override;
+    void renderParts(Renderer &renderer) const override;
+    void renderPrettyParts(Renderer &renderer) const override;
     TypeKind getTypeKind() const override;
 };
 
@@ -83,22 +123,67 @@ struct PointerType : Type {
     
     PointerType(std::shared_ptr<Type> pointeeType);
     
-    std::string toString() const override;
-    std::string toStringPretty() const override;
-    bool equals(const Type &other) const override;
+    void renderParts(Renderer &renderer) const override;
+    void renderPrettyParts(Renderer &renderer) const override;
     TypeKind getTypeKind() const override;
 };
 
+// Parameter types of a function or extern, inline up to the usual handful
+using TypeList = SmallVector<std::shared_ptr<Type>, 4>;
+
 struct FunctionType : Type {
-    std::vector<std::shared_ptr<Type>> paramTypes;
+    TypeList paramTypes;
     std::shared_ptr<Type> returnType;
     
-    FunctionType(std::vector<std::shared_ptr<Type>> paramTypes, std::shared_ptr<Type> returnType);
+    FunctionType(TypeList paramTypes, std::shared_ptr<Type> returnType);
     
-    std::string toString() const override;
-    std::string toStringPretty() const override;
-    bool equals(const Type &other) const override;
+    void renderParts(Renderer &renderer) const override;
+    void renderPrettyParts(Renderer &renderer) const override;
     TypeKind getTypeKind() const override;
 };
 
+// Hash-conses types: every structurally distinct type has exactly one
+// canonical instance, so two interned types are equal iff they are the same
+// pointer. Always create types through TypeContext::global() rather than
+// make_shared. Int and nil are singletons; struct, pointer, array and function
+// types are interned in locked maps, with a per-thread cache in front of each
+// so a type the thread has seen before takes no lock. Types are never freed:
+// a long-running process grows by each distinct one it sees (--stats reports
+// the count).
+class TypeContext {
+public:
+    static TypeContext &global();
+
+    std::shared_ptr<Type> intType() const;
+    std::shared_ptr<Type> nilType() const;
+    std::shared_ptr<Type> structType(const std::string &name);
+    std::shared_ptr<Type> pointerType(const std::shared_ptr<Type> &pointeeType);
+    std::shared_ptr<Type> arrayType(const std::shared_ptr<Type> &elementType);
+    // Looking up a signature that is already interned allocates nothing; the
+    // parameter types are only copied into a FunctionType the first time
+    std::shared_ptr<Type> functionType(std::span<const std::shared_ptr<Type>> paramTypes, const std::shared_ptr<Type> &returnType);
+
+    // Struct, pointer, array and function types interned so far
+    size_t size();
+
+private:
+    // The return type followed by the parameter types
+    using Signature = SmallVector<const Type*, 8>;
+
+    struct SignatureHash {
+        size_t operator()(const Signature &signature) const;
+    };
+
+    std::mutex mutex;
+    // Indexed by the struct name's Symbol
+    std::vector<std::shared_ptr<Type>> structTypes;
+    std::unordered_map<const Type*, std::shared_ptr<Type>> pointerTypes;
+    std::unordered_map<const Type*, std::shared_ptr<Type>> arrayTypes;
+    std::unordered_map<Signature, std::shared_ptr<Type>, SignatureHash> functionTypes;
+
+    // The same maps, for the types one thread has looked up, without a lock
+    struct ThreadCache;
+    ThreadCache &threadCache();
+};
+
 #endif
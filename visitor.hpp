@@ -0,0 +1,79 @@
+#ifndef VISITOR_HPP
+#define VISITOR_HPP
+
+// Node types, defined in ast.hpp
+struct Declaration;
+struct Value;
+struct Number;
+struct Nil;
+struct Select;
+struct UnaryOperation;
+struct BinaryOperation;
+struct NewSingleton;
+struct NewArray;
+struct CallExpression;
+struct Identifier;
+struct Dereference;
+struct ArrayAccess;
+struct FieldAccess;
+struct FunctionCall;
+struct Statements;
+struct Assignment;
+struct CallStatement;
+struct If;
+struct While;
+struct Break;
+struct Continue;
+struct Return;
+struct StructDefinition;
+struct Extern;
+struct FunctionDefinition;
+struct Program;
+
+// One visit overload per concrete node type, dispatched by Node::accept.
+// Every overload does nothing by default, so a pass only overrides the nodes
+// it cares about.
+struct Visitor {
+    virtual ~Visitor() = default;
+
+    // Declarations
+    virtual void visit(Declaration &) {}
+
+    // Expressions
+    virtual void visit(Value &) {}
+    virtual void visit(Number &) {}
+    virtual void visit(Nil &) {}
+    virtual void visit(Select &) {}
+    virtual void visit(UnaryOperation &) {}
+    virtual void visit(BinaryOperation &) {}
+    virtual void visit(NewSingleton &) {}
+    virtual void visit(NewArray &) {}
+    virtual void visit(CallExpression &) {}
+
+    // Places
+    virtual void visit(Identifier &) {}
+    virtual void visit(Dereference &) {}
+    virtual void visit(ArrayAccess &) {}
+    virtual void visit(FieldAccess &) {}
+
+    // Function call
+    virtual void visit(FunctionCall &) {}
+
+    // Statements
+    virtual void visit(Statements &) {}
+    virtual void visit(Assignment &) {}
+    virtual void visit(CallStatement &) {}
+    virtual void visit(If &) {}
+    virtual void visit(While &) {}
+    virtual void visit(Break &) {}
+    virtual void visit(Continue &) {}
+    virtual void visit(Return &) {}
+
+    // High level nodes
+    virtual void visit(StructDefinition &) {}
+    virtual void visit(Extern &) {}
+    virtual void visit(FunctionDefinition &) {}
+    virtual void visit(Program &) {}
+};
+
+#endif